@@ -0,0 +1,302 @@
+#include "AlphaImage.h"
+
+#include <iostream>
+#include <limits>
+#include <cstdlib>
+#include <cmath>
+
+#include "cv_utils.h"
+#include "BoxFilter.h"
+#include "ParallelFor.h"
+#include "StripGuidedFilter.h"
+
+
+using namespace std;
+using namespace cv;
+using namespace cv_utils;
+
+double calcAlpha(const Mat &image, const int pixel, const int foreground_pixel, const int background_pixel)
+{
+  const int IMAGE_WIDTH = image.cols;
+  const int IMAGE_HEIGHT = image.rows;
+  
+  Vec3b foreground_color = image.at<Vec3b>(foreground_pixel / IMAGE_WIDTH, foreground_pixel % IMAGE_WIDTH);
+  Vec3b background_color = image.at<Vec3b>(background_pixel / IMAGE_WIDTH, background_pixel % IMAGE_WIDTH);
+  Vec3b color = image.at<Vec3b>(pixel / IMAGE_WIDTH, pixel % IMAGE_WIDTH);
+  double alpha_numerator = 0, alpha_denominator = 0;
+  for (int c = 0; c < 3; c++) {
+    alpha_numerator += (color[c] - background_color[c]) * (foreground_color[c] - background_color[c]);
+    alpha_denominator += pow(foreground_color[c] - background_color[c], 2);
+  }
+  double alpha = abs(alpha_denominator) > 0.000001 ? alpha_numerator / alpha_denominator : 0.5;
+  alpha = max(min(alpha, 1.0), 0.0);
+  return alpha;
+}
+
+namespace
+{
+  const double COLOR_DIFF_VAR = 100;
+  const double MIN_ALPHA_CONFIDENCE = 0.1;
+  
+  template<typename T> Mat drawValues(const vector<T> &values, const int IMAGE_WIDTH, const int IMAGE_HEIGHT)
+  {
+    Mat image(IMAGE_HEIGHT, IMAGE_WIDTH, CV_8UC1);
+    for (int pixel = 0; pixel < IMAGE_WIDTH * IMAGE_HEIGHT; pixel++)
+      image.at<uchar>(pixel / IMAGE_WIDTH, pixel % IMAGE_WIDTH) = min(values[pixel] * 256.0, 255.0);
+    return image;
+  }
+  
+  //the first NUM_WINDOW_RADIUSES of the radii 3, 6, 12, ... which are smaller than MAX_RADIUS
+  vector<int> calcWindowRadiuses(const int NUM_WINDOW_RADIUSES, const int MAX_RADIUS)
+  {
+    vector<int> window_radiuses;
+    for (int radius = 3; radius < MAX_RADIUS && window_radiuses.size() < NUM_WINDOW_RADIUSES; radius *= 2)
+      window_radiuses.push_back(radius);
+    return window_radiuses;
+  }
+  
+  //alpha and confidence of every pixel from its nearest foreground and background boundary pixels
+  template<typename T> void calcInitialAlphaValues(const Mat &image, const Mat &trimap, ImageMask &foreground_mask, ImageMask &background_mask, vector<T> &alpha_values, vector<T> &alpha_confidences)
+  {
+    const int IMAGE_WIDTH = image.cols;
+    const int IMAGE_HEIGHT = image.rows;
+    const int NUM_PIXELS = IMAGE_WIDTH * IMAGE_HEIGHT;
+    
+    vector<bool> foreground_mask_vec(NUM_PIXELS, false);
+    vector<bool> background_mask_vec(NUM_PIXELS, false);
+    
+    for (int pixel = 0; pixel < NUM_PIXELS; pixel++) {
+      int color = trimap.at<uchar>(pixel / IMAGE_WIDTH, pixel % IMAGE_WIDTH);
+      if (color > 200)
+        foreground_mask_vec[pixel] = true;
+      if (color < 100)
+        background_mask_vec[pixel] = true;
+    }
+    
+    foreground_mask = ImageMask(foreground_mask_vec, IMAGE_WIDTH, IMAGE_HEIGHT);
+    background_mask = ImageMask(background_mask_vec, IMAGE_WIDTH, IMAGE_HEIGHT);
+    
+    vector<int> foreground_boundary_map;
+    vector<double> foreground_distance_map;
+    foreground_mask.calcBoundaryDistanceMap(foreground_boundary_map, foreground_distance_map);
+    vector<int> background_boundary_map;
+    vector<double> background_distance_map;
+    background_mask.calcBoundaryDistanceMap(background_boundary_map, background_distance_map);
+    
+    alpha_values.resize(NUM_PIXELS);
+    alpha_confidences.resize(NUM_PIXELS);
+    for (int pixel = 0; pixel < NUM_PIXELS; pixel++) {
+      if (foreground_mask.at(pixel)) {
+        alpha_values[pixel] = 1;
+        alpha_confidences[pixel] = 1;
+      } else if (background_mask.at(pixel)) {
+        alpha_values[pixel] = 0;
+        alpha_confidences[pixel] = 1;
+      } else {
+        int foreground_pixel = foreground_boundary_map[pixel];
+        int background_pixel = background_boundary_map[pixel];
+        double alpha = calcAlpha(image, pixel, foreground_pixel, background_pixel);
+        Vec3b color = image.at<Vec3b>(pixel / IMAGE_WIDTH, pixel % IMAGE_WIDTH);
+        Vec3b foreground_color = image.at<Vec3b>(foreground_pixel / IMAGE_WIDTH, foreground_pixel % IMAGE_WIDTH);
+        Vec3b background_color = image.at<Vec3b>(background_pixel / IMAGE_WIDTH, background_pixel % IMAGE_WIDTH);
+        double color_diff = 0;
+        for (int c = 0; c < 3; c++)
+          color_diff += pow(color[c] - (alpha * foreground_color[c] + (1 - alpha) * background_color[c]), 2);
+        alpha_values[pixel] = alpha;
+        alpha_confidences[pixel] = max(exp(-color_diff / (2 * COLOR_DIFF_VAR)), MIN_ALPHA_CONFIDENCE);
+        //alpha_confidences[pixel] = 1;
+      }
+    }
+  }
+}
+
+Mat drawValuesImage(const vector<double> &values, const int IMAGE_WIDTH, const int IMAGE_HEIGHT)
+{
+  return drawValues(values, IMAGE_WIDTH, IMAGE_HEIGHT);
+}
+
+Mat calcAlphaImage(const Mat &image, const Mat&trimap, DiagnosticsSink *diagnostics_sink, const int NUM_WINDOW_RADIUSES)
+{
+  const int IMAGE_WIDTH = image.cols;
+  const int IMAGE_HEIGHT = image.rows;
+  const int NUM_PIXELS = IMAGE_WIDTH * IMAGE_HEIGHT;
+  
+  ImageMask foreground_mask, background_mask;
+  vector<float> alpha_values, alpha_confidences;
+  calcInitialAlphaValues(image, trimap, foreground_mask, background_mask, alpha_values, alpha_confidences);
+  
+  if (isDiagnosticsEnabled(diagnostics_sink, DIAGNOSTICS_SUMMARY)) {
+    diagnostics_sink->writeImage("alpha_image_0.bmp", drawValues(alpha_values, IMAGE_WIDTH, IMAGE_HEIGHT));
+    diagnostics_sink->writeImage("confidence_image_0.bmp", drawValues(alpha_confidences, IMAGE_WIDTH, IMAGE_HEIGHT));
+  }
+  
+  const vector<int> window_radiuses = calcWindowRadiuses(NUM_WINDOW_RADIUSES, IMAGE_WIDTH / 2);
+  const double WINDOW_EPSILON = 0.00001;
+  const double WINDOW_WEIGHT = 1.0;
+  
+  //the row kernels of calcAlphaImageInStrips applied to full-image planes, so both variants compute the same filter
+  const int NUM_MOMENTS = GUIDED_ALPHA_NUM_MOMENTS;
+  const int NUM_COEFFICIENTS = GUIDED_ALPHA_NUM_COEFFICIENTS;
+  const unsigned char *image_data = image.ptr<uchar>(0);
+  const long IMAGE_STEP = image.step[0];
+  
+  const int NUM_ITERATIONS = 10;
+  vector<float> alpha_value_sums(NUM_PIXELS);
+  vector<float> alpha_confidence_sums(NUM_PIXELS);
+  vector<float> alpha_confidence_sums2(NUM_PIXELS);
+  for (int iteration = 1; iteration <= NUM_ITERATIONS; iteration++) {
+    fill(alpha_value_sums.begin(), alpha_value_sums.end(), 0);
+    fill(alpha_confidence_sums.begin(), alpha_confidence_sums.end(), 0);
+    fill(alpha_confidence_sums2.begin(), alpha_confidence_sums2.end(), 0);
+    
+    //the moments do not depend on the radius
+    vector<float> moments(static_cast<long>(NUM_PIXELS) * NUM_MOMENTS);
+    parallelFor(0, IMAGE_HEIGHT, getNumThreads(), [&](const int, const int first_row, const int last_row) {
+	for (int y = first_row; y < last_row; y++)
+	  calcGuidedAlphaMomentRow(image_data, IMAGE_STEP, alpha_values, alpha_confidences, IMAGE_WIDTH, y, &moments[static_cast<long>(y) * IMAGE_WIDTH * NUM_MOMENTS]);
+      });
+    //a single radius takes the running-sum box filter directly, several radii share one integral image
+    const bool USE_INTEGRAL_IMAGE = window_radiuses.size() > 1;
+    vector<double> moment_integral;
+    if (USE_INTEGRAL_IMAGE) {
+      calcIntegralImage(moments, NUM_MOMENTS, IMAGE_WIDTH, IMAGE_HEIGHT, moment_integral);
+      vector<float>().swap(moments);
+    }
+    for (int window_index = 0; window_index < window_radiuses.size(); window_index++) {
+      const int radius = window_radiuses[window_index];
+      
+      vector<float> moment_means;
+      if (USE_INTEGRAL_IMAGE)
+	calcIntegralBoxMeans(moment_integral, NUM_MOMENTS, IMAGE_WIDTH, IMAGE_HEIGHT, radius, moment_means);
+      else
+	calcBoxMeans(moments, NUM_MOMENTS, IMAGE_WIDTH, IMAGE_HEIGHT, radius, moment_means);
+      vector<float> coefficients(static_cast<long>(NUM_PIXELS) * NUM_COEFFICIENTS);
+      parallelFor(0, IMAGE_HEIGHT, getNumThreads(), [&](const int, const int first_row, const int last_row) {
+	  for (int y = first_row; y < last_row; y++)
+	    calcGuidedAlphaCoefficientRow(&moment_means[static_cast<long>(y) * IMAGE_WIDTH * NUM_MOMENTS], IMAGE_WIDTH, WINDOW_EPSILON, &coefficients[static_cast<long>(y) * IMAGE_WIDTH * NUM_COEFFICIENTS]);
+	});
+      vector<float>().swap(moment_means);
+      vector<float> coefficient_means;
+      calcBoxMeans(coefficients, NUM_COEFFICIENTS, IMAGE_WIDTH, IMAGE_HEIGHT, radius, coefficient_means);
+      
+      Mat alpha_image;
+      if (isDiagnosticsEnabled(diagnostics_sink, DIAGNOSTICS_ALL))
+	alpha_image.create(IMAGE_HEIGHT, IMAGE_WIDTH, CV_8UC1);
+      //the alpha estimate of this radius is blended into the sums in the same pass that evaluates it
+      parallelFor(0, IMAGE_HEIGHT, getNumThreads(), [&](const int, const int first_row, const int last_row) {
+	  vector<float> alphas(IMAGE_WIDTH), window_alpha_confidences(IMAGE_WIDTH);
+	  for (int y = first_row; y < last_row; y++) {
+	    calcGuidedAlphaOutputRow(image_data + y * IMAGE_STEP, &coefficient_means[static_cast<long>(y) * IMAGE_WIDTH * NUM_COEFFICIENTS], IMAGE_WIDTH, &alphas[0], &window_alpha_confidences[0]);
+	    for (int x = 0; x < IMAGE_WIDTH; x++) {
+	      const int pixel = y * IMAGE_WIDTH + x;
+	      alpha_value_sums[pixel] += alphas[x] * WINDOW_WEIGHT * window_alpha_confidences[x];
+	      alpha_confidence_sums[pixel] += WINDOW_WEIGHT * window_alpha_confidences[x];
+	      alpha_confidence_sums2[pixel] += WINDOW_WEIGHT * window_alpha_confidences[x] * window_alpha_confidences[x];
+	    }
+	    if (alpha_image.empty() == false)
+	      for (int x = 0; x < IMAGE_WIDTH; x++)
+		alpha_image.at<uchar>(y, x) = min(alphas[x] * 256.0, 255.0);
+	  }
+	});
+      if (alpha_image.empty() == false)
+	diagnostics_sink->writeImage("alpha_image_" + to_string(iteration) + "_" + to_string(radius) + ".bmp", alpha_image);
+    }
+    
+    for (int pixel = 0; pixel < NUM_PIXELS; pixel++) {
+      if (foreground_mask.at(pixel)) {
+	alpha_values[pixel] = 1;
+	alpha_confidences[pixel] = 1;
+      } else if (background_mask.at(pixel)) {
+	alpha_values[pixel] = 0;
+	alpha_confidences[pixel] = 1;
+      } else {
+	const double alpha_mean = alpha_confidence_sums[pixel] != 0 ? alpha_value_sums[pixel] / alpha_confidence_sums[pixel] : 1.0 * rand() / RAND_MAX;
+	alpha_values[pixel] = max(min(alpha_mean, 1.0), 0.0);
+	alpha_confidences[pixel] = alpha_confidence_sums[pixel] != 0 ? max(alpha_confidence_sums2[pixel] / alpha_confidence_sums[pixel], static_cast<float>(MIN_ALPHA_CONFIDENCE)) : 0;
+      }
+    }
+    if (isDiagnosticsEnabled(diagnostics_sink, DIAGNOSTICS_ITERATIONS)) {
+      diagnostics_sink->writeImage("alpha_image_" + to_string(iteration) + ".bmp", drawValues(alpha_values, IMAGE_WIDTH, IMAGE_HEIGHT));
+      diagnostics_sink->writeImage("confidence_image_" + to_string(iteration) + ".bmp", drawValues(alpha_confidences, IMAGE_WIDTH, IMAGE_HEIGHT));
+    }
+  }
+  
+  Mat alpha_image(IMAGE_HEIGHT, IMAGE_WIDTH, CV_8UC1);
+  for (int pixel = 0; pixel < NUM_PIXELS; pixel++)
+    alpha_image.at<uchar>(pixel / IMAGE_WIDTH, pixel % IMAGE_WIDTH) = max(min(alpha_values[pixel] * 256.0, 255.0), 0.0);
+  return alpha_image;
+}
+
+Mat calcAlphaImageInStrips(const Mat &image, const Mat &trimap, DiagnosticsSink *diagnostics_sink, const int NUM_WINDOW_RADIUSES)
+{
+  const int IMAGE_WIDTH = image.cols;
+  const int IMAGE_HEIGHT = image.rows;
+  const int NUM_PIXELS = IMAGE_WIDTH * IMAGE_HEIGHT;
+  
+  //apart from the boundary initialization, alpha, confidence and the three blending sums are the only per-pixel state
+  ImageMask foreground_mask, background_mask;
+  vector<float> alpha_values, alpha_confidences;
+  calcInitialAlphaValues(image, trimap, foreground_mask, background_mask, alpha_values, alpha_confidences);
+  
+  if (isDiagnosticsEnabled(diagnostics_sink, DIAGNOSTICS_SUMMARY)) {
+    diagnostics_sink->writeImage("alpha_image_0.bmp", drawValues(alpha_values, IMAGE_WIDTH, IMAGE_HEIGHT));
+    diagnostics_sink->writeImage("confidence_image_0.bmp", drawValues(alpha_confidences, IMAGE_WIDTH, IMAGE_HEIGHT));
+  }
+  
+  const vector<int> window_radiuses = calcWindowRadiuses(NUM_WINDOW_RADIUSES, min(IMAGE_WIDTH / 2, MAX_STRIP_WINDOW_RADIUS + 1));
+  const double WINDOW_EPSILON = 0.00001;
+  const double WINDOW_WEIGHT = 1.0;
+  
+  const int NUM_ITERATIONS = 10;
+  vector<float> alpha_value_sums(NUM_PIXELS);
+  vector<float> alpha_confidence_sums(NUM_PIXELS);
+  vector<float> alpha_confidence_sums2(NUM_PIXELS);
+  for (int iteration = 1; iteration <= NUM_ITERATIONS; iteration++) {
+    fill(alpha_value_sums.begin(), alpha_value_sums.end(), 0);
+    fill(alpha_confidence_sums.begin(), alpha_confidence_sums.end(), 0);
+    fill(alpha_confidence_sums2.begin(), alpha_confidence_sums2.end(), 0);
+    for (int window_index = 0; window_index < window_radiuses.size(); window_index++) {
+      const int radius = window_radiuses[window_index];
+      Mat alpha_image;
+      if (isDiagnosticsEnabled(diagnostics_sink, DIAGNOSTICS_ALL))
+	alpha_image.create(IMAGE_HEIGHT, IMAGE_WIDTH, CV_8UC1);
+      //every row is blended as soon as its band emits it
+      calcGuidedAlphaRows(image.ptr<uchar>(0), image.step[0], alpha_values, alpha_confidences, IMAGE_WIDTH, IMAGE_HEIGHT, radius, WINDOW_EPSILON, [&](const int y, const float *alphas, const float *window_alpha_confidences) {
+	  for (int x = 0; x < IMAGE_WIDTH; x++) {
+	    const int pixel = y * IMAGE_WIDTH + x;
+	    alpha_value_sums[pixel] += alphas[x] * WINDOW_WEIGHT * window_alpha_confidences[x];
+	    alpha_confidence_sums[pixel] += WINDOW_WEIGHT * window_alpha_confidences[x];
+	    alpha_confidence_sums2[pixel] += WINDOW_WEIGHT * window_alpha_confidences[x] * window_alpha_confidences[x];
+	  }
+	  if (alpha_image.empty() == false)
+	    for (int x = 0; x < IMAGE_WIDTH; x++)
+	      alpha_image.at<uchar>(y, x) = min(alphas[x] * 256.0, 255.0);
+	});
+      if (alpha_image.empty() == false)
+	diagnostics_sink->writeImage("alpha_image_" + to_string(iteration) + "_" + to_string(radius) + ".bmp", alpha_image);
+    }
+    
+    for (int pixel = 0; pixel < NUM_PIXELS; pixel++) {
+      if (foreground_mask.at(pixel)) {
+	alpha_values[pixel] = 1;
+	alpha_confidences[pixel] = 1;
+      } else if (background_mask.at(pixel)) {
+	alpha_values[pixel] = 0;
+	alpha_confidences[pixel] = 1;
+      } else {
+	const double alpha_mean = alpha_confidence_sums[pixel] != 0 ? alpha_value_sums[pixel] / alpha_confidence_sums[pixel] : 1.0 * rand() / RAND_MAX;
+	alpha_values[pixel] = max(min(alpha_mean, 1.0), 0.0);
+	alpha_confidences[pixel] = alpha_confidence_sums[pixel] != 0 ? max(alpha_confidence_sums2[pixel] / alpha_confidence_sums[pixel], static_cast<float>(MIN_ALPHA_CONFIDENCE)) : 0;
+      }
+    }
+    if (isDiagnosticsEnabled(diagnostics_sink, DIAGNOSTICS_ITERATIONS)) {
+      diagnostics_sink->writeImage("alpha_image_" + to_string(iteration) + ".bmp", drawValues(alpha_values, IMAGE_WIDTH, IMAGE_HEIGHT));
+      diagnostics_sink->writeImage("confidence_image_" + to_string(iteration) + ".bmp", drawValues(alpha_confidences, IMAGE_WIDTH, IMAGE_HEIGHT));
+    }
+  }
+  
+  Mat alpha_image(IMAGE_HEIGHT, IMAGE_WIDTH, CV_8UC1);
+  for (int pixel = 0; pixel < NUM_PIXELS; pixel++)
+    alpha_image.at<uchar>(pixel / IMAGE_WIDTH, pixel % IMAGE_WIDTH) = max(min(alpha_values[pixel] * 256.0, 255.0), 0.0);
+  return alpha_image;
+}
@@ -0,0 +1,22 @@
+#ifndef ALPHA_IMAGE_H__
+#define ALPHA_IMAGE_H__
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "Diagnostics.h"
+
+
+//alpha of pixel as the projection of its color onto the line between the foreground and background colors, clamped to [0, 1]
+double calcAlpha(const cv::Mat &image, const int pixel, const int foreground_pixel, const int background_pixel);
+//values in [0, 1] as an 8-bit image
+cv::Mat drawValuesImage(const std::vector<double> &values, const int IMAGE_WIDTH, const int IMAGE_HEIGHT);
+//Alpha matte from the boundary initialization refined by confidence-weighted guided filtering (the row kernels of StripGuidedFilter.h on full-image planes); intermediate alpha and confidence images go to diagnostics_sink.
+//The estimates of NUM_WINDOW_RADIUSES window radii 3, 6, 12, ... (below half the image width) are blended; a single radius takes the moment means from calcBoxMeans, several radii share one integral image of the moments, so more radii mainly add the per-radius coefficient passes.
+cv::Mat calcAlphaImage(const cv::Mat &image, const cv::Mat &trimap, DiagnosticsSink *diagnostics_sink = NULL, const int NUM_WINDOW_RADIUSES = 1);
+//calcAlphaImage evaluated in row strips (see calcGuidedAlphaRows) for images too large for its full-image planes; it computes the same filter, and apart from the boundary initialization it keeps five floats per pixel
+//Each thread keeps a ring of 2 * radius + 1 rows, so radii are also limited to MAX_STRIP_WINDOW_RADIUS (at most 5 radii).
+const int MAX_STRIP_WINDOW_RADIUS = 48;
+cv::Mat calcAlphaImageInStrips(const cv::Mat &image, const cv::Mat &trimap, DiagnosticsSink *diagnostics_sink = NULL, const int NUM_WINDOW_RADIUSES = 1);
+
+#endif
@@ -0,0 +1,44 @@
+#include "AlphaMatting.h"
+
+#include <vector>
+#include <stdexcept>
+
+#include "AlphaMattingPyramid.h"
+#include "AlphaImage.h"
+#include "ParallelFor.h"
+
+
+using namespace std;
+using namespace cv;
+
+bool matte(const Mat &image, const Mat &trimap, Mat &alpha, const MattingOptions &options)
+{
+  if (image.empty() || image.type() != CV_8UC3 || trimap.type() != CV_8UC1 || image.cols != trimap.cols || image.rows != trimap.rows)
+    return false;
+  
+  vector<long> solution;
+  try {
+    ThreadLimitGuard thread_limit_guard(options.num_threads);
+    const vector<long> initial_solution = calcCoarseToFineSolution(image, trimap, options.num_coarse_levels, options.num_level_iterations, 32, options.cache_directory);
+    solution = solveLevel(image, trimap, initial_solution, options.num_iterations, options.cache_directory, options.diagnostics_sink);
+  } catch (const invalid_argument &) {
+    return false;
+  }
+  
+  calcSolutionAlpha(image, trimap, solution, alpha);
+  return true;
+}
+
+void calcSolutionAlpha(const Mat &image, const Mat &trimap, const vector<long> &solution, Mat &alpha)
+{
+  const int IMAGE_WIDTH = image.cols;
+  const int NUM_PIXELS = image.cols * image.rows;
+  alpha.create(image.rows, image.cols, CV_8UC1);
+  for (int pixel = 0; pixel < NUM_PIXELS; pixel++) {
+    const int trimap_value = trimap.at<uchar>(pixel / IMAGE_WIDTH, pixel % IMAGE_WIDTH);
+    double pixel_alpha = trimap_value > 200 ? 1 : 0;
+    if (trimap_value >= 100 && trimap_value <= 200)
+      pixel_alpha = calcAlpha(image, pixel, solution[pixel] / NUM_PIXELS, solution[pixel] % NUM_PIXELS);
+    alpha.at<uchar>(pixel / IMAGE_WIDTH, pixel % IMAGE_WIDTH) = pixel_alpha * 255;
+  }
+}
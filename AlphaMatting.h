@@ -0,0 +1,30 @@
+#ifndef ALPHA_MATTING_H__
+#define ALPHA_MATTING_H__
+
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "Diagnostics.h"
+
+
+//Embeddable entry point. matte touches the filesystem only if cache_directory is set and writes nothing to stdout; num_threads = 0 uses the thread limit of the calling thread. Intermediate outputs of the full-resolution level go to diagnostics_sink (not owned).
+//Invalid inputs are reported through the return value, as are problems the solver rejects (std::invalid_argument inside the library, e.g. a neighbor graph with more than INT_MAX edges on very large images). Broken internal invariants (e.g. non-finite costs) still stop the process with a message.
+struct MattingOptions
+{
+  int num_coarse_levels;
+  int num_level_iterations;
+  int num_iterations;
+  int num_threads;
+  std::string cache_directory;
+  DiagnosticsSink *diagnostics_sink;
+  
+  MattingOptions() : num_coarse_levels(2), num_level_iterations(10), num_iterations(30), num_threads(0), diagnostics_sink(NULL) {};
+};
+
+//alpha matte of a CV_8UC3 image for a CV_8UC1 trimap of the same size, written to alpha as CV_8UC1 (a caller buffer of that size and type is reused). Returns false and leaves alpha untouched if the inputs do not match or the solver rejects the problem.
+bool matte(const cv::Mat &image, const cv::Mat &trimap, cv::Mat &alpha, const MattingOptions &options = MattingOptions());
+//alpha (CV_8UC1) of a pixel solution as returned by solveLevel
+void calcSolutionAlpha(const cv::Mat &image, const cv::Mat &trimap, const std::vector<long> &solution, cv::Mat &alpha);
+
+#endif
@@ -7,23 +7,40 @@
 #include <sstream>
 #include <cmath>
 #include <algorithm>
+#include <immintrin.h>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include "ParallelFor.h"
+#include "NeighborGraphCache.h"
+#include "SolverTelemetry.h"
+#include "Symmetric3x3.h"
+#include "AlphaMattingPyramid.h"
+
 
 using namespace cv;
 using namespace std;
 using namespace cv_utils;
 
 
-AlphaMattingCostFunctor::AlphaMattingCostFunctor(const cv::Mat &image, const ImageMask &foreground_mask, const ImageMask &background_mask, const string image_identifier) : image_(image.clone()), foreground_mask_(foreground_mask), background_mask_(background_mask), IMAGE_WIDTH_(image.cols), IMAGE_HEIGHT_(image.rows), NEIGHBOR_WINDOW_SIZE_(5), NUM_NEIGHBORS_(9), DATA_TERM_WEIGHT_(1.0), SMOOTHNESS_TERM_WEIGHT_(1), image_identifier_(image_identifier)
+AlphaMattingCostFunctor::AlphaMattingCostFunctor(const cv::Mat &image, const ImageMask &foreground_mask, const ImageMask &background_mask, const string &cache_directory) : image_(image.clone()), foreground_mask_(foreground_mask), background_mask_(background_mask), IMAGE_WIDTH_(image.cols), IMAGE_HEIGHT_(image.rows), NEIGHBOR_WINDOW_SIZE_(5), NUM_NEIGHBORS_(9), NEIGHBOR_WINDOW_EPSILON_(0.00001), CACHE_DIRECTORY_(cache_directory), DATA_TERM_WEIGHT_(1.0), SMOOTHNESS_TERM_WEIGHT_(1)
 {
+  chrono::steady_clock::time_point lap_start = chrono::steady_clock::now();
   calcNeighborsInfo();
+  neighbors_info_seconds_ = calcLapSeconds(lap_start);
+  calcNodeGraph();
+  calcDistanceMaps();
+}
+
+AlphaMattingCostFunctor::AlphaMattingCostFunctor(const cv::Mat &image, const ImageMask &foreground_mask, const ImageMask &background_mask, const NeighborGraph &pixel_neighbor_graph) : image_(image.clone()), pixel_neighbor_graph_(pixel_neighbor_graph), foreground_mask_(foreground_mask), background_mask_(background_mask), IMAGE_WIDTH_(image.cols), IMAGE_HEIGHT_(image.rows), NEIGHBOR_WINDOW_SIZE_(5), NUM_NEIGHBORS_(9), NEIGHBOR_WINDOW_EPSILON_(0.00001), DATA_TERM_WEIGHT_(1.0), SMOOTHNESS_TERM_WEIGHT_(1), neighbors_info_seconds_(0)
+{
+  calcNodeGraph();
   calcDistanceMaps();
 }
 
-double AlphaMattingCostFunctor::operator()(const int pixel, const long label) const
+double AlphaMattingCostFunctor::operator()(const int node, const long label) const
 {
+  const int pixel = node_pixels_[node];
   const int foreground_pixel = label / (IMAGE_WIDTH_ * IMAGE_HEIGHT_);
   const int background_pixel = label % (IMAGE_WIDTH_ * IMAGE_HEIGHT_);
   Vec3b foreground_color = image_.at<Vec3b>(foreground_pixel / IMAGE_WIDTH_, foreground_pixel % IMAGE_WIDTH_);
@@ -43,15 +60,217 @@ double AlphaMattingCostFunctor::operator()(const int pixel, const long label) co
     data_cost += sqrt(pow(foreground_pixel % IMAGE_WIDTH_ - pixel % IMAGE_WIDTH_, 2) + pow(foreground_pixel / IMAGE_WIDTH_ - pixel / IMAGE_WIDTH_, 2)) / foreground_distance_map_[pixel] + sqrt(pow(background_pixel % IMAGE_WIDTH_ - pixel % IMAGE_WIDTH_, 2) + pow(background_pixel / IMAGE_WIDTH_ - pixel / IMAGE_WIDTH_, 2)) / background_distance_map_[pixel];
   }
   
-  return data_cost * DATA_TERM_WEIGHT_;
+  return data_cost * DATA_TERM_WEIGHT_ + node_foreground_weights_[node] * (1 - alpha) + node_background_weights_[node] * alpha + calcFixedNeighborCost(node, alpha);
+}
+
+void AlphaMattingCostFunctor::calcUnaryCosts(const int node, const long *labels, const int NUM_LABELS, double *costs) const
+{
+  const int NUM_PIXELS = IMAGE_WIDTH_ * IMAGE_HEIGHT_;
+  const int pixel = node_pixels_[node];
+  const double foreground_neighbor_weight = node_foreground_weights_[node];
+  const double background_neighbor_weight = node_background_weights_[node];
+  const int x = pixel % IMAGE_WIDTH_;
+  const int y = pixel / IMAGE_WIDTH_;
+  const Vec3b color = image_.at<Vec3b>(y, x);
+  const bool is_unknown = foreground_mask_.at(pixel) == false && background_mask_.at(pixel) == false;
+  const double fixed_alpha = foreground_mask_.at(pixel) ? 1.0 : 0.0;
+  const double foreground_distance = is_unknown ? foreground_distance_map_[pixel] : 1;
+  const double background_distance = is_unknown ? background_distance_map_[pixel] : 1;
+  
+  //the same computation as operator(), but the colors and positions of sampled foreground/background pixels are gathered block by block (structure of arrays) so that several labels are evaluated per instruction
+  const int BLOCK_SIZE = 64;
+  alignas(32) double foreground_values[5][BLOCK_SIZE];
+  alignas(32) double background_values[5][BLOCK_SIZE];
+  for (int block_start = 0; block_start < NUM_LABELS; block_start += BLOCK_SIZE) {
+    const int NUM_BLOCK_LABELS = min(BLOCK_SIZE, NUM_LABELS - block_start);
+    for (int i = 0; i < NUM_BLOCK_LABELS; i++) {
+      const long label = labels[block_start + i];
+      const int foreground_pixel = label / NUM_PIXELS;
+      const int background_pixel = label % NUM_PIXELS;
+      Vec3b foreground_color = image_.at<Vec3b>(foreground_pixel / IMAGE_WIDTH_, foreground_pixel % IMAGE_WIDTH_);
+      Vec3b background_color = image_.at<Vec3b>(background_pixel / IMAGE_WIDTH_, background_pixel % IMAGE_WIDTH_);
+      for (int c = 0; c < 3; c++) {
+	foreground_values[c][i] = foreground_color[c];
+	background_values[c][i] = background_color[c];
+      }
+      foreground_values[3][i] = foreground_pixel % IMAGE_WIDTH_ - x;
+      foreground_values[4][i] = foreground_pixel / IMAGE_WIDTH_ - y;
+      background_values[3][i] = background_pixel % IMAGE_WIDTH_ - x;
+      background_values[4][i] = background_pixel / IMAGE_WIDTH_ - y;
+    }
+  
+    double *block_costs = costs + block_start;
+    int i = 0;
+#if defined(__AVX__)
+    {
+      const __m256d zero = _mm256_setzero_pd();
+      const __m256d one = _mm256_set1_pd(1.0);
+      const __m256d half = _mm256_set1_pd(0.5);
+      const __m256d min_denominator = _mm256_set1_pd(0.000001);
+      const __m256d max_data_cost = _mm256_set1_pd(pow(255.0, 2) * 3);
+      const __m256d pixel_alpha = _mm256_set1_pd(fixed_alpha);
+      const __m256d foreground_distance_value = _mm256_set1_pd(foreground_distance);
+      const __m256d background_distance_value = _mm256_set1_pd(background_distance);
+      const __m256d data_term_weight = _mm256_set1_pd(DATA_TERM_WEIGHT_);
+      const __m256d foreground_neighbor_weight_value = _mm256_set1_pd(foreground_neighbor_weight);
+      const __m256d background_neighbor_weight_value = _mm256_set1_pd(background_neighbor_weight);
+      __m256d pixel_color[3];
+      for (int c = 0; c < 3; c++)
+	pixel_color[c] = _mm256_set1_pd(color[c]);
+      for (; i + 4 <= NUM_BLOCK_LABELS; i += 4) {
+	__m256d foreground_color[3], background_color[3];
+	__m256d alpha_numerator = zero, alpha_denominator = zero;
+	for (int c = 0; c < 3; c++) {
+	  foreground_color[c] = _mm256_load_pd(&foreground_values[c][i]);
+	  background_color[c] = _mm256_load_pd(&background_values[c][i]);
+	  __m256d color_diff = _mm256_sub_pd(foreground_color[c], background_color[c]);
+	  alpha_numerator = _mm256_add_pd(alpha_numerator, _mm256_mul_pd(_mm256_sub_pd(pixel_color[c], background_color[c]), color_diff));
+	  alpha_denominator = _mm256_add_pd(alpha_denominator, _mm256_mul_pd(color_diff, color_diff));
+	}
+	__m256d alpha = pixel_alpha;
+	if (is_unknown) {
+	  __m256d valid = _mm256_cmp_pd(alpha_denominator, min_denominator, _CMP_GT_OQ);
+	  alpha = _mm256_blendv_pd(half, _mm256_div_pd(alpha_numerator, alpha_denominator), valid);
+	  alpha = _mm256_max_pd(_mm256_min_pd(alpha, one), zero);
+	}
+	__m256d data_cost = zero;
+	for (int c = 0; c < 3; c++) {
+	  __m256d residual = _mm256_sub_pd(pixel_color[c], _mm256_add_pd(_mm256_mul_pd(alpha, foreground_color[c]), _mm256_mul_pd(_mm256_sub_pd(one, alpha), background_color[c])));
+	  data_cost = _mm256_add_pd(data_cost, _mm256_mul_pd(residual, residual));
+	}
+	//the invariants operator() checks (ordered comparisons also fail for NaN)
+	const __m256d valid_alpha = _mm256_and_pd(_mm256_cmp_pd(alpha, zero, _CMP_GE_OQ), _mm256_cmp_pd(alpha, one, _CMP_LE_OQ));
+	const __m256d valid_data_cost = _mm256_and_pd(_mm256_cmp_pd(data_cost, zero, _CMP_GE_OQ), _mm256_cmp_pd(data_cost, max_data_cost, _CMP_LE_OQ));
+	if (_mm256_movemask_pd(_mm256_and_pd(valid_alpha, valid_data_cost)) != 0xF)
+	  reportInvalidUnaryCost(pixel, labels + block_start + i, 4);
+	if (is_unknown) {
+	  __m256d foreground_delta_x = _mm256_load_pd(&foreground_values[3][i]), foreground_delta_y = _mm256_load_pd(&foreground_values[4][i]);
+	  __m256d background_delta_x = _mm256_load_pd(&background_values[3][i]), background_delta_y = _mm256_load_pd(&background_values[4][i]);
+	  __m256d foreground_pixel_distance = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(foreground_delta_x, foreground_delta_x), _mm256_mul_pd(foreground_delta_y, foreground_delta_y)));
+	  __m256d background_pixel_distance = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(background_delta_x, background_delta_x), _mm256_mul_pd(background_delta_y, background_delta_y)));
+	  data_cost = _mm256_add_pd(data_cost, _mm256_add_pd(_mm256_div_pd(foreground_pixel_distance, foreground_distance_value), _mm256_div_pd(background_pixel_distance, background_distance_value)));
+	}
+	__m256d known_neighbor_cost = _mm256_add_pd(_mm256_mul_pd(foreground_neighbor_weight_value, _mm256_sub_pd(one, alpha)), _mm256_mul_pd(background_neighbor_weight_value, alpha));
+	_mm256_storeu_pd(block_costs + i, _mm256_add_pd(_mm256_mul_pd(data_cost, data_term_weight), known_neighbor_cost));
+      }
+    }
+#elif defined(__SSE2__)
+    {
+      const __m128d zero = _mm_setzero_pd();
+      const __m128d one = _mm_set1_pd(1.0);
+      const __m128d half = _mm_set1_pd(0.5);
+      const __m128d min_denominator = _mm_set1_pd(0.000001);
+      const __m128d max_data_cost = _mm_set1_pd(pow(255.0, 2) * 3);
+      const __m128d pixel_alpha = _mm_set1_pd(fixed_alpha);
+      const __m128d foreground_distance_value = _mm_set1_pd(foreground_distance);
+      const __m128d background_distance_value = _mm_set1_pd(background_distance);
+      const __m128d data_term_weight = _mm_set1_pd(DATA_TERM_WEIGHT_);
+      const __m128d foreground_neighbor_weight_value = _mm_set1_pd(foreground_neighbor_weight);
+      const __m128d background_neighbor_weight_value = _mm_set1_pd(background_neighbor_weight);
+      __m128d pixel_color[3];
+      for (int c = 0; c < 3; c++)
+	pixel_color[c] = _mm_set1_pd(color[c]);
+      for (; i + 2 <= NUM_BLOCK_LABELS; i += 2) {
+	__m128d foreground_color[3], background_color[3];
+	__m128d alpha_numerator = zero, alpha_denominator = zero;
+	for (int c = 0; c < 3; c++) {
+	  foreground_color[c] = _mm_load_pd(&foreground_values[c][i]);
+	  background_color[c] = _mm_load_pd(&background_values[c][i]);
+	  __m128d color_diff = _mm_sub_pd(foreground_color[c], background_color[c]);
+	  alpha_numerator = _mm_add_pd(alpha_numerator, _mm_mul_pd(_mm_sub_pd(pixel_color[c], background_color[c]), color_diff));
+	  alpha_denominator = _mm_add_pd(alpha_denominator, _mm_mul_pd(color_diff, color_diff));
+	}
+	__m128d alpha = pixel_alpha;
+	if (is_unknown) {
+	  __m128d valid = _mm_cmpgt_pd(alpha_denominator, min_denominator);
+	  alpha = _mm_or_pd(_mm_and_pd(valid, _mm_div_pd(alpha_numerator, alpha_denominator)), _mm_andnot_pd(valid, half));
+	  alpha = _mm_max_pd(_mm_min_pd(alpha, one), zero);
+	}
+	__m128d data_cost = zero;
+	for (int c = 0; c < 3; c++) {
+	  __m128d residual = _mm_sub_pd(pixel_color[c], _mm_add_pd(_mm_mul_pd(alpha, foreground_color[c]), _mm_mul_pd(_mm_sub_pd(one, alpha), background_color[c])));
+	  data_cost = _mm_add_pd(data_cost, _mm_mul_pd(residual, residual));
+	}
+	const __m128d valid_alpha = _mm_and_pd(_mm_cmpge_pd(alpha, zero), _mm_cmple_pd(alpha, one));
+	const __m128d valid_data_cost = _mm_and_pd(_mm_cmpge_pd(data_cost, zero), _mm_cmple_pd(data_cost, max_data_cost));
+	if (_mm_movemask_pd(_mm_and_pd(valid_alpha, valid_data_cost)) != 0x3)
+	  reportInvalidUnaryCost(pixel, labels + block_start + i, 2);
+	if (is_unknown) {
+	  __m128d foreground_delta_x = _mm_load_pd(&foreground_values[3][i]), foreground_delta_y = _mm_load_pd(&foreground_values[4][i]);
+	  __m128d background_delta_x = _mm_load_pd(&background_values[3][i]), background_delta_y = _mm_load_pd(&background_values[4][i]);
+	  __m128d foreground_pixel_distance = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(foreground_delta_x, foreground_delta_x), _mm_mul_pd(foreground_delta_y, foreground_delta_y)));
+	  __m128d background_pixel_distance = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(background_delta_x, background_delta_x), _mm_mul_pd(background_delta_y, background_delta_y)));
+	  data_cost = _mm_add_pd(data_cost, _mm_add_pd(_mm_div_pd(foreground_pixel_distance, foreground_distance_value), _mm_div_pd(background_pixel_distance, background_distance_value)));
+	}
+	__m128d known_neighbor_cost = _mm_add_pd(_mm_mul_pd(foreground_neighbor_weight_value, _mm_sub_pd(one, alpha)), _mm_mul_pd(background_neighbor_weight_value, alpha));
+	_mm_storeu_pd(block_costs + i, _mm_add_pd(_mm_mul_pd(data_cost, data_term_weight), known_neighbor_cost));
+      }
+    }
+#endif
+    for (; i < NUM_BLOCK_LABELS; i++) {
+      double alpha = fixed_alpha;
+      if (is_unknown) {
+	double alpha_numerator = 0, alpha_denominator = 0;
+	for (int c = 0; c < 3; c++) {
+	  alpha_numerator += (color[c] - background_values[c][i]) * (foreground_values[c][i] - background_values[c][i]);
+	  alpha_denominator += pow(foreground_values[c][i] - background_values[c][i], 2);
+	}
+	alpha = alpha_denominator > 0.000001 ? alpha_numerator / alpha_denominator : 0.5;
+	alpha = max(min(alpha, 1.0), 0.0);
+      }
+      double data_cost = 0;
+      for (int c = 0; c < 3; c++)
+	data_cost += pow(color[c] - (alpha * foreground_values[c][i] + (1 - alpha) * background_values[c][i]), 2);
+      if (alpha < 0 || alpha > 1 || std::isnan(alpha) || data_cost < 0 || data_cost > pow(255.0, 2) * 3 || std::isnan(data_cost))
+	reportInvalidUnaryCost(pixel, labels + block_start + i, 1);
+      if (is_unknown)
+	data_cost += sqrt(pow(foreground_values[3][i], 2) + pow(foreground_values[4][i], 2)) / foreground_distance + sqrt(pow(background_values[3][i], 2) + pow(background_values[4][i], 2)) / background_distance;
+      block_costs[i] = data_cost * DATA_TERM_WEIGHT_ + foreground_neighbor_weight * (1 - alpha) + background_neighbor_weight * alpha;
+    }
+  }
+  
+  //the costs of edges to unknown pixels which are no nodes (see setNodePixels) are not linear in alpha
+  if (node_fixed_neighbor_offsets_[node + 1] > node_fixed_neighbor_offsets_[node])
+    for (int label_index = 0; label_index < NUM_LABELS; label_index++)
+      costs[label_index] += calcFixedNeighborCost(node, calcAlpha(pixel, labels[label_index]));
+}
+
+//prints the samples of labels whose alpha or data cost broke the invariants checked by operator(), and exits
+void AlphaMattingCostFunctor::reportInvalidUnaryCost(const int pixel, const long *labels, const int NUM_LABELS) const
+{
+  Vec3b color = image_.at<Vec3b>(pixel / IMAGE_WIDTH_, pixel % IMAGE_WIDTH_);
+  for (int label_index = 0; label_index < NUM_LABELS; label_index++) {
+    const int foreground_pixel = labels[label_index] / (IMAGE_WIDTH_ * IMAGE_HEIGHT_);
+    const int background_pixel = labels[label_index] % (IMAGE_WIDTH_ * IMAGE_HEIGHT_);
+    Vec3b foreground_color = image_.at<Vec3b>(foreground_pixel / IMAGE_WIDTH_, foreground_pixel % IMAGE_WIDTH_);
+    Vec3b background_color = image_.at<Vec3b>(background_pixel / IMAGE_WIDTH_, background_pixel % IMAGE_WIDTH_);
+    cout << pixel << '\t' << foreground_pixel << '\t' << background_pixel << '\t' << color << '\t' << foreground_color << '\t' << background_color << endl;
+  }
+  exit(1);
 }
 
-double AlphaMattingCostFunctor::operator()(const int pixel_1, const int pixel_2, const long label_1, const long label_2) const
+double AlphaMattingCostFunctor::operator()(const int node_1, const int node_2, const long label_1, const long label_2) const
+{
+  assert(node_1 < node_2);
+  double alpha_1 = calcAlpha(node_pixels_[node_1], label_1);
+  double alpha_2 = calcAlpha(node_pixels_[node_2], label_2);
+  return abs(alpha_1 - alpha_2) * SMOOTHNESS_TERM_WEIGHT_ * node_neighbor_graph_.getWeight(node_neighbor_graph_.findEdge(min(node_1, node_2), max(node_1, node_2)));
+}
+
+double AlphaMattingCostFunctor::calcPairwiseCost(const int edge_index, const int node_1, const int node_2, const long label_1, const long label_2) const
+{
+  double alpha_1 = calcAlpha(node_pixels_[node_1], label_1);
+  double alpha_2 = calcAlpha(node_pixels_[node_2], label_2);
+  return abs(alpha_1 - alpha_2) * SMOOTHNESS_TERM_WEIGHT_ * node_neighbor_graph_.getWeight(edge_index);
+}
+void AlphaMattingCostFunctor::calcLabelEmbeddings(const int node, const long *labels, const int NUM_LABELS, double *embeddings) const
+{
+  for (int label_index = 0; label_index < NUM_LABELS; label_index++)
+    embeddings[label_index] = calcAlpha(node_pixels_[node], labels[label_index]);
+}
+double AlphaMattingCostFunctor::getEdgeWeight(const int edge_index, const int node_1, const int node_2) const
 {
-  assert(pixel_1 < pixel_2);
-  double alpha_1 = calcAlpha(pixel_1, label_1);
-  double alpha_2 = calcAlpha(pixel_2, label_2);
-  return abs(alpha_1 - alpha_2) * SMOOTHNESS_TERM_WEIGHT_ * pixel_neighbor_weights_[min(pixel_1, pixel_2)].at(max(pixel_1, pixel_2));
+  return SMOOTHNESS_TERM_WEIGHT_ * node_neighbor_graph_.getWeight(edge_index);
 }
 
 double AlphaMattingCostFunctor::calcAlpha(const int pixel, const long label) const
@@ -136,59 +355,35 @@ double AlphaMattingCostFunctor::calcAlpha(const int pixel, const long label) con
 
 void AlphaMattingCostFunctor::calcNeighborsInfo()
 {
-  stringstream neighbor_info_filename;
-  neighbor_info_filename << "Cache/" + image_identifier_ + "_neighbor_info";
-  ifstream neighbor_info_in_str(neighbor_info_filename.str());
-  if (neighbor_info_in_str && false) {
-    pixel_neighbors_.assign(IMAGE_WIDTH_ * IMAGE_HEIGHT_, vector<int>());
-    pixel_neighbor_weights_.assign(IMAGE_WIDTH_ * IMAGE_HEIGHT_, map<int, double>());
-    for (int pixel = 0; pixel < IMAGE_WIDTH_ * IMAGE_HEIGHT_; pixel++) {
-      int num_neighbors;
-      int pixel_temp;
-      neighbor_info_in_str >> pixel_temp >> num_neighbors;
-      if (num_neighbors != 0) {
-	if (pixel_temp != pixel) {
-	  cout << pixel << '\t' << pixel_temp << '\t' << num_neighbors << endl;
-	  exit(1);
-	}
-      }
-      for (int i = 0; i < num_neighbors; i++) {
-        int neighbor_pixel;
-        double weight;
-        neighbor_info_in_str >> neighbor_pixel >> weight;
-	//cout << neighbor_pixel << '\t' << weight << endl;
-        pixel_neighbors_[pixel].push_back(neighbor_pixel);
-        pixel_neighbor_weights_[pixel][neighbor_pixel] = weight;
-      }
-    }
-    
-    neighbor_info_in_str.close();
-    
-    
-    // double sum = 0;
-    // for (map<int, double>::const_iterator neighbor_pixel_it = pixel_neighbor_weights_[37570].begin(); neighbor_pixel_it != pixel_neighbor_weights_[37570].end(); neighbor_pixel_it++) {
-    //   cout << neighbor_pixel_it->first % IMAGE_WIDTH_<< '\t' << neighbor_pixel_it->first / IMAGE_WIDTH_ << '\t' << neighbor_pixel_it->second << endl;
-    //   sum += neighbor_pixel_it->second;
-    // }
-    // cout << sum << endl;
-    // exit(1);
-    
+  const uint64_t NEIGHBOR_GRAPH_KEY = calcNeighborGraphKey(0);
+  const string NEIGHBOR_GRAPH_FILENAME = neighbor_graph_cache::getCacheFilename(CACHE_DIRECTORY_, NEIGHBOR_GRAPH_KEY);
+  if (CACHE_DIRECTORY_.empty() == false && neighbor_graph_cache::loadNeighborGraph(NEIGHBOR_GRAPH_FILENAME, NEIGHBOR_GRAPH_KEY, pixel_neighbor_graph_))
     return;
-  }
-  
   
-  pixel_neighbors_.assign(IMAGE_WIDTH_ * IMAGE_HEIGHT_, vector<int>());
-  pixel_neighbor_weights_.assign(IMAGE_WIDTH_ * IMAGE_HEIGHT_, map<int, double>());
+  const Rect IMAGE_RECT(0, 0, IMAGE_WIDTH_, IMAGE_HEIGHT_);
+  vector<vector<double> > guidance_image_values;
+  vector<vector<double> > guidance_image_means;
+  vector<double> guidance_image_var_inverses;
+  calcGuidanceImageRect(IMAGE_RECT, guidance_image_values, guidance_image_means, guidance_image_var_inverses);
   
-  ImageMask unknown_mask = ImageMask(true, IMAGE_WIDTH_, IMAGE_HEIGHT_) - foreground_mask_ - background_mask_;
-  //for (int c = 0; c < NEIGHBOR_WINDOW_SIZE_ - 1; c++)
-  //unknown_mask.dilate();
+  vector<int> offsets;
+  vector<int> neighbors;
+  vector<double> weights;
+  calcNeighborWeightBands(IMAGE_RECT, guidance_image_values, guidance_image_means, guidance_image_var_inverses, IMAGE_RECT, offsets, neighbors, weights);
+  pixel_neighbor_graph_.assign(offsets, neighbors, weights);
   
-  const int NUM_PIXELS = IMAGE_WIDTH_ * IMAGE_HEIGHT_;
-  vector<vector<double> > guidance_image_values(3, vector<double>(NUM_PIXELS));
-  for (int y = 0; y < IMAGE_HEIGHT_; y++) {
-    for (int x = 0; x < IMAGE_WIDTH_; x++) {
-      int pixel = y * IMAGE_WIDTH_ + x;
+  if (CACHE_DIRECTORY_.empty() == false)
+    neighbor_graph_cache::saveNeighborGraph(NEIGHBOR_GRAPH_FILENAME, NEIGHBOR_GRAPH_KEY, pixel_neighbor_graph_);
+}
+
+//Guidance image values of the pixels in rect (scaled to [0, 1)) together with the means and inverted regularized covariances of the windows centered at them. Windows are clipped at the border of rect like at the image border. Arrays are indexed row by row relative to the top left pixel of rect.
+void AlphaMattingCostFunctor::calcGuidanceImageRect(const Rect &rect, vector<vector<double> > &guidance_image_values, vector<vector<double> > &guidance_image_means, vector<double> &guidance_image_var_inverses) const
+{
+  const int NUM_PIXELS = rect.width * rect.height;
+  guidance_image_values.assign(3, vector<double>(NUM_PIXELS));
+  for (int y = rect.y; y < rect.y + rect.height; y++) {
+    for (int x = rect.x; x < rect.x + rect.width; x++) {
+      int pixel = (y - rect.y) * rect.width + (x - rect.x);
       Vec3b guidance_image_color = image_.at<Vec3b>(y, x);
       for (int c = 0; c < 3; c++) {
 	guidance_image_values[c][pixel] = 1.0 * guidance_image_color[c] / 256;
@@ -196,127 +391,124 @@ void AlphaMattingCostFunctor::calcNeighborsInfo()
     }
   }
   
-  vector<vector<double> > guidance_image_means;
   vector<vector<double> > guidance_image_vars;
-  calcWindowMeansAndVars(guidance_image_values, IMAGE_WIDTH_, IMAGE_HEIGHT_, NEIGHBOR_WINDOW_SIZE_, guidance_image_means, guidance_image_vars);
+  calcWindowMeansAndVars(guidance_image_values, rect.width, rect.height, NEIGHBOR_WINDOW_SIZE_, guidance_image_means, guidance_image_vars);
   
-  double epsilon = 0.00001;
-  for (int pixel = 0; pixel < IMAGE_WIDTH_ * IMAGE_HEIGHT_; pixel++) {
-    vector<int> unknown_window_pixels = unknown_mask.findMaskWindowPixels(pixel, NEIGHBOR_WINDOW_SIZE_);
-    vector<int> window_pixels = findWindowPixels(pixel, IMAGE_WIDTH_, IMAGE_HEIGHT_, NEIGHBOR_WINDOW_SIZE_);
-    if (unknown_window_pixels.size() == 0)
-      continue;
-    vector<vector<double> > guidance_image_var(3, vector<double>(3));
-    for (int c_1 = 0; c_1 < 3; c_1++)
-      for (int c_2 = 0; c_2 < 3; c_2++)
-	guidance_image_var[c_1][c_2] = guidance_image_vars[c_1 * 3 + c_2][pixel] + epsilon / 9 * (c_1 == c_2);
-    vector<double> guidance_image_mean(3);
-    for (int c = 0; c < 3; c++)
-      guidance_image_mean[c] = guidance_image_means[c][pixel];
-    vector<vector<double> > guidance_image_var_inverse = calcInverse(guidance_image_var);
-    for (vector<int>::const_iterator window_pixel_it = window_pixels.begin(); window_pixel_it != window_pixels.end(); window_pixel_it++) {
-      for (vector<int>::const_iterator unknown_window_pixel_it = unknown_window_pixels.begin(); unknown_window_pixel_it != unknown_window_pixels.end(); unknown_window_pixel_it++) {
-	if (*unknown_window_pixel_it == *window_pixel_it)
-	  continue;
-	vector<double> color_1(3);
-	for (int c = 0; c < 3; c++)
-	  color_1[c] = guidance_image_values[c][*window_pixel_it];
-	vector<double> color_2(3);
-	for (int c = 0; c < 3; c++)
-          color_2[c] = guidance_image_values[c][*unknown_window_pixel_it];
-	
-	double weight = 0;
+  const double epsilon = NEIGHBOR_WINDOW_EPSILON_;
+  guidance_image_var_inverses.resize(NUM_PIXELS * 9);
+  parallelFor(0, NUM_PIXELS, getNumThreads(), [&](const int, const int pixel_begin, const int pixel_end) {
+      const int BATCH_SIZE = SYMMETRIC_3X3_BATCH_SIZE;
+      double guidance_image_var_batch[6 * BATCH_SIZE];
+      double guidance_image_var_inverse_batch[6 * BATCH_SIZE];
+      for (int batch_begin = pixel_begin; batch_begin < pixel_end; batch_begin += BATCH_SIZE) {
+	const int NUM_BATCH_PIXELS = min(BATCH_SIZE, pixel_end - batch_begin);
 	for (int c_1 = 0; c_1 < 3; c_1++)
-          for (int c_2 = 0; c_2 < 3; c_2++)
-	    weight += (color_1[c_1] - guidance_image_mean[c_1]) * guidance_image_var_inverse[c_1][c_2] * (color_2[c_2] - guidance_image_mean[c_2]);
-	weight = (weight + 1) / pow(NEIGHBOR_WINDOW_SIZE_, 4);
-	
-	// if (weight < 0) {
-	//   cout << pixel << '\t' << window_pixels.size() << endl;
-	//   for (int c_1 = 0; c_1 < 3; c_1++)
-        //     for (int c_2 = 0; c_2 < 3; c_2++)
-	//       cout << guidance_image_var[c_1][c_2] << '\t' << guidance_image_var_inverse[c_1][c_2] << endl;
-	//   cout << weight << endl;
-	//   for (int c = 0; c < 3; c++)
-	//     cout << guidance_image_mean[c] << '\t' << color_1[c]  << '\t' << color_2[c] << endl;
-        //    exit(1);
-	// }
-	
-        // if (min(*window_pixel_it, *unknown_window_pixel_it) == 19586) {
-        //   cout << pixel << '\t' << window_pixels.size() << endl;
-        //   for (int c_1 = 0; c_1 < 3; c_1++)
-        //     for (int c_2 = 0; c_2 < 3; c_2++)
-        //       cout << guidance_image_var[c_1][c_2] << '\t' << guidance_image_var_inverse[c_1][c_2] << endl;
-	//   cout << weight << endl;
-        //   //exit(1);
-        // }
-	
-	//if (abs(*unknown_window_pixel_it % IMAGE_WIDTH_ - *window_pixel_it % IMAGE_WIDTH_) > 1 || abs(*unknown_window_pixel_it / IMAGE_WIDTH_ - *window_pixel_it / IMAGE_WIDTH_) > 1)
-	//continue;
-	pixel_neighbor_weights_[min(*window_pixel_it, *unknown_window_pixel_it)][max(*window_pixel_it, *unknown_window_pixel_it)] += weight;
-	//pixel_neighbor_weights_[max(*window_pixel_it, *unknown_window_pixel_it)][min(*window_pixel_it, *unknown_window_pixel_it)] += weight;
+	  for (int c_2 = c_1; c_2 < 3; c_2++)
+	    for (int index = 0; index < NUM_BATCH_PIXELS; index++)
+	      guidance_image_var_batch[getSymmetric3x3Plane(c_1, c_2) * BATCH_SIZE + index] = guidance_image_vars[c_1 * 3 + c_2][batch_begin + index] + epsilon / 9 * (c_1 == c_2);
+	invertSymmetric3x3(NUM_BATCH_PIXELS, guidance_image_var_batch, guidance_image_var_inverse_batch);
+	for (int index = 0; index < NUM_BATCH_PIXELS; index++)
+	  for (int c_1 = 0; c_1 < 3; c_1++)
+	    for (int c_2 = 0; c_2 < 3; c_2++)
+	      guidance_image_var_inverses[(batch_begin + index) * 9 + c_1 * 3 + c_2] = guidance_image_var_inverse_batch[getSymmetric3x3Plane(c_1, c_2) * BATCH_SIZE + index];
       }
-    }
-  }
+    });
+}
 
-  // vector<map<int, double> > half_window_pixel_neighbor_weights(IMAGE_WIDTH_ * IMAGE_HEIGHT_);
-  // for (int pixel = 0; pixel < IMAGE_WIDTH_ * IMAGE_HEIGHT_; pixel++)
-  //   for (map<int, double>::const_iterator neighbor_pixel_it = pixel_neighbor_weights_[pixel].begin(); neighbor_pixel_it != pixel_neighbor_weights_[pixel].end(); neighbor_pixel_it++)
-  //     if (neighbor_pixel_it->first > pixel)
-  // 	half_window_pixel_neighbor_weights[pixel][neighbor_pixel_it->first] = neighbor_pixel_it->second / 2;
-  // pixel_neighbor_weights_ = half_window_pixel_neighbor_weights;
-  
-  // double sum = 0;
-  // for (map<int, double>::const_iterator neighbor_pixel_it = pixel_neighbor_weights_[230].begin(); neighbor_pixel_it != pixel_neighbor_weights_[230].end(); neighbor_pixel_it++) {
-  //   cout << neighbor_pixel_it->first % IMAGE_WIDTH_ << '\t' << neighbor_pixel_it->first / IMAGE_WIDTH_ << '\t' << neighbor_pixel_it->second << endl;
-  //   sum += neighbor_pixel_it->second;
-  // }
-  // cout << sum << endl;
-  // exit(1);
-  
-  for (int pixel = 0; pixel < IMAGE_WIDTH_ * IMAGE_HEIGHT_; pixel++)
-    for (map<int, double>::const_iterator neighbor_pixel_it = pixel_neighbor_weights_[pixel].begin(); neighbor_pixel_it != pixel_neighbor_weights_[pixel].end(); neighbor_pixel_it++)
-      pixel_neighbors_[pixel].push_back(neighbor_pixel_it->first);
-  
+//neighbor rows of the pixels in rect (see calcNeighborWeightRows) with offsets relative to its top left pixel
+void AlphaMattingCostFunctor::calcNeighborWeightBands(const Rect &rect, const vector<vector<double> > &guidance_image_values, const vector<vector<double> > &guidance_image_means, const vector<double> &guidance_image_var_inverses, const Rect &GUIDANCE_RECT, vector<int> &offsets, vector<int> &neighbors, vector<double> &weights) const
+{
+  //rows are split into bands which are built independently and concatenated in band order, so the graph does not depend on the number of threads
+  const int NUM_BANDS = min(getNumThreads() * 4, rect.height);
+  vector<vector<int> > band_offsets(NUM_BANDS);
+  vector<vector<int> > band_neighbors(NUM_BANDS);
+  vector<vector<double> > band_weights(NUM_BANDS);
+  parallelFor(rect.y, rect.y + rect.height, NUM_BANDS, [&](const int band_index, const int band_first_row, const int band_last_row) {
+      calcNeighborWeightRows(Rect(rect.x, band_first_row, rect.width, band_last_row - band_first_row), guidance_image_values, guidance_image_means, guidance_image_var_inverses, GUIDANCE_RECT, band_offsets[band_index], band_neighbors[band_index], band_weights[band_index]);
+    });
   
-  ofstream neighbor_info_out_str(neighbor_info_filename.str());
-  for (int pixel = 0; pixel < IMAGE_WIDTH_ * IMAGE_HEIGHT_; pixel++) {
-    //if (pixel_neighbors_[pixel].size() == 0)
-    //continue;
-    if (pixel_neighbors_[pixel].size() != pixel_neighbor_weights_[pixel].size()) {
-      cout << pixel << '\t' << pixel_neighbors_[pixel].size() << '\t' << pixel_neighbor_weights_[pixel].size() << endl;
-      exit(1);
-    }
-    neighbor_info_out_str << pixel << '\t' << pixel_neighbors_[pixel].size() << endl;
-    for (map<int, double>::const_iterator neighbor_pixel_it = pixel_neighbor_weights_[pixel].begin(); neighbor_pixel_it != pixel_neighbor_weights_[pixel].end(); neighbor_pixel_it++) {
-      neighbor_info_out_str << neighbor_pixel_it->first << '\t' << neighbor_pixel_it->second << endl;
-    }
+  long num_edges = 0;
+  for (int band_index = 0; band_index < NUM_BANDS; band_index++)
+    num_edges += band_neighbors[band_index].size();
+  //band offsets are shifted by the edges of the previous bands, which has to fit an int
+  NeighborGraph::checkNumEdges(num_edges);
+  offsets.assign(1, 0);
+  offsets.reserve(rect.width * rect.height + 1);
+  neighbors.clear();
+  neighbors.reserve(num_edges);
+  weights.clear();
+  weights.reserve(num_edges);
+  for (int band_index = 0; band_index < NUM_BANDS; band_index++) {
+    const int BAND_EDGE_OFFSET = neighbors.size();
+    for (vector<int>::const_iterator offset_it = band_offsets[band_index].begin() + 1; offset_it != band_offsets[band_index].end(); offset_it++)
+      offsets.push_back(*offset_it + BAND_EDGE_OFFSET);
+    neighbors.insert(neighbors.end(), band_neighbors[band_index].begin(), band_neighbors[band_index].end());
+    weights.insert(weights.end(), band_weights[band_index].begin(), band_weights[band_index].end());
+    vector<int>().swap(band_neighbors[band_index]);
+    vector<double>().swap(band_weights[band_index]);
   }
-  neighbor_info_out_str.close();
 }
 
-void AlphaMattingCostFunctor::calcNeighborsInfoGeodesicDistance()
+//Every pixel in rect collects the weights to its neighbors with larger indices (those sharing a window with it), so the graph is written row by row. A window containing both pixels contributes (1 + (I_1 - mean)^T (var + epsilon)^-1 (I_2 - mean)) / window_size^4 once for each of the two pixels which is unknown. Offsets are relative to the top left pixel of rect, guidance image arrays to that of GUIDANCE_RECT, which has to contain the windows of all these pairs.
+void AlphaMattingCostFunctor::calcNeighborWeightRows(const Rect &rect, const vector<vector<double> > &guidance_image_values, const vector<vector<double> > &guidance_image_means, const vector<double> &guidance_image_var_inverses, const Rect &GUIDANCE_RECT, vector<int> &offsets, vector<int> &neighbors, vector<double> &weights) const
 {
-  stringstream neighbor_info_filename;
-  neighbor_info_filename << "Cache/" + image_identifier_ + "_neighbor_info";
-  ifstream neighbor_info_in_str(neighbor_info_filename.str());
-  if (neighbor_info_in_str) {
-    pixel_neighbors_.assign(IMAGE_WIDTH_ * IMAGE_HEIGHT_, vector<int>());
-    pixel_neighbor_weights_.assign(IMAGE_WIDTH_ * IMAGE_HEIGHT_, map<int, double>());
-    for (int pixel = 0; pixel < IMAGE_WIDTH_ * IMAGE_HEIGHT_; pixel++) {
-      int num_neighbors;
-      neighbor_info_in_str >> num_neighbors;
-      for (int i = 0; i < num_neighbors; i++) {
-	int neighbor_pixel;
-	double weight;
-	neighbor_info_in_str >> neighbor_pixel >> weight;
-	pixel_neighbors_[pixel].push_back(neighbor_pixel);
-	pixel_neighbor_weights_[pixel][neighbor_pixel] = weight;
+  const int WINDOW_RADIUS = (NEIGHBOR_WINDOW_SIZE_ - 1) / 2;
+  const double WINDOW_NORMALIZER = pow(NEIGHBOR_WINDOW_SIZE_, 4);
+  offsets.assign(1, 0);
+  offsets.reserve(rect.width * rect.height + 1);
+  neighbors.clear();
+  weights.clear();
+  for (int rect_pixel = 0; rect_pixel < rect.width * rect.height; rect_pixel++) {
+    int x = rect.x + rect_pixel % rect.width;
+    int y = rect.y + rect_pixel / rect.width;
+    int pixel = y * IMAGE_WIDTH_ + x;
+    int guidance_pixel = (y - GUIDANCE_RECT.y) * GUIDANCE_RECT.width + (x - GUIDANCE_RECT.x);
+    const bool IS_UNKNOWN = foreground_mask_.at(pixel) == false && background_mask_.at(pixel) == false;
+    for (int delta_y = 0; delta_y <= WINDOW_RADIUS * 2; delta_y++) {
+      for (int delta_x = -WINDOW_RADIUS * 2; delta_x <= WINDOW_RADIUS * 2; delta_x++) {
+	if (delta_y == 0 && delta_x <= 0)
+	  continue;
+	int neighbor_x = x + delta_x;
+	int neighbor_y = y + delta_y;
+	if (neighbor_x < 0 || neighbor_x >= IMAGE_WIDTH_ || neighbor_y >= IMAGE_HEIGHT_)
+	  continue;
+	int neighbor_pixel = neighbor_y * IMAGE_WIDTH_ + neighbor_x;
+	int neighbor_guidance_pixel = guidance_pixel + delta_y * GUIDANCE_RECT.width + delta_x;
+	int num_unknown_pixels = IS_UNKNOWN + (foreground_mask_.at(neighbor_pixel) == false && background_mask_.at(neighbor_pixel) == false);
+	if (num_unknown_pixels == 0)
+	  continue;
+	
+	double weight = 0;
+	for (int window_y = max(neighbor_y - WINDOW_RADIUS, 0); window_y <= min(y + WINDOW_RADIUS, IMAGE_HEIGHT_ - 1); window_y++) {
+	  for (int window_x = max(max(x, neighbor_x) - WINDOW_RADIUS, 0); window_x <= min(min(x, neighbor_x) + WINDOW_RADIUS, IMAGE_WIDTH_ - 1); window_x++) {
+	    int window_guidance_pixel = (window_y - GUIDANCE_RECT.y) * GUIDANCE_RECT.width + (window_x - GUIDANCE_RECT.x);
+	    const double *guidance_image_var_inverse = &guidance_image_var_inverses[window_guidance_pixel * 9];
+	    double color_diff_1[3], color_diff_2[3];
+	    for (int c = 0; c < 3; c++) {
+	      color_diff_1[c] = guidance_image_values[c][guidance_pixel] - guidance_image_means[c][window_guidance_pixel];
+	      color_diff_2[c] = guidance_image_values[c][neighbor_guidance_pixel] - guidance_image_means[c][window_guidance_pixel];
+	    }
+	    double window_weight = 0;
+	    for (int c_1 = 0; c_1 < 3; c_1++)
+	      for (int c_2 = 0; c_2 < 3; c_2++)
+		window_weight += color_diff_1[c_1] * guidance_image_var_inverse[c_1 * 3 + c_2] * color_diff_2[c_2];
+	    weight += (window_weight + 1) / WINDOW_NORMALIZER;
+	  }
+	}
+	neighbors.push_back(neighbor_pixel);
+	weights.push_back(weight * num_unknown_pixels);
       }
     }
-    neighbor_info_in_str.close();
-    return;
+    offsets.push_back(neighbors.size());
   }
+}
+
+void AlphaMattingCostFunctor::calcNeighborsInfoGeodesicDistance()
+{
+  const uint64_t NEIGHBOR_GRAPH_KEY = calcNeighborGraphKey(1);
+  const string NEIGHBOR_GRAPH_FILENAME = neighbor_graph_cache::getCacheFilename(CACHE_DIRECTORY_, NEIGHBOR_GRAPH_KEY);
+  if (CACHE_DIRECTORY_.empty() == false && neighbor_graph_cache::loadNeighborGraph(NEIGHBOR_GRAPH_FILENAME, NEIGHBOR_GRAPH_KEY, pixel_neighbor_graph_))
+    return;
   
   vector<vector<double> > distance_map(IMAGE_WIDTH_ * IMAGE_HEIGHT_);
   for (int pixel = 0; pixel < IMAGE_WIDTH_ * IMAGE_HEIGHT_; pixel++) {
@@ -334,12 +526,12 @@ void AlphaMattingCostFunctor::calcNeighborsInfoGeodesicDistance()
     distance_map[pixel] = neighbor_distances;
   }
   
-  pixel_neighbors_.assign(IMAGE_WIDTH_ * IMAGE_HEIGHT_, vector<int>());
-  pixel_neighbor_weights_.assign(IMAGE_WIDTH_ * IMAGE_HEIGHT_, map<int, double>());
+  vector<int> offsets(IMAGE_WIDTH_ * IMAGE_HEIGHT_ + 1, 0);
+  vector<int> neighbors;
+  vector<double> weights;
   vector<double> distances;
   for (int pixel = 0; pixel < IMAGE_WIDTH_ * IMAGE_HEIGHT_; pixel++) {
-    if (pixel % 100000 == 0)
-      cout << pixel << endl;
+    offsets[pixel] = neighbors.size();
     vector<pair<double, int> > distance_neighbor_pairs;
     int x = pixel % IMAGE_WIDTH_;
     int y = pixel / IMAGE_WIDTH_;
@@ -363,36 +555,240 @@ void AlphaMattingCostFunctor::calcNeighborsInfoGeodesicDistance()
     sort(distance_neighbor_pairs.begin(), distance_neighbor_pairs.end());
     //cout << pixel << '\t' << distance_neighbor_pairs.size() << endl;
     //for (int i = 0; i < min(NUM_NEIGHBORS_, static_cast<int>(distance_neighbor_pairs.size())); i++) {
+    vector<pair<int, double> > neighbor_distance_pairs;
     for (int i = 0; i < distance_neighbor_pairs.size(); i++) {
       if (i < NUM_NEIGHBORS_ || (abs(distance_neighbor_pairs[i].second % IMAGE_WIDTH_ - x) <= 1 && abs(distance_neighbor_pairs[i].second / IMAGE_WIDTH_ - y) <= 1)) {
-	pixel_neighbors_[pixel].push_back(distance_neighbor_pairs[i].second);
-	pixel_neighbor_weights_[pixel][distance_neighbor_pairs[i].second] = distance_neighbor_pairs[i].first;
+	neighbor_distance_pairs.push_back(make_pair(distance_neighbor_pairs[i].second, distance_neighbor_pairs[i].first));
 	distances.push_back(distance_neighbor_pairs[i].first);
       }
     }
-    //cout << pixel_neighbors_[pixel].size() << endl;
-    //exit(1);
+    sort(neighbor_distance_pairs.begin(), neighbor_distance_pairs.end());
+    for (vector<pair<int, double> >::const_iterator neighbor_it = neighbor_distance_pairs.begin(); neighbor_it != neighbor_distance_pairs.end(); neighbor_it++) {
+      neighbors.push_back(neighbor_it->first);
+      weights.push_back(neighbor_it->second);
+    }
   }
+  offsets[IMAGE_WIDTH_ * IMAGE_HEIGHT_] = neighbors.size();
   
   vector<double> distance_mean_and_svar = calcMeanAndSVar(distances);
+  for (vector<double>::iterator weight_it = weights.begin(); weight_it != weights.end(); weight_it++)
+    *weight_it = exp(-pow(*weight_it, 2) / (2 * pow(distance_mean_and_svar[1], 2)));
+  pixel_neighbor_graph_.assign(offsets, neighbors, weights);
+  
+  if (CACHE_DIRECTORY_.empty() == false)
+    neighbor_graph_cache::saveNeighborGraph(NEIGHBOR_GRAPH_FILENAME, NEIGHBOR_GRAPH_KEY, pixel_neighbor_graph_);
+}
+
+//cache key of the neighbor graph: everything the graph is computed from (image and trimap contents, window size, epsilon and the kind of neighbor system)
+uint64_t AlphaMattingCostFunctor::calcNeighborGraphKey(const int neighbor_system) const
+{
+  using namespace neighbor_graph_cache;
+  uint64_t key = hashValue(CACHE_FORMAT_VERSION);
+  key = hashValue(neighbor_system, key);
+  key = hashValue(IMAGE_WIDTH_, key);
+  key = hashValue(IMAGE_HEIGHT_, key);
+  key = hashValue(NEIGHBOR_WINDOW_SIZE_, key);
+  key = hashValue(NEIGHBOR_WINDOW_EPSILON_, key);
+  key = hashValue(NUM_NEIGHBORS_, key);
+  for (int y = 0; y < IMAGE_HEIGHT_; y++)
+    key = hashBytes(image_.ptr<uchar>(y), IMAGE_WIDTH_ * 3, key);
+  vector<uchar> trimap_values(IMAGE_WIDTH_ * IMAGE_HEIGHT_);
   for (int pixel = 0; pixel < IMAGE_WIDTH_ * IMAGE_HEIGHT_; pixel++)
-    for (map<int, double>::iterator neighbor_it = pixel_neighbor_weights_[pixel].begin(); neighbor_it != pixel_neighbor_weights_[pixel].end(); neighbor_it++)
-      neighbor_it->second = exp(-pow(neighbor_it->second, 2) / (2 * pow(distance_mean_and_svar[1], 2)));
+    trimap_values[pixel] = foreground_mask_.at(pixel) ? 255 : (background_mask_.at(pixel) ? 0 : 128);
+  return hashBytes(&trimap_values[0], trimap_values.size(), key);
+}
+
+const NeighborGraph &AlphaMattingCostFunctor::getNeighborGraph() const
+{
+  return pixel_neighbor_graph_;
+}
+
+//Only unknown pixels become nodes (in pixel order). Edges between unknown pixels are kept, and the pairwise cost w * |alpha - alpha_known| of an edge to a known pixel is folded into the unary cost as w * (1 - alpha) for foreground and w * alpha for background neighbors. Edges without positive weight are dropped as the solver does.
+void AlphaMattingCostFunctor::calcNodeGraph()
+{
+  const int NUM_PIXELS = IMAGE_WIDTH_ * IMAGE_HEIGHT_;
+  node_pixels_.clear();
+  pixel_nodes_.assign(NUM_PIXELS, -1);
+  for (int pixel = 0; pixel < NUM_PIXELS; pixel++) {
+    if (foreground_mask_.at(pixel) || background_mask_.at(pixel))
+      continue;
+    pixel_nodes_[pixel] = node_pixels_.size();
+    node_pixels_.push_back(pixel);
+  }
   
+  const int NUM_NODES = node_pixels_.size();
+  node_foreground_weights_.assign(NUM_NODES, 0);
+  node_background_weights_.assign(NUM_NODES, 0);
+  node_fixed_neighbor_offsets_.assign(NUM_NODES + 1, 0);
+  node_fixed_neighbor_weights_.clear();
+  node_fixed_neighbor_alphas_.clear();
+  vector<int> offsets(NUM_NODES + 1, 0);
+  vector<int> neighbors;
+  vector<double> weights;
+  for (int pixel = 0; pixel < NUM_PIXELS; pixel++) {
+    const int node = pixel_nodes_[pixel];
+    for (int edge_index = pixel_neighbor_graph_.getEdgeBegin(pixel); edge_index < pixel_neighbor_graph_.getEdgeEnd(pixel); edge_index++) {
+      const int neighbor_pixel = pixel_neighbor_graph_.getNeighbor(edge_index);
+      const int neighbor_node = pixel_nodes_[neighbor_pixel];
+      const double weight = pixel_neighbor_graph_.getWeight(edge_index);
+      if (node >= 0 && neighbor_node >= 0) {
+	neighbors.push_back(neighbor_node);
+	weights.push_back(weight);
+	continue;
+      }
+      if (weight * SMOOTHNESS_TERM_WEIGHT_ <= 0 || (node < 0 && neighbor_node < 0))
+	continue;
+      const int unknown_node = node >= 0 ? node : neighbor_node;
+      const int known_pixel = node >= 0 ? neighbor_pixel : pixel;
+      if (foreground_mask_.at(known_pixel))
+	node_foreground_weights_[unknown_node] += weight * SMOOTHNESS_TERM_WEIGHT_;
+      else
+	node_background_weights_[unknown_node] += weight * SMOOTHNESS_TERM_WEIGHT_;
+    }
+    if (node >= 0)
+      offsets[node + 1] = neighbors.size();
+  }
+  node_neighbor_graph_.assign(offsets, neighbors, weights);
+}
+
+//The folding of calcNodeGraph for a subset of the unknown pixels, where edges to unknown pixels outside it are kept per node with the alpha of that pixel fixed. Edges are stored at their upper pixel, so those reaching a node from above are looked up in the rows of the pixels up to 2 * WINDOW_RADIUS rows above it.
+void AlphaMattingCostFunctor::setNodePixels(const vector<int> &node_pixels, const vector<long> &pixel_solution)
+{
+  const int WINDOW_RADIUS = (NEIGHBOR_WINDOW_SIZE_ - 1) / 2;
+  node_pixels_ = node_pixels;
+  const int NUM_NODES = node_pixels_.size();
+  for (int node = 0; node < NUM_NODES; node++)
+    pixel_nodes_[node_pixels_[node]] = node;
   
-  ofstream neighbor_info_out_str(neighbor_info_filename.str());
-  for (int pixel = 0; pixel < IMAGE_WIDTH_ * IMAGE_HEIGHT_; pixel++) {
-    neighbor_info_out_str << pixel_neighbors_[pixel].size() << endl;
-    for (map<int, double>::const_iterator neighbor_pixel_it = pixel_neighbor_weights_[pixel].begin(); neighbor_pixel_it != pixel_neighbor_weights_[pixel].end(); neighbor_pixel_it++) {
-      neighbor_info_out_str << neighbor_pixel_it->first << '\t' << neighbor_pixel_it->second << endl;;
+  node_foreground_weights_.assign(NUM_NODES, 0);
+  node_background_weights_.assign(NUM_NODES, 0);
+  node_fixed_neighbor_offsets_.assign(1, 0);
+  node_fixed_neighbor_weights_.clear();
+  node_fixed_neighbor_alphas_.clear();
+  auto addFixedNeighbor = [&](const int node, const int neighbor_pixel, const double weight) {
+    if (weight * SMOOTHNESS_TERM_WEIGHT_ <= 0)
+      return;
+    if (foreground_mask_.at(neighbor_pixel))
+      node_foreground_weights_[node] += weight * SMOOTHNESS_TERM_WEIGHT_;
+    else if (background_mask_.at(neighbor_pixel))
+      node_background_weights_[node] += weight * SMOOTHNESS_TERM_WEIGHT_;
+    else {
+      node_fixed_neighbor_weights_.push_back(weight * SMOOTHNESS_TERM_WEIGHT_);
+      node_fixed_neighbor_alphas_.push_back(calcAlpha(neighbor_pixel, pixel_solution[neighbor_pixel]));
+    }
+  };
+  
+  vector<int> offsets(NUM_NODES + 1, 0);
+  vector<int> neighbors;
+  vector<double> weights;
+  for (int node = 0; node < NUM_NODES; node++) {
+    const int pixel = node_pixels_[node];
+    for (int edge_index = pixel_neighbor_graph_.getEdgeBegin(pixel); edge_index < pixel_neighbor_graph_.getEdgeEnd(pixel); edge_index++) {
+      const int neighbor_pixel = pixel_neighbor_graph_.getNeighbor(edge_index);
+      const int neighbor_node = getPixelNode(neighbor_pixel);
+      if (neighbor_node >= 0) {
+	neighbors.push_back(neighbor_node);
+	weights.push_back(pixel_neighbor_graph_.getWeight(edge_index));
+      } else
+	addFixedNeighbor(node, neighbor_pixel, pixel_neighbor_graph_.getWeight(edge_index));
     }
+    offsets[node + 1] = neighbors.size();
+    
+    const int x = pixel % IMAGE_WIDTH_;
+    const int y = pixel / IMAGE_WIDTH_;
+    for (int neighbor_y = max(y - WINDOW_RADIUS * 2, 0); neighbor_y <= y; neighbor_y++) {
+      for (int neighbor_x = max(x - WINDOW_RADIUS * 2, 0); neighbor_x <= min(x + WINDOW_RADIUS * 2, IMAGE_WIDTH_ - 1); neighbor_x++) {
+	const int neighbor_pixel = neighbor_y * IMAGE_WIDTH_ + neighbor_x;
+	if (neighbor_pixel >= pixel || getPixelNode(neighbor_pixel) >= 0)
+	  continue;
+	const int edge_index = pixel_neighbor_graph_.findEdge(neighbor_pixel, pixel);
+	if (edge_index >= 0)
+	  addFixedNeighbor(node, neighbor_pixel, pixel_neighbor_graph_.getWeight(edge_index));
+      }
+    }
+    node_fixed_neighbor_offsets_.push_back(node_fixed_neighbor_weights_.size());
   }
-  neighbor_info_out_str.close();
+  node_neighbor_graph_.assign(offsets, neighbors, weights);
 }
 
-std::vector<std::vector<int> > AlphaMattingCostFunctor::getPixelNeighbors() const
+//node of pixel, or -1; an entry of pixel_nodes_ counts only if node_pixels_ points back to the pixel, so switching the node set does not have to clear the old entries
+int AlphaMattingCostFunctor::getPixelNode(const int pixel) const
 {
-  return pixel_neighbors_;
+  const int node = pixel_nodes_[pixel];
+  return node >= 0 && node < static_cast<int>(node_pixels_.size()) && node_pixels_[node] == pixel ? node : -1;
+}
+
+//summed pairwise costs of the edges of node to unknown pixels which are no nodes
+double AlphaMattingCostFunctor::calcFixedNeighborCost(const int node, const double alpha) const
+{
+  double cost = 0;
+  for (int index = node_fixed_neighbor_offsets_[node]; index < node_fixed_neighbor_offsets_[node + 1]; index++)
+    cost += node_fixed_neighbor_weights_[index] * abs(alpha - node_fixed_neighbor_alphas_[index]);
+  return cost;
+}
+
+int AlphaMattingCostFunctor::getNumNodes() const
+{
+  return node_pixels_.size();
+}
+
+const NeighborGraph &AlphaMattingCostFunctor::getNodeGraph() const
+{
+  return node_neighbor_graph_;
+}
+
+const vector<int> &AlphaMattingCostFunctor::getNodePixels() const
+{
+  return node_pixels_;
+}
+
+//Edges are stored at their upper pixel and reach 2 * WINDOW_RADIUS rows down and 2 * WINDOW_RADIUS columns to either side, so the pixels from 2 * WINDOW_RADIUS rows above dirty_rect to its bottom row and from 2 * WINDOW_RADIUS columns left to 2 * WINDOW_RADIUS columns right of it hold all edges with an end pixel inside it. Their windows lie within WINDOW_RADIUS pixels of these and need guidance statistics of WINDOW_RADIUS more pixels, which gives the margin of the guidance rectangle.
+void AlphaMattingCostFunctor::updateTrimap(const ImageMask &foreground_mask, const ImageMask &background_mask, const Rect &dirty_rect, const vector<int> &refreshed_pixels)
+{
+  const Rect DIRTY_RECT = dirty_rect & Rect(0, 0, IMAGE_WIDTH_, IMAGE_HEIGHT_);
+  for (int y = DIRTY_RECT.y; y < DIRTY_RECT.y + DIRTY_RECT.height; y++) {
+    for (int x = DIRTY_RECT.x; x < DIRTY_RECT.x + DIRTY_RECT.width; x++) {
+      const int pixel = y * IMAGE_WIDTH_ + x;
+      foreground_mask_.set(pixel, foreground_mask.at(pixel));
+      background_mask_.set(pixel, background_mask.at(pixel));
+    }
+  }
+  
+  const int WINDOW_RADIUS = (NEIGHBOR_WINDOW_SIZE_ - 1) / 2;
+  if (DIRTY_RECT.area() > 0) {
+    const int FIRST_X = max(DIRTY_RECT.x - WINDOW_RADIUS * 2, 0);
+    const int FIRST_Y = max(DIRTY_RECT.y - WINDOW_RADIUS * 2, 0);
+    const int LAST_X = min(DIRTY_RECT.x + DIRTY_RECT.width + WINDOW_RADIUS * 2, IMAGE_WIDTH_);
+    const int LAST_Y = DIRTY_RECT.y + DIRTY_RECT.height;
+    const Rect RECT(FIRST_X, FIRST_Y, LAST_X - FIRST_X, LAST_Y - FIRST_Y);
+    const int GUIDANCE_X_1 = max(FIRST_X - WINDOW_RADIUS * 2, 0);
+    const int GUIDANCE_Y_1 = max(FIRST_Y - WINDOW_RADIUS * 2, 0);
+    const int GUIDANCE_X_2 = min(LAST_X + WINDOW_RADIUS * 2, IMAGE_WIDTH_);
+    const int GUIDANCE_Y_2 = min(LAST_Y + WINDOW_RADIUS * 2, IMAGE_HEIGHT_);
+    const Rect GUIDANCE_RECT(GUIDANCE_X_1, GUIDANCE_Y_1, GUIDANCE_X_2 - GUIDANCE_X_1, GUIDANCE_Y_2 - GUIDANCE_Y_1);
+    vector<vector<double> > guidance_image_values;
+    vector<vector<double> > guidance_image_means;
+    vector<double> guidance_image_var_inverses;
+    calcGuidanceImageRect(GUIDANCE_RECT, guidance_image_values, guidance_image_means, guidance_image_var_inverses);
+    
+    vector<int> offsets;
+    vector<int> neighbors;
+    vector<double> weights;
+    calcNeighborWeightBands(RECT, guidance_image_values, guidance_image_means, guidance_image_var_inverses, GUIDANCE_RECT, offsets, neighbors, weights);
+    vector<int> rect_pixels(RECT.area());
+    for (int rect_pixel = 0; rect_pixel < RECT.area(); rect_pixel++)
+      rect_pixels[rect_pixel] = (RECT.y + rect_pixel / RECT.width) * IMAGE_WIDTH_ + RECT.x + rect_pixel % RECT.width;
+    pixel_neighbor_graph_.replaceNodes(rect_pixels, offsets, neighbors, weights);
+  }
+  
+  for (vector<int>::const_iterator pixel_it = refreshed_pixels.begin(); pixel_it != refreshed_pixels.end(); pixel_it++) {
+    const int foreground_pixel = findNearestMaskPixel(foreground_mask_, *pixel_it, IMAGE_WIDTH_, IMAGE_HEIGHT_);
+    const int background_pixel = findNearestMaskPixel(background_mask_, *pixel_it, IMAGE_WIDTH_, IMAGE_HEIGHT_);
+    if (foreground_pixel >= 0)
+      foreground_distance_map_[*pixel_it] = sqrt(pow(foreground_pixel % IMAGE_WIDTH_ - *pixel_it % IMAGE_WIDTH_, 2) + pow(foreground_pixel / IMAGE_WIDTH_ - *pixel_it / IMAGE_WIDTH_, 2));
+    if (background_pixel >= 0)
+      background_distance_map_[*pixel_it] = sqrt(pow(background_pixel % IMAGE_WIDTH_ - *pixel_it % IMAGE_WIDTH_, 2) + pow(background_pixel / IMAGE_WIDTH_ - *pixel_it / IMAGE_WIDTH_, 2));
+  }
 }
 
 void AlphaMattingCostFunctor::calcDistanceMaps()
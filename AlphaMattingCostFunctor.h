@@ -5,9 +5,11 @@
 #include <vector>
 #include <map>
 #include <string>
+#include <stdint.h>
 
 #include "cv_utils.h"
 #include "CostFunctor.h"
+#include "NeighborGraph.h"
 
 //class cv_utils::ImageMask;
 
@@ -15,7 +17,10 @@ class AlphaMattingCostFunctor : public CostFunctor
 {
  public:
   AlphaMattingCostFunctor(const cv::Mat &image, const std::vector<bool> &foreground_mask, const std::vector<bool> &background_mask);
-  AlphaMattingCostFunctor(const cv::Mat &image, const cv_utils::ImageMask &foreground_mask, const cv_utils::ImageMask &background_mask, const std::string image_identifier);
+  //neighbor graphs are cached in cache_directory unless it is empty
+  AlphaMattingCostFunctor(const cv::Mat &image, const cv_utils::ImageMask &foreground_mask, const cv_utils::ImageMask &background_mask, const std::string &cache_directory = "");
+  //takes over the pixel neighbor graph of an earlier functor with the same masks (e.g. of a previous video frame) instead of computing it from image
+  AlphaMattingCostFunctor(const cv::Mat &image, const cv_utils::ImageMask &foreground_mask, const cv_utils::ImageMask &background_mask, const NeighborGraph &pixel_neighbor_graph);
   
   //virtual void setCurrentSolution(const std::vector<int> &current_solution);
   double calcAlpha(const int pixel, const long label) const;
@@ -23,33 +28,79 @@ class AlphaMattingCostFunctor : public CostFunctor
   virtual double operator()(const int node_index, const long label) const;
   virtual double operator()(const int node_index_1, const int node_index_2, const long label_1, const long label_2) const;
   
-  std::vector<std::vector<int> > getPixelNeighbors() const;
+  virtual double calcPairwiseCost(const int edge_index, const int node_index_1, const int node_index_2, const long label_1, const long label_2) const;
+  
+  //pairwise costs are SMOOTHNESS_TERM_WEIGHT_ * w_ij * |alpha_1 - alpha_2|
+  virtual bool hasFactorizedPairwiseCost() const { return true; };
+  virtual void calcLabelEmbeddings(const int node_index, const long *labels, const int NUM_LABELS, double *embeddings) const;
+  virtual double getEdgeWeight(const int edge_index, const int node_index_1, const int node_index_2) const;
+  
+  using CostFunctor::calcUnaryCosts;
+  virtual void calcUnaryCosts(const int node_index, const long *labels, const int NUM_LABELS, double *costs) const;
+  
+  //neighbor graph over all pixels
+  const NeighborGraph &getNeighborGraph() const;
+  
+  //nodes are the unknown pixels (or those passed to setNodePixels); node_index arguments of the cost functions refer to them
+  int getNumNodes() const;
+  const NeighborGraph &getNodeGraph() const;
+  const std::vector<int> &getNodePixels() const;
+  
+  //Restricts the nodes to node_pixels (unknown pixels in ascending order). Edges between them form the node graph, and the pairwise cost of an edge to any other pixel is folded into the unary cost with the alpha of that pixel fixed (by its mask, or by its label in pixel_solution if it is unknown). The work follows the number of node pixels.
+  void setNodePixels(const std::vector<int> &node_pixels, const std::vector<long> &pixel_solution);
+  
+  //Switches to the masks of an edited trimap which differ from the current ones only inside dirty_rect. Only the masks inside dirty_rect and the neighbor weights of edges with an end pixel in it are updated. Boundary distances are refreshed only for refreshed_pixels. The node set is not rebuilt, so setNodePixels has to be called (with a subset of refreshed_pixels for exact unary costs) before costs are evaluated again.
+  void updateTrimap(const cv_utils::ImageMask &foreground_mask, const cv_utils::ImageMask &background_mask, const cv::Rect &dirty_rect, const std::vector<int> &refreshed_pixels);
+  
+  //wall-clock time of calcNeighborsInfo in the constructor (including cache loading)
+  double getNeighborsInfoSeconds() const { return neighbors_info_seconds_; };
   
  private:
   const cv::Mat image_;
-  std::vector<std::vector<int> > pixel_neighbors_;
-  std::vector<std::map<int, double> > pixel_neighbor_weights_;
+  NeighborGraph pixel_neighbor_graph_;
+  NeighborGraph node_neighbor_graph_;
+  std::vector<int> node_pixels_;
+  //entries of pixels which are no nodes may be stale (see getPixelNode)
+  std::vector<int> pixel_nodes_;
+  //summed smoothness weights of the known foreground/background neighbors of every node
+  std::vector<double> node_foreground_weights_;
+  std::vector<double> node_background_weights_;
+  //smoothness weights and fixed alphas of the unknown neighbors which are no nodes, at [node_fixed_neighbor_offsets_[node], node_fixed_neighbor_offsets_[node + 1])
+  std::vector<int> node_fixed_neighbor_offsets_;
+  std::vector<double> node_fixed_neighbor_weights_;
+  std::vector<double> node_fixed_neighbor_alphas_;
   
-  const cv_utils::ImageMask foreground_mask_;
-  const cv_utils::ImageMask background_mask_;
-  const std::string image_identifier_;
+  cv_utils::ImageMask foreground_mask_;
+  cv_utils::ImageMask background_mask_;
   
   const int IMAGE_WIDTH_;
   const int IMAGE_HEIGHT_;
   
   const int NEIGHBOR_WINDOW_SIZE_;
   const int NUM_NEIGHBORS_;
+  const double NEIGHBOR_WINDOW_EPSILON_;
+  const std::string CACHE_DIRECTORY_;
   
   const double DATA_TERM_WEIGHT_;
   const double SMOOTHNESS_TERM_WEIGHT_;
   
+  double neighbors_info_seconds_;
+  
   std::vector<double> foreground_distance_map_;
   std::vector<double> background_distance_map_;
   
   
   void calcNeighborsInfo();
+  void calcGuidanceImageRect(const cv::Rect &rect, std::vector<std::vector<double> > &guidance_image_values, std::vector<std::vector<double> > &guidance_image_means, std::vector<double> &guidance_image_var_inverses) const;
+  void calcNeighborWeightBands(const cv::Rect &rect, const std::vector<std::vector<double> > &guidance_image_values, const std::vector<std::vector<double> > &guidance_image_means, const std::vector<double> &guidance_image_var_inverses, const cv::Rect &GUIDANCE_RECT, std::vector<int> &offsets, std::vector<int> &neighbors, std::vector<double> &weights) const;
+  void calcNeighborWeightRows(const cv::Rect &rect, const std::vector<std::vector<double> > &guidance_image_values, const std::vector<std::vector<double> > &guidance_image_means, const std::vector<double> &guidance_image_var_inverses, const cv::Rect &GUIDANCE_RECT, std::vector<int> &offsets, std::vector<int> &neighbors, std::vector<double> &weights) const;
   void calcNeighborsInfoGeodesicDistance();
+  void calcNodeGraph();
+  int getPixelNode(const int pixel) const;
+  double calcFixedNeighborCost(const int node, const double alpha) const;
+  uint64_t calcNeighborGraphKey(const int neighbor_system) const;
   void calcDistanceMaps();
+  void reportInvalidUnaryCost(const int pixel, const long *labels, const int NUM_LABELS) const;
 };
 
 #endif
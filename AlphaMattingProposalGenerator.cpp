@@ -3,16 +3,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <map>
+#include <set>
 #include <cassert>
 #include <iostream>
 #include <fstream>
 #include <cmath>
 #include <algorithm>
 #include <opencv2/core/core.hpp>
-#include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
 #include "cv_utils.h"
+#include "CounterRandom.h"
+#include "ParallelFor.h"
+#include "SolverTelemetry.h"
+#include "AlphaMattingPyramid.h"
 
 using namespace std;
 using namespace cv;
@@ -23,12 +27,59 @@ using namespace cv_utils;
 //{
 //}
 
-AlphaMattingProposalGenerator::AlphaMattingProposalGenerator(const cv::Mat &image, const ImageMask &foreground_mask, const ImageMask &background_mask) : image_(image), foreground_mask_(foreground_mask), background_mask_(background_mask), IMAGE_WIDTH_(image.cols), IMAGE_HEIGHT_(image.rows), NUM_SAMPLED_NEIGHBOR_PIXELS_(4), NUM_SAMPLED_REPRESENTATIVE_PIXELS_(2), NUM_SAMPLED_SIMILAR_COLOR_PIXELS_(2)
+AlphaMattingProposalGenerator::AlphaMattingProposalGenerator(const cv::Mat &image, const ImageMask &foreground_mask, const ImageMask &background_mask, DiagnosticsSink *diagnostics_sink) : image_(image), foreground_mask_(foreground_mask), background_mask_(background_mask), IMAGE_WIDTH_(image.cols), IMAGE_HEIGHT_(image.rows), NUM_SAMPLED_NEIGHBOR_PIXELS_(4), NUM_SAMPLED_REPRESENTATIVE_PIXELS_(2), NUM_SAMPLED_SIMILAR_COLOR_PIXELS_(2), pixel_neighbor_graph_(NULL), pixel_solution_(NULL), random_seed_((static_cast<uint64_t>(rand()) << 32) ^ rand()), num_proposals_(0)
 {
   //  foreground_mask_.dilate();
   //background_mask_.dilate();
-  calcRepresentativeLabels();
+  chrono::steady_clock::time_point lap_start = chrono::steady_clock::now();
+  calcRepresentativeLabels(diagnostics_sink);
+  representative_labels_seconds_ = calcLapSeconds(lap_start);
   findNearestColors();
+  calcNodePixels();
+}
+
+AlphaMattingProposalGenerator::AlphaMattingProposalGenerator(const cv::Mat &image, const ImageMask &foreground_mask, const ImageMask &background_mask, const vector<int> &representative_foreground_pixels, const vector<int> &representative_background_pixels) : image_(image), foreground_mask_(foreground_mask), background_mask_(background_mask), IMAGE_WIDTH_(image.cols), IMAGE_HEIGHT_(image.rows), NUM_SAMPLED_NEIGHBOR_PIXELS_(4), NUM_SAMPLED_REPRESENTATIVE_PIXELS_(2), NUM_SAMPLED_SIMILAR_COLOR_PIXELS_(2), representative_foreground_pixels_(representative_foreground_pixels), representative_background_pixels_(representative_background_pixels), pixel_neighbor_graph_(NULL), pixel_solution_(NULL), random_seed_((static_cast<uint64_t>(rand()) << 32) ^ rand()), num_proposals_(0), representative_labels_seconds_(0)
+{
+  //the color histogram is cheap and follows the pixel colors of this image
+  findNearestColors();
+  calcNodePixels();
+}
+
+//nodes are the unknown pixels, as in AlphaMattingCostFunctor
+void AlphaMattingProposalGenerator::calcNodePixels()
+{
+  node_pixels_.clear();
+  pixel_nodes_.assign(IMAGE_WIDTH_ * IMAGE_HEIGHT_, -1);
+  for (int pixel = 0; pixel < IMAGE_WIDTH_ * IMAGE_HEIGHT_; pixel++) {
+    if (foreground_mask_.at(pixel) || background_mask_.at(pixel))
+      continue;
+    pixel_nodes_[pixel] = node_pixels_.size();
+    node_pixels_.push_back(pixel);
+  }
+  pixel_solution_ = NULL;
+}
+
+void AlphaMattingProposalGenerator::setNodePixels(const vector<int> &node_pixels, const vector<long> &pixel_solution)
+{
+  node_pixels_ = node_pixels;
+  const int NUM_NODES = node_pixels_.size();
+  for (int node = 0; node < NUM_NODES; node++)
+    pixel_nodes_[node_pixels_[node]] = node;
+  pixel_solution_ = &pixel_solution;
+}
+
+//node of pixel, or -1 (see AlphaMattingCostFunctor::getPixelNode)
+int AlphaMattingProposalGenerator::getPixelNode(const int pixel) const
+{
+  const int node = pixel_nodes_[pixel];
+  return node >= 0 && node < static_cast<int>(node_pixels_.size()) && node_pixels_[node] == pixel ? node : -1;
+}
+
+//current label of an unknown pixel
+long AlphaMattingProposalGenerator::getCurrentLabel(const int pixel) const
+{
+  const int node = getPixelNode(pixel);
+  return node >= 0 ? current_solution_[node] : (*pixel_solution_)[pixel];
 }
 
 void AlphaMattingProposalGenerator::setCurrentSolution(const vector<long> &current_solution)
@@ -41,104 +92,164 @@ void AlphaMattingProposalGenerator::setCurrentSolutionCosts(const vector<double>
   current_solution_costs_ = current_solution_costs;
 }
 
-vector<vector<long> > AlphaMattingProposalGenerator::getProposal() const
+void AlphaMattingProposalGenerator::updateTrimap(const ImageMask &foreground_mask, const ImageMask &background_mask, const Rect &dirty_rect)
+{
+  for (int y = max(dirty_rect.y, 0); y < min(dirty_rect.y + dirty_rect.height, IMAGE_HEIGHT_); y++) {
+    for (int x = max(dirty_rect.x, 0); x < min(dirty_rect.x + dirty_rect.width, IMAGE_WIDTH_); x++) {
+      const int pixel = y * IMAGE_WIDTH_ + x;
+      foreground_mask_.set(pixel, foreground_mask.at(pixel));
+      background_mask_.set(pixel, background_mask.at(pixel));
+    }
+  }
+  updateRepresentativePixels(foreground_mask_, dirty_rect, representative_foreground_pixels_);
+  updateRepresentativePixels(background_mask_, dirty_rect, representative_background_pixels_);
+}
+
+void AlphaMattingProposalGenerator::updateRepresentativePixels(const ImageMask &mask, const Rect &dirty_rect, vector<int> &representative_pixels) const
+{
+  vector<int> valid_pixels;
+  set<int> represented_clusters;
+  for (vector<int>::const_iterator pixel_it = representative_pixels.begin(); pixel_it != representative_pixels.end(); pixel_it++) {
+    if (mask.at(*pixel_it) == false)
+      continue;
+    valid_pixels.push_back(*pixel_it);
+    if (pixel_clusters_.empty() == false)
+      represented_clusters.insert(pixel_clusters_[*pixel_it]);
+  }
+  if (pixel_clusters_.empty() == false) {
+    for (int y = max(dirty_rect.y, 0); y < min(dirty_rect.y + dirty_rect.height, IMAGE_HEIGHT_); y++) {
+      for (int x = max(dirty_rect.x, 0); x < min(dirty_rect.x + dirty_rect.width, IMAGE_WIDTH_); x++) {
+	const int pixel = y * IMAGE_WIDTH_ + x;
+	if (mask.at(pixel) && represented_clusters.insert(pixel_clusters_[pixel]).second)
+	  valid_pixels.push_back(pixel);
+      }
+    }
+  }
+  //without any representative left, the mask pixel nearest to a dropped one takes over
+  if (valid_pixels.size() == 0 && representative_pixels.size() > 0) {
+    const int nearest_pixel = findNearestMaskPixel(mask, representative_pixels[0], IMAGE_WIDTH_, IMAGE_HEIGHT_);
+    if (nearest_pixel >= 0)
+      valid_pixels.push_back(nearest_pixel);
+  }
+  representative_pixels.swap(valid_pixels);
+}
+
+void AlphaMattingProposalGenerator::getProposal(ProposalLabels &proposal_labels) const
 {
+  //random numbers of pixel p in proposal i come from stream (i, p), the shared ones from stream (i, NUM_PIXELS)
+  const int proposal_index = num_proposals_++;
+  
+  CounterRandom representative_random(random_seed_, proposal_index, IMAGE_WIDTH_ * IMAGE_HEIGHT_);
   vector<long> representative_labels;
   for (int i = 0; i < NUM_SAMPLED_REPRESENTATIVE_PIXELS_; i++) {
-    int proposal_foreground_pixel = representative_foreground_pixels_[rand() % representative_foreground_pixels_.size()];
-    int proposal_background_pixel = representative_background_pixels_[rand() % representative_background_pixels_.size()];
+    int proposal_foreground_pixel = representative_foreground_pixels_[representative_random(representative_foreground_pixels_.size())];
+    int proposal_background_pixel = representative_background_pixels_[representative_random(representative_background_pixels_.size())];
     representative_labels.push_back(static_cast<long>(proposal_foreground_pixel) * (IMAGE_WIDTH_ * IMAGE_HEIGHT_) + proposal_background_pixel);
   }
   
-  vector<vector<long> > pixel_labels(IMAGE_WIDTH_ * IMAGE_HEIGHT_);
-  for (int pixel = 0; pixel < IMAGE_WIDTH_ * IMAGE_HEIGHT_; pixel++) {
-    if (foreground_mask_.at(pixel) || background_mask_.at(pixel)) {
-      pixel_labels[pixel].push_back(static_cast<long>(pixel) * (IMAGE_WIDTH_ * IMAGE_HEIGHT_) + pixel);
+  const int NUM_NODES = node_pixels_.size();
+  proposal_labels.reset(NUM_NODES, getMaxNumNodeLabels(), getMaxNumNodeLabels());
+  parallelFor(0, NUM_NODES, min(getNumThreads() * 4, NUM_NODES), [&](const int, const int first_node, const int last_node) {
+      for (int node = first_node; node < last_node; node++)
+	proposal_labels.setNumLabels(node, calcNodeLabels(node, proposal_index, representative_labels, proposal_labels.getSlot(node), proposal_labels.getSourceSlot(node)));
+    });
+  proposal_labels.compact();
+}
+
+//current label, one label per search radius and the sampled neighbor, representative and similar color labels; every one of them is a proposal source
+int AlphaMattingProposalGenerator::getMaxNumNodeLabels() const
+{
+  int num_radii = 0;
+  for (int radius = max(IMAGE_WIDTH_, IMAGE_HEIGHT_); radius > 0; radius /= 2)
+    num_radii++;
+  return 1 + num_radii + NUM_SAMPLED_NEIGHBOR_PIXELS_ + NUM_SAMPLED_REPRESENTATIVE_PIXELS_ + NUM_SAMPLED_SIMILAR_COLOR_PIXELS_;
+}
+
+//labels proposed for one node; only depends on the node, the proposal index and the current solution
+int AlphaMattingProposalGenerator::calcNodeLabels(const int node, const int proposal_index, const vector<long> &representative_labels, long *labels, long *source_labels) const
+{
+  const int pixel = node_pixels_[node];
+  int num_labels = 0;
+  CounterRandom random(random_seed_, proposal_index, pixel);
+  long current_solution_label = current_solution_[node];
+  if (current_solution_label < 0) {
+    cout << "current label less than 0: " << pixel << endl;
+    exit(1);
+  }
+  //sources are numbered in the order of getMaxNumNodeLabels; a source without a valid label leaves its entry at -1
+  int source = 0;
+  source_labels[source++] = current_solution_label;
+  labels[num_labels++] = current_solution_label;
+  int current_solution_foreground_pixel = current_solution_label / (IMAGE_WIDTH_ * IMAGE_HEIGHT_);
+  int current_solution_background_pixel = current_solution_label % (IMAGE_WIDTH_ * IMAGE_HEIGHT_);
+  
+  int radius = max(IMAGE_WIDTH_, IMAGE_HEIGHT_);
+  int num_attempts = 0;
+  while (radius > 0) {
+    int proposal_foreground_x = max(min(current_solution_foreground_pixel % IMAGE_WIDTH_ + (random(radius * 2 + 1) - radius), IMAGE_WIDTH_ - 1), 0);
+    int proposal_foreground_y = max(min(current_solution_foreground_pixel / IMAGE_WIDTH_ + (random(radius * 2 + 1) - radius), IMAGE_HEIGHT_ - 1), 0);
+    int proposal_background_x = max(min(current_solution_background_pixel % IMAGE_WIDTH_ + (random(radius * 2 + 1) - radius), IMAGE_WIDTH_ - 1), 0);
+    int proposal_background_y = max(min(current_solution_background_pixel / IMAGE_WIDTH_ + (random(radius * 2 + 1) - radius), IMAGE_HEIGHT_ - 1), 0);
+    int proposal_foreground_pixel = proposal_foreground_y * IMAGE_WIDTH_ + proposal_foreground_x;
+    int proposal_background_pixel = proposal_background_y * IMAGE_WIDTH_ + proposal_background_x;
+    if (foreground_mask_.at(proposal_foreground_pixel) == true && background_mask_.at(proposal_background_pixel) == true)
+      labels[num_labels++] = source_labels[source] = static_cast<long>(proposal_foreground_pixel) * (IMAGE_WIDTH_ * IMAGE_HEIGHT_) + proposal_background_pixel;
+    else if (foreground_mask_.at(proposal_foreground_pixel) == true)
+      labels[num_labels++] = source_labels[source] = static_cast<long>(proposal_foreground_pixel) * (IMAGE_WIDTH_ * IMAGE_HEIGHT_) + current_solution_background_pixel;
+    else if (background_mask_.at(proposal_background_pixel) == true)
+      labels[num_labels++] = source_labels[source] = static_cast<long>(current_solution_foreground_pixel) * (IMAGE_WIDTH_ * IMAGE_HEIGHT_) + proposal_background_pixel;
+    source++;
+  
+    radius /= 2;
+  }
+  
+  //vector<int> neighbor_pixels = findNeighbors(pixel, IMAGE_WIDTH_, IMAGE_HEIGHT_, 4);
+  const int NUM_POSSIBLE_NEIGHBOR_PIXELS = pixel_neighbor_graph_->getNumNeighbors(pixel);
+  const int NEIGHBOR_SOURCE = source;
+  source += NUM_SAMPLED_NEIGHBOR_PIXELS_;
+  for (int i = 0; i < NUM_SAMPLED_NEIGHBOR_PIXELS_ && NUM_POSSIBLE_NEIGHBOR_PIXELS > 0; i++) {
+    const int neighbor_pixel = pixel_neighbor_graph_->getNeighbor(pixel_neighbor_graph_->getEdgeBegin(pixel) + random(NUM_POSSIBLE_NEIGHBOR_PIXELS));
+    if (foreground_mask_.at(neighbor_pixel) || background_mask_.at(neighbor_pixel))
       continue;
-    }
-    vector<long> labels;
-    long current_solution_label = current_solution_[pixel];
-    if (current_solution_label < 0) {
-      cout << "current label less than 0: " << pixel << endl;
-      exit(1);
-    }
-    labels.push_back(current_solution_label);
-    int current_solution_foreground_pixel = current_solution_label / (IMAGE_WIDTH_ * IMAGE_HEIGHT_);
-    int current_solution_background_pixel = current_solution_label % (IMAGE_WIDTH_ * IMAGE_HEIGHT_);
-      
-    int radius = max(IMAGE_WIDTH_, IMAGE_HEIGHT_);
-    int num_attempts = 0;
-    while (radius > 0) {
-      int proposal_foreground_x = max(min(current_solution_foreground_pixel % IMAGE_WIDTH_ + (rand() % (radius * 2 + 1) - radius), IMAGE_WIDTH_ - 1), 0);
-      int proposal_foreground_y = max(min(current_solution_foreground_pixel / IMAGE_WIDTH_ + (rand() % (radius * 2 + 1) - radius), IMAGE_HEIGHT_ - 1), 0);
-      int proposal_background_x = max(min(current_solution_background_pixel % IMAGE_WIDTH_ + (rand() % (radius * 2 + 1) - radius), IMAGE_WIDTH_ - 1), 0);
-      int proposal_background_y = max(min(current_solution_background_pixel / IMAGE_WIDTH_ + (rand() % (radius * 2 + 1) - radius), IMAGE_HEIGHT_ - 1), 0);
-      int proposal_foreground_pixel = proposal_foreground_y * IMAGE_WIDTH_ + proposal_foreground_x;
-      int proposal_background_pixel = proposal_background_y * IMAGE_WIDTH_ + proposal_background_x;
-      if (foreground_mask_.at(proposal_foreground_pixel) == true && background_mask_.at(proposal_background_pixel) == true)
-	labels.push_back(static_cast<long>(proposal_foreground_pixel) * (IMAGE_WIDTH_ * IMAGE_HEIGHT_) + proposal_background_pixel);
-      else if (foreground_mask_.at(proposal_foreground_pixel) == true)
-	labels.push_back(static_cast<long>(proposal_foreground_pixel) * (IMAGE_WIDTH_ * IMAGE_HEIGHT_) + current_solution_background_pixel);
-      else if (background_mask_.at(proposal_background_pixel) == true)
-	labels.push_back(static_cast<long>(current_solution_foreground_pixel) * (IMAGE_WIDTH_ * IMAGE_HEIGHT_) + proposal_background_pixel);
-	
-      radius /= 2;
-    }
-      
-    //vector<int> neighbor_pixels = findNeighbors(pixel, IMAGE_WIDTH_, IMAGE_HEIGHT_, 4);
-    vector<int> possible_neighbor_pixels = pixel_neighbors_[pixel];
-    vector<int> neighbor_pixels;
-    for (int i = 0; i < NUM_SAMPLED_NEIGHBOR_PIXELS_; i++)
-      neighbor_pixels.push_back(possible_neighbor_pixels[rand() % possible_neighbor_pixels.size()]);
-      
-    for (vector<int>::const_iterator neighbor_pixel_it = neighbor_pixels.begin(); neighbor_pixel_it != neighbor_pixels.end(); neighbor_pixel_it++) {
-      if (foreground_mask_.at(*neighbor_pixel_it) || background_mask_.at(*neighbor_pixel_it))
-	continue;
-      long neighbor_pixel_current_solution_label = current_solution_[*neighbor_pixel_it];
-      labels.push_back(neighbor_pixel_current_solution_label);
-      // int neighbor_pixel_proposal_foreground_pixel = pixel - *neighbor_pixel_it + neighbor_pixel_current_solution_label % (IMAGE_WIDTH_ * IMAGE_HEIGHT_);
-      // int neighbor_pixel_proposal_background_pixel = pixel - *neighbor_pixel_it + neighbor_pixel_current_solution_label / (IMAGE_WIDTH_ * IMAGE_HEIGHT_);
-	
-      // if (source_mask_.at(neighbor_pixel_proposal_label))
-      //   labels.push_back(neighbor_pixel_proposal_label);
-      // else
-      //   labels.push_back(neighbor_pixel_current_solution_label);
-    }
-    labels.insert(labels.end(), representative_labels.begin(), representative_labels.end());
-      
+    long neighbor_pixel_current_solution_label = getCurrentLabel(neighbor_pixel);
+    labels[num_labels++] = source_labels[NEIGHBOR_SOURCE + i] = neighbor_pixel_current_solution_label;
+    // int neighbor_pixel_proposal_foreground_pixel = pixel - neighbor_pixel + neighbor_pixel_current_solution_label % (IMAGE_WIDTH_ * IMAGE_HEIGHT_);
+    // int neighbor_pixel_proposal_background_pixel = pixel - neighbor_pixel + neighbor_pixel_current_solution_label / (IMAGE_WIDTH_ * IMAGE_HEIGHT_);
+  
+    // if (source_mask_.at(neighbor_pixel_proposal_label))
+    //   labels.push_back(neighbor_pixel_proposal_label);
+    // else
+    //   labels.push_back(neighbor_pixel_current_solution_label);
+  }
+  for (vector<long>::const_iterator label_it = representative_labels.begin(); label_it != representative_labels.end(); label_it++)
+    labels[num_labels++] = source_labels[source++] = *label_it;
+  
   
-    // if (pixel == 6468) {
-    //   for (vector<int>::const_iterator label_it = labels.begin(); label_it != labels.end(); label_it++)
-    // 	cout << *label_it / (IMAGE_WIDTH_ * IMAGE_HEIGHT_) << '\t' << *label_it % (IMAGE_WIDTH_ * IMAGE_HEIGHT_) << endl;
-    //   cout << foreground_mask_.at(6468) << '\t' << background_mask_.at(6468) << '\t' << foreground_mask_.at(7270) << '\t' << background_mask_.at(7270) << endl;
-    //   exit(1);
-    // }
+  // if (pixel == 6468) {
+  //   for (vector<int>::const_iterator label_it = labels.begin(); label_it != labels.end(); label_it++)
+  // 	cout << *label_it / (IMAGE_WIDTH_ * IMAGE_HEIGHT_) << '\t' << *label_it % (IMAGE_WIDTH_ * IMAGE_HEIGHT_) << endl;
+  //   cout << foreground_mask_.at(6468) << '\t' << background_mask_.at(6468) << '\t' << foreground_mask_.at(7270) << '\t' << background_mask_.at(7270) << endl;
+  //   exit(1);
+  // }
 
-    vector<int> similar_color_pixels = histo_pixels_[pixel_histo_map_[pixel]];
-    if (similar_color_pixels.size() > 0) {
-      vector<int> similar_color_pixels(NUM_SAMPLED_SIMILAR_COLOR_PIXELS_);
-      
-      for (int sample_index = 0; sample_index < NUM_SAMPLED_SIMILAR_COLOR_PIXELS_; sample_index++)
-	similar_color_pixels[sample_index] = similar_color_pixels[rand() % similar_color_pixels.size()];
-      for (vector<int>::const_iterator similar_color_pixel_it = similar_color_pixels.begin(); similar_color_pixel_it != similar_color_pixels.end(); similar_color_pixel_it++) {
-	if (foreground_mask_.at(*similar_color_pixel_it))
-	  labels.push_back(static_cast<long>(*similar_color_pixel_it) * (IMAGE_WIDTH_ * IMAGE_HEIGHT_) + current_solution_background_pixel);
-        else if (background_mask_.at(*similar_color_pixel_it))
-	  labels.push_back(static_cast<long>(current_solution_foreground_pixel) * (IMAGE_WIDTH_ * IMAGE_HEIGHT_) + *similar_color_pixel_it);
-	else
-	  labels.push_back(current_solution_[*similar_color_pixel_it]);
-      }
+  const vector<int> &similar_color_pixels = histo_pixels_[pixel_histo_map_[pixel]];
+  if (similar_color_pixels.size() > 0) {
+    for (int sample_index = 0; sample_index < NUM_SAMPLED_SIMILAR_COLOR_PIXELS_; sample_index++) {
+      const int similar_color_pixel = similar_color_pixels[random(similar_color_pixels.size())];
+      if (foreground_mask_.at(similar_color_pixel))
+	labels[num_labels++] = source_labels[source + sample_index] = static_cast<long>(similar_color_pixel) * (IMAGE_WIDTH_ * IMAGE_HEIGHT_) + current_solution_background_pixel;
+      else if (background_mask_.at(similar_color_pixel))
+	labels[num_labels++] = source_labels[source + sample_index] = static_cast<long>(current_solution_foreground_pixel) * (IMAGE_WIDTH_ * IMAGE_HEIGHT_) + similar_color_pixel;
+      else
+	labels[num_labels++] = source_labels[source + sample_index] = getCurrentLabel(similar_color_pixel);
     }
-
-    sort(labels.begin(), labels.end());
-    labels.erase(unique(labels.begin(), labels.end()), labels.end());
-    pixel_labels[pixel] = labels;
   }
-      
-  return pixel_labels;
+
+  sort(labels, labels + num_labels);
+  return unique(labels, labels + num_labels) - labels;
 }
 
-void AlphaMattingProposalGenerator::calcRepresentativeLabels()
+void AlphaMattingProposalGenerator::calcRepresentativeLabels(DiagnosticsSink *diagnostics_sink)
 {
   // const int NUM_REPRESENTATIVE_FOREGROUND_PIXELS = sqrt(NUM_REPRESENTATIVE_LABELS_);
   // const int NUM_REPRESENTATIVE_BACKGROUND_PIXELS = sqrt(NUM_REPRESENTATIVE_LABELS_);
@@ -161,8 +272,10 @@ void AlphaMattingProposalGenerator::calcRepresentativeLabels()
   
   map<int, vector<int> > foreground_clusters;
   map<int, vector<int> > background_clusters;
+  pixel_clusters_.assign(IMAGE_WIDTH_ * IMAGE_HEIGHT_, 0);
   for(int pixel = 0; pixel < IMAGE_WIDTH_ * IMAGE_HEIGHT_; pixel++) {
     int label = labels.at<int>(0, pixel);
+    pixel_clusters_[pixel] = label;
     if (foreground_mask_.at(pixel))
       foreground_clusters[label].push_back(pixel);
     if (background_mask_.at(pixel))
@@ -186,6 +299,8 @@ void AlphaMattingProposalGenerator::calcRepresentativeLabels()
     representative_background_pixels_.push_back(background_pixels[rand() % background_pixels.size()]);
   }
   
+  if (isDiagnosticsEnabled(diagnostics_sink, DIAGNOSTICS_SUMMARY) == false)
+    return;
   Mat clustered_image = Mat(IMAGE_HEIGHT_, IMAGE_WIDTH_, CV_8UC3);
   map<int, Vec3b> color_table;
   for(int pixel = 0; pixel < IMAGE_WIDTH_ * IMAGE_HEIGHT_; pixel++) {
@@ -195,12 +310,12 @@ void AlphaMattingProposalGenerator::calcRepresentativeLabels()
     clustered_image.at<Vec3b>(pixel / IMAGE_WIDTH_, pixel % IMAGE_WIDTH_) = color_table[label];
   }
   
-  imwrite("Test/clustered_image.bmp", clustered_image);
+  diagnostics_sink->writeImage("clustered_image.bmp", clustered_image);
 }
 
-void AlphaMattingProposalGenerator::setNeighbors(const std::vector<std::vector<int> > &pixel_neighbors)
+void AlphaMattingProposalGenerator::setNeighbors(const NeighborGraph &pixel_neighbor_graph)
 {
-  pixel_neighbors_ = pixel_neighbors;
+  pixel_neighbor_graph_ = &pixel_neighbor_graph;
 }
 
 void AlphaMattingProposalGenerator::findNearestColors()
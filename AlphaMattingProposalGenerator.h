@@ -2,9 +2,13 @@
 #define ALPHA_MATTING_PROPOSAL_GENERATOR_H__
 
 #include <vector>
+#include <stdint.h>
+#include <opencv2/core/core.hpp>
 
 #include "cv_utils.h"
 #include "ProposalGenerator.h"
+#include "NeighborGraph.h"
+#include "Diagnostics.h"
 
 //class cv_utils::ImageMask;
 
@@ -12,16 +16,29 @@ class AlphaMattingProposalGenerator : public ProposalGenerator
 {
  public:
   //AlphaMattingProposalGenerator(const cv::Mat &image, const std::vector<bool> &source_mask, const std::vector<bool> &target_mask);
-  AlphaMattingProposalGenerator(const cv::Mat &image, const cv_utils::ImageMask &foreground_mask, const cv_utils::ImageMask &background_mask);
+  //the clustering of the representative colors goes to diagnostics_sink
+  AlphaMattingProposalGenerator(const cv::Mat &image, const cv_utils::ImageMask &foreground_mask, const cv_utils::ImageMask &background_mask, DiagnosticsSink *diagnostics_sink = NULL);
+  //skips the clustering and takes the representative pixels of an earlier generator with the same masks (e.g. of a previous video frame)
+  AlphaMattingProposalGenerator(const cv::Mat &image, const cv_utils::ImageMask &foreground_mask, const cv_utils::ImageMask &background_mask, const std::vector<int> &representative_foreground_pixels, const std::vector<int> &representative_background_pixels);
   
   //void setCurrentSolution(const std::vector<int> &current_solution);
-  void setNeighbors(const std::vector<std::vector<int> > &pixel_neighbors);
+  void setNeighbors(const NeighborGraph &pixel_neighbor_graph);
   
   virtual void setCurrentSolution(const std::vector<long> &current_solution);
-  virtual std::vector<std::vector<long> > getProposal() const;
+  virtual void getProposal(ProposalLabels &proposal_labels) const;
 
   void setCurrentSolutionCosts(const std::vector<double> &current_solution_costs);
   
+  //Switches to the masks of an edited trimap which differ from the current ones only inside dirty_rect, and copies only that part. Representative pixels which left their mask are dropped, and pixels which entered a mask inside dirty_rect stand in for color clusters left without a representative. The node set is not rebuilt, so setNodePixels has to be called before the next proposal.
+  void updateTrimap(const cv_utils::ImageMask &foreground_mask, const cv_utils::ImageMask &background_mask, const cv::Rect &dirty_rect);
+  //Restricts the nodes to node_pixels (unknown pixels in ascending order, as in AlphaMattingCostFunctor::setNodePixels). Unknown pixels which are no nodes propose their label in pixel_solution, which is kept by reference.
+  void setNodePixels(const std::vector<int> &node_pixels, const std::vector<long> &pixel_solution);
+  
+  //wall-clock time of calcRepresentativeLabels in the constructor
+  double getRepresentativeLabelsSeconds() const { return representative_labels_seconds_; };
+  const std::vector<int> &getRepresentativeForegroundPixels() const { return representative_foreground_pixels_; };
+  const std::vector<int> &getRepresentativeBackgroundPixels() const { return representative_background_pixels_; };
+  
  private:
   const cv::Mat image_;
   cv_utils::ImageMask foreground_mask_;
@@ -38,14 +55,35 @@ class AlphaMattingProposalGenerator : public ProposalGenerator
   
   std::vector<int> representative_foreground_pixels_;
   std::vector<int> representative_background_pixels_;
+  //color cluster of every pixel (empty if the representatives were taken over)
+  std::vector<int> pixel_clusters_;
+  
+  const NeighborGraph *pixel_neighbor_graph_;
+  
+  //proposals and solutions cover the unknown pixels (or those passed to setNodePixels) only
+  std::vector<int> node_pixels_;
+  //entries of pixels which are no nodes may be stale (see getPixelNode)
+  std::vector<int> pixel_nodes_;
+  //labels of the unknown pixels which are no nodes (NULL while all of them are nodes)
+  const std::vector<long> *pixel_solution_;
   
-  std::vector<std::vector<int> > pixel_neighbors_;
+  //proposals draw counter-based random numbers keyed by random_seed_, the proposal index and the pixel
+  const uint64_t random_seed_;
+  mutable int num_proposals_;
+  double representative_labels_seconds_;
   
   std::vector<int> pixel_histo_map_;
   std::vector<std::vector<int> > histo_pixels_;
   
-  void calcRepresentativeLabels();
+  void calcRepresentativeLabels(DiagnosticsSink *diagnostics_sink);
+  int getMaxNumNodeLabels() const;
+  //writes the labels of one node to labels and the label of every proposal source to source_labels (both with room for getMaxNumNodeLabels()) and returns the number of labels
+  int calcNodeLabels(const int node, const int proposal_index, const std::vector<long> &representative_labels, long *labels, long *source_labels) const;
   void findNearestColors();
+  void calcNodePixels();
+  int getPixelNode(const int pixel) const;
+  long getCurrentLabel(const int pixel) const;
+  void updateRepresentativePixels(const cv_utils::ImageMask &mask, const cv::Rect &dirty_rect, std::vector<int> &representative_pixels) const;
 };
 
 #endif
@@ -0,0 +1,164 @@
+#include "AlphaMattingPyramid.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "AlphaMattingCostFunctor.h"
+#include "AlphaMattingProposalGenerator.h"
+#include "FusionSpaceSolver.h"
+#include "ParallelFor.h"
+
+
+using namespace std;
+using namespace cv;
+using namespace cv_utils;
+
+void calcTrimapMasks(const Mat &trimap, ImageMask &foreground_mask, ImageMask &background_mask)
+{
+  const int IMAGE_WIDTH = trimap.cols;
+  const int IMAGE_HEIGHT = trimap.rows;
+  vector<bool> foreground_mask_vec(IMAGE_WIDTH * IMAGE_HEIGHT, false);
+  vector<bool> background_mask_vec(IMAGE_WIDTH * IMAGE_HEIGHT, false);
+  for (int pixel = 0; pixel < IMAGE_WIDTH * IMAGE_HEIGHT; pixel++) {
+    int color = trimap.at<uchar>(pixel / IMAGE_WIDTH, pixel % IMAGE_WIDTH);
+    if (color > 200)
+      foreground_mask_vec[pixel] = true;
+    if (color < 100)
+      background_mask_vec[pixel] = true;
+  }
+  foreground_mask = ImageMask(foreground_mask_vec, IMAGE_WIDTH, IMAGE_HEIGHT);
+  background_mask = ImageMask(background_mask_vec, IMAGE_WIDTH, IMAGE_HEIGHT);
+}
+
+vector<long> calcBoundarySolution(const ImageMask &foreground_mask, const ImageMask &background_mask, const int IMAGE_WIDTH, const int IMAGE_HEIGHT)
+{
+  const int NUM_PIXELS = IMAGE_WIDTH * IMAGE_HEIGHT;
+  vector<double> foreground_distance_map;
+  vector<int> foreground_boundary_map;
+  foreground_mask.calcBoundaryDistanceMap(foreground_boundary_map, foreground_distance_map);
+  vector<double> background_distance_map;
+  vector<int> background_boundary_map;
+  background_mask.calcBoundaryDistanceMap(background_boundary_map, background_distance_map);
+  
+  vector<long> solution(NUM_PIXELS);
+  for (int pixel = 0; pixel < NUM_PIXELS; pixel++) {
+    if (foreground_mask.at(pixel) || background_mask.at(pixel))
+      solution[pixel] = static_cast<long>(pixel) * NUM_PIXELS + pixel;
+    else
+      solution[pixel] = static_cast<long>(foreground_boundary_map[pixel]) * NUM_PIXELS + background_boundary_map[pixel];
+  }
+  return solution;
+}
+
+int findNearestMaskPixel(const ImageMask &mask, const int pixel, const int IMAGE_WIDTH, const int IMAGE_HEIGHT)
+{
+  const int x = pixel % IMAGE_WIDTH;
+  const int y = pixel / IMAGE_WIDTH;
+  int nearest_pixel = -1;
+  long nearest_squared_distance = 0;
+  //every pixel on the square ring of radius r is at least r away, so rings are visited until r exceeds the nearest distance found
+  for (int radius = 0; radius < max(IMAGE_WIDTH, IMAGE_HEIGHT); radius++) {
+    if (nearest_pixel >= 0 && static_cast<long>(radius) * radius > nearest_squared_distance)
+      break;
+    for (int delta_y = -radius; delta_y <= radius; delta_y++) {
+      if (y + delta_y < 0 || y + delta_y >= IMAGE_HEIGHT)
+	continue;
+      const int STEP = abs(delta_y) == radius ? 1 : 2 * radius;
+      for (int delta_x = -radius; delta_x <= radius; delta_x += STEP) {
+	if (x + delta_x < 0 || x + delta_x >= IMAGE_WIDTH)
+	  continue;
+	const int ring_pixel = (y + delta_y) * IMAGE_WIDTH + (x + delta_x);
+	const long squared_distance = static_cast<long>(delta_x) * delta_x + static_cast<long>(delta_y) * delta_y;
+	if (mask.at(ring_pixel) && (nearest_pixel < 0 || squared_distance < nearest_squared_distance)) {
+	  nearest_pixel = ring_pixel;
+	  nearest_squared_distance = squared_distance;
+	}
+      }
+    }
+  }
+  return nearest_pixel;
+}
+
+vector<long> liftSolution(const vector<long> &coarse_solution, const int COARSE_IMAGE_WIDTH, const int COARSE_IMAGE_HEIGHT, const ImageMask &foreground_mask, const ImageMask &background_mask, const int IMAGE_WIDTH, const int IMAGE_HEIGHT)
+{
+  const int NUM_PIXELS = IMAGE_WIDTH * IMAGE_HEIGHT;
+  const int NUM_COARSE_PIXELS = COARSE_IMAGE_WIDTH * COARSE_IMAGE_HEIGHT;
+  vector<double> foreground_distance_map;
+  vector<int> foreground_boundary_map;
+  foreground_mask.calcBoundaryDistanceMap(foreground_boundary_map, foreground_distance_map);
+  vector<double> background_distance_map;
+  vector<int> background_boundary_map;
+  background_mask.calcBoundaryDistanceMap(background_boundary_map, background_distance_map);
+  
+  //the center of a coarse pixel in fine coordinates
+  auto lift_pixel = [&](const int coarse_pixel) {
+    const int x = min((2 * (coarse_pixel % COARSE_IMAGE_WIDTH) + 1) * IMAGE_WIDTH / (2 * COARSE_IMAGE_WIDTH), IMAGE_WIDTH - 1);
+    const int y = min((2 * (coarse_pixel / COARSE_IMAGE_WIDTH) + 1) * IMAGE_HEIGHT / (2 * COARSE_IMAGE_HEIGHT), IMAGE_HEIGHT - 1);
+    return y * IMAGE_WIDTH + x;
+  };
+  
+  vector<long> solution(NUM_PIXELS);
+  for (int pixel = 0; pixel < NUM_PIXELS; pixel++) {
+    if (foreground_mask.at(pixel) || background_mask.at(pixel)) {
+      solution[pixel] = static_cast<long>(pixel) * NUM_PIXELS + pixel;
+      continue;
+    }
+    const int coarse_x = min((pixel % IMAGE_WIDTH) * COARSE_IMAGE_WIDTH / IMAGE_WIDTH, COARSE_IMAGE_WIDTH - 1);
+    const int coarse_y = min((pixel / IMAGE_WIDTH) * COARSE_IMAGE_HEIGHT / IMAGE_HEIGHT, COARSE_IMAGE_HEIGHT - 1);
+    const long coarse_label = coarse_solution[coarse_y * COARSE_IMAGE_WIDTH + coarse_x];
+    int foreground_pixel = lift_pixel(coarse_label / NUM_COARSE_PIXELS);
+    int background_pixel = lift_pixel(coarse_label % NUM_COARSE_PIXELS);
+    if (foreground_mask.at(foreground_pixel) == false)
+      foreground_pixel = foreground_boundary_map[foreground_pixel];
+    if (background_mask.at(background_pixel) == false)
+      background_pixel = background_boundary_map[background_pixel];
+    solution[pixel] = static_cast<long>(foreground_pixel) * NUM_PIXELS + background_pixel;
+  }
+  return solution;
+}
+
+vector<long> solveLevel(const Mat &image, const Mat &trimap, const vector<long> &initial_solution, const int NUM_ITERATIONS, const string &cache_directory, DiagnosticsSink *diagnostics_sink)
+{
+  ImageMask foreground_mask, background_mask;
+  calcTrimapMasks(trimap, foreground_mask, background_mask);
+  
+  AlphaMattingCostFunctor cost_functor(image, foreground_mask, background_mask, cache_directory);
+  AlphaMattingProposalGenerator proposal_generator(image, foreground_mask, background_mask, diagnostics_sink);
+  proposal_generator.setNeighbors(cost_functor.getNeighborGraph());
+  FusionSpaceSolver solver(cost_functor.getNumNodes(), cost_functor.getNodeGraph(), cost_functor, proposal_generator, 200);
+  solver.setTiling(getNumThreads());
+  solver.setDiagnosticsSink(diagnostics_sink);
+  
+  const vector<int> &node_pixels = cost_functor.getNodePixels();
+  vector<long> initial_node_solution(node_pixels.size());
+  for (int node = 0; node < node_pixels.size(); node++)
+    initial_node_solution[node] = initial_solution[node_pixels[node]];
+  vector<long> node_solution = solver.solve(NUM_ITERATIONS, initial_node_solution);
+  
+  vector<long> solution = initial_solution;
+  for (int node = 0; node < node_pixels.size(); node++)
+    solution[node_pixels[node]] = node_solution[node];
+  return solution;
+}
+
+vector<long> calcCoarseToFineSolution(const Mat &image, const Mat &trimap, const int NUM_COARSE_LEVELS, const int NUM_LEVEL_ITERATIONS, const int MIN_LEVEL_SIZE, const string &cache_directory)
+{
+  const int IMAGE_WIDTH = image.cols;
+  const int IMAGE_HEIGHT = image.rows;
+  ImageMask foreground_mask, background_mask;
+  calcTrimapMasks(trimap, foreground_mask, background_mask);
+  if (NUM_COARSE_LEVELS <= 0 || min(IMAGE_WIDTH, IMAGE_HEIGHT) / 2 < MIN_LEVEL_SIZE)
+    return calcBoundarySolution(foreground_mask, background_mask, IMAGE_WIDTH, IMAGE_HEIGHT);
+  
+  Mat coarse_image, coarse_trimap;
+  resize(image, coarse_image, Size(IMAGE_WIDTH / 2, IMAGE_HEIGHT / 2), 0, 0, INTER_AREA);
+  //nearest neighbor sampling keeps the trimap classes intact
+  resize(trimap, coarse_trimap, Size(IMAGE_WIDTH / 2, IMAGE_HEIGHT / 2), 0, 0, INTER_NEAREST);
+  ImageMask coarse_foreground_mask, coarse_background_mask;
+  calcTrimapMasks(coarse_trimap, coarse_foreground_mask, coarse_background_mask);
+  if (coarse_foreground_mask.getNumPixels() == 0 || coarse_background_mask.getNumPixels() == 0)
+    return calcBoundarySolution(foreground_mask, background_mask, IMAGE_WIDTH, IMAGE_HEIGHT);
+  
+  vector<long> coarse_solution = calcCoarseToFineSolution(coarse_image, coarse_trimap, NUM_COARSE_LEVELS - 1, NUM_LEVEL_ITERATIONS, MIN_LEVEL_SIZE, cache_directory);
+  coarse_solution = solveLevel(coarse_image, coarse_trimap, coarse_solution, NUM_LEVEL_ITERATIONS, cache_directory);
+  return liftSolution(coarse_solution, coarse_image.cols, coarse_image.rows, foreground_mask, background_mask, IMAGE_WIDTH, IMAGE_HEIGHT);
+}
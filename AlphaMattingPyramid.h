@@ -0,0 +1,27 @@
+#ifndef ALPHA_MATTING_PYRAMID_H__
+#define ALPHA_MATTING_PYRAMID_H__
+
+#include <vector>
+#include <string>
+#include <opencv2/core/core.hpp>
+
+#include "cv_utils.h"
+#include "Diagnostics.h"
+
+
+//Coarse-to-fine initialization. Pixel solutions hold the label foreground_pixel * NUM_PIXELS + background_pixel for every pixel (known pixels keep pixel * NUM_PIXELS + pixel).
+
+//trimap values above 200 are foreground, values below 100 background
+void calcTrimapMasks(const cv::Mat &trimap, cv_utils::ImageMask &foreground_mask, cv_utils::ImageMask &background_mask);
+//every unknown pixel takes the nearest boundary pixels of both masks
+std::vector<long> calcBoundarySolution(const cv_utils::ImageMask &foreground_mask, const cv_utils::ImageMask &background_mask, const int IMAGE_WIDTH, const int IMAGE_HEIGHT);
+//nearest pixel of mask to pixel (Euclidean distance, ties broken by row order within a ring), or -1 if mask is empty; the search only visits a square around pixel which grows up to that distance
+int findNearestMaskPixel(const cv_utils::ImageMask &mask, const int pixel, const int IMAGE_WIDTH, const int IMAGE_HEIGHT);
+//maps the solution of a coarser level to the finer level: every pixel takes the labels of its coarse pixel, with sample coordinates scaled up and snapped to the nearest boundary pixel of the fine mask if they fall outside it
+std::vector<long> liftSolution(const std::vector<long> &coarse_solution, const int COARSE_IMAGE_WIDTH, const int COARSE_IMAGE_HEIGHT, const cv_utils::ImageMask &foreground_mask, const cv_utils::ImageMask &background_mask, const int IMAGE_WIDTH, const int IMAGE_HEIGHT);
+//runs NUM_ITERATIONS fusions on one level starting from initial_solution; neighbor graphs are cached in cache_directory unless it is empty, and the proposal generator and solver report to diagnostics_sink
+std::vector<long> solveLevel(const cv::Mat &image, const cv::Mat &trimap, const std::vector<long> &initial_solution, const int NUM_ITERATIONS, const std::string &cache_directory = "", DiagnosticsSink *diagnostics_sink = NULL);
+//initial solution for image: the boundary solution of the level NUM_COARSE_LEVELS times halved, refined with NUM_LEVEL_ITERATIONS fusions on each coarse level and lifted level by level. Coarsening stops early once a level gets smaller than MIN_LEVEL_SIZE or loses all pixels of a trimap class.
+std::vector<long> calcCoarseToFineSolution(const cv::Mat &image, const cv::Mat &trimap, const int NUM_COARSE_LEVELS, const int NUM_LEVEL_ITERATIONS, const int MIN_LEVEL_SIZE = 32, const std::string &cache_directory = "");
+
+#endif
@@ -0,0 +1,198 @@
+#include "AlphaMattingSequence.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+#include "AlphaMatting.h"
+#include "AlphaMattingCostFunctor.h"
+#include "AlphaMattingProposalGenerator.h"
+#include "AlphaMattingPyramid.h"
+#include "FusionSpaceSolver.h"
+#include "ParallelFor.h"
+
+
+using namespace std;
+using namespace cv;
+using namespace cv_utils;
+
+MattingSequence::MattingSequence(const SequenceOptions &options) : options_(options), num_frames_(0), num_frames_since_keyframe_(0)
+{
+}
+
+void MattingSequence::reset()
+{
+  previous_image_ = Mat();
+  previous_solution_.clear();
+}
+
+bool MattingSequence::needsKeyframe(const Mat &image, const Mat &trimap) const
+{
+  if (previous_solution_.empty() || num_frames_since_keyframe_ + 1 >= options_.keyframe_interval)
+    return true;
+  const int IMAGE_WIDTH = image.cols;
+  const int IMAGE_HEIGHT = image.rows;
+  double frame_difference = 0;
+  for (int y = 0; y < IMAGE_HEIGHT; y++) {
+    const uchar *trimap_row = trimap.ptr<uchar>(y);
+    const uchar *keyframe_trimap_row = keyframe_trimap_.ptr<uchar>(y);
+    for (int x = 0; x < IMAGE_WIDTH; x++)
+      if (trimap_row[x] != keyframe_trimap_row[x])
+	return true;
+    const uchar *image_row = image.ptr<uchar>(y);
+    const uchar *keyframe_image_row = keyframe_image_.ptr<uchar>(y);
+    for (int index = 0; index < IMAGE_WIDTH * 3; index++)
+      frame_difference += abs(image_row[index] - keyframe_image_row[index]);
+  }
+  return frame_difference / (IMAGE_WIDTH * IMAGE_HEIGHT * 3) > options_.max_frame_difference;
+}
+
+bool MattingSequence::matteFrame(const Mat &image, const Mat &trimap, Mat &alpha)
+{
+  if (image.empty() || image.type() != CV_8UC3 || trimap.type() != CV_8UC1 || image.cols != trimap.cols || image.rows != trimap.rows)
+    return false;
+  if (previous_image_.empty() == false && (image.cols != previous_image_.cols || image.rows != previous_image_.rows))
+    return false;
+  
+  ThreadLimitGuard thread_limit_guard(options_.num_threads);
+  
+  ImageMask foreground_mask, background_mask;
+  calcTrimapMasks(trimap, foreground_mask, background_mask);
+  const bool KEYFRAME = needsKeyframe(image, trimap);
+  unique_ptr<AlphaMattingCostFunctor> cost_functor;
+  unique_ptr<AlphaMattingProposalGenerator> proposal_generator;
+  vector<long> solution;
+  //problems the solver rejects (see matte) leave the sequence untouched
+  try {
+    vector<long> initial_solution;
+    if (KEYFRAME)
+      initial_solution = calcCoarseToFineSolution(image, trimap, options_.num_coarse_levels, options_.num_level_iterations, 32, options_.cache_directory);
+    else {
+      vector<Vec2i> block_motion;
+      if (options_.motion_compensation)
+	block_motion = calcBlockMotion(previous_image_, image, options_.block_size, options_.search_radius);
+      initial_solution = warpSolution(previous_solution_, block_motion, options_.block_size, foreground_mask, background_mask, image.cols, image.rows);
+    }
+    
+    //a keyframe computes the structures which the following frames take over
+    cost_functor.reset(KEYFRAME ? new AlphaMattingCostFunctor(image, foreground_mask, background_mask, options_.cache_directory) : new AlphaMattingCostFunctor(image, foreground_mask, background_mask, keyframe_neighbor_graph_));
+    proposal_generator.reset(KEYFRAME ? new AlphaMattingProposalGenerator(image, foreground_mask, background_mask, options_.diagnostics_sink) : new AlphaMattingProposalGenerator(image, foreground_mask, background_mask, representative_foreground_pixels_, representative_background_pixels_));
+    proposal_generator->setNeighbors(cost_functor->getNeighborGraph());
+    FusionSpaceSolver solver(cost_functor->getNumNodes(), cost_functor->getNodeGraph(), *cost_functor, *proposal_generator, 200);
+    solver.setTiling(getNumThreads());
+    solver.setDiagnosticsSink(options_.diagnostics_sink);
+    
+    const vector<int> &node_pixels = cost_functor->getNodePixels();
+    vector<long> node_solution(node_pixels.size());
+    for (int node = 0; node < node_pixels.size(); node++)
+      node_solution[node] = initial_solution[node_pixels[node]];
+    node_solution = solver.solve(KEYFRAME ? options_.num_keyframe_iterations : options_.num_iterations, node_solution);
+    solution = initial_solution;
+    for (int node = 0; node < node_pixels.size(); node++)
+      solution[node_pixels[node]] = node_solution[node];
+  } catch (const invalid_argument &) {
+    return false;
+  }
+  
+  if (KEYFRAME) {
+    keyframe_image_ = image.clone();
+    keyframe_trimap_ = trimap.clone();
+    keyframe_neighbor_graph_ = cost_functor->getNeighborGraph();
+    representative_foreground_pixels_ = proposal_generator->getRepresentativeForegroundPixels();
+    representative_background_pixels_ = proposal_generator->getRepresentativeBackgroundPixels();
+    num_frames_since_keyframe_ = 0;
+  } else
+    num_frames_since_keyframe_++;
+  image.copyTo(previous_image_);
+  previous_solution_.swap(solution);
+  num_frames_++;
+  
+  calcSolutionAlpha(image, trimap, previous_solution_, alpha);
+  return true;
+}
+
+vector<Vec2i> calcBlockMotion(const Mat &previous_image, const Mat &image, const int BLOCK_SIZE, const int SEARCH_RADIUS)
+{
+  const int IMAGE_WIDTH = image.cols;
+  const int IMAGE_HEIGHT = image.rows;
+  Mat previous_gray_image, gray_image;
+  cvtColor(previous_image, previous_gray_image, CV_BGR2GRAY);
+  cvtColor(image, gray_image, CV_BGR2GRAY);
+  
+  const int NUM_BLOCKS_X = (IMAGE_WIDTH + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  const int NUM_BLOCKS_Y = (IMAGE_HEIGHT + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  vector<Vec2i> block_motion(NUM_BLOCKS_X * NUM_BLOCKS_Y, Vec2i(0, 0));
+  parallelFor(0, NUM_BLOCKS_Y, getNumThreads(), [&](const int, const int first_block_y, const int last_block_y) {
+      for (int block_y = first_block_y; block_y < last_block_y; block_y++) {
+	for (int block_x = 0; block_x < NUM_BLOCKS_X; block_x++) {
+	  const int X_1 = block_x * BLOCK_SIZE;
+	  const int Y_1 = block_y * BLOCK_SIZE;
+	  const int X_2 = min(X_1 + BLOCK_SIZE, IMAGE_WIDTH);
+	  const int Y_2 = min(Y_1 + BLOCK_SIZE, IMAGE_HEIGHT);
+	  int min_cost = numeric_limits<int>::max();
+	  int min_cost_motion_size = 0;
+	  Vec2i min_cost_motion(0, 0);
+	  for (int delta_y = -SEARCH_RADIUS; delta_y <= SEARCH_RADIUS; delta_y++) {
+	    for (int delta_x = -SEARCH_RADIUS; delta_x <= SEARCH_RADIUS; delta_x++) {
+	      //the shifted block has to lie inside the previous image
+	      if (X_1 - delta_x < 0 || X_2 - delta_x > IMAGE_WIDTH || Y_1 - delta_y < 0 || Y_2 - delta_y > IMAGE_HEIGHT)
+		continue;
+	      int cost = 0;
+	      for (int y = Y_1; y < Y_2 && cost <= min_cost; y++) {
+		const uchar *row = gray_image.ptr<uchar>(y);
+		const uchar *previous_row = previous_gray_image.ptr<uchar>(y - delta_y);
+		for (int x = X_1; x < X_2; x++)
+		  cost += abs(row[x] - previous_row[x - delta_x]);
+	      }
+	      const int MOTION_SIZE = abs(delta_x) + abs(delta_y);
+	      if (cost < min_cost || (cost == min_cost && MOTION_SIZE < min_cost_motion_size)) {
+		min_cost = cost;
+		min_cost_motion_size = MOTION_SIZE;
+		min_cost_motion = Vec2i(delta_x, delta_y);
+	      }
+	    }
+	  }
+	  block_motion[block_y * NUM_BLOCKS_X + block_x] = min_cost_motion;
+	}
+      }
+    });
+  return block_motion;
+}
+
+vector<long> warpSolution(const vector<long> &previous_solution, const vector<Vec2i> &block_motion, const int BLOCK_SIZE, const ImageMask &foreground_mask, const ImageMask &background_mask, const int IMAGE_WIDTH, const int IMAGE_HEIGHT)
+{
+  const int NUM_PIXELS = IMAGE_WIDTH * IMAGE_HEIGHT;
+  const int NUM_BLOCKS_X = (IMAGE_WIDTH + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  vector<double> foreground_distance_map;
+  vector<int> foreground_boundary_map;
+  foreground_mask.calcBoundaryDistanceMap(foreground_boundary_map, foreground_distance_map);
+  vector<double> background_distance_map;
+  vector<int> background_boundary_map;
+  background_mask.calcBoundaryDistanceMap(background_boundary_map, background_distance_map);
+  
+  auto move_pixel = [&](const int pixel, const Vec2i &motion) {
+    const int x = max(min(pixel % IMAGE_WIDTH + motion[0], IMAGE_WIDTH - 1), 0);
+    const int y = max(min(pixel / IMAGE_WIDTH + motion[1], IMAGE_HEIGHT - 1), 0);
+    return y * IMAGE_WIDTH + x;
+  };
+  
+  vector<long> solution(NUM_PIXELS);
+  for (int pixel = 0; pixel < NUM_PIXELS; pixel++) {
+    if (foreground_mask.at(pixel) || background_mask.at(pixel)) {
+      solution[pixel] = static_cast<long>(pixel) * NUM_PIXELS + pixel;
+      continue;
+    }
+    const Vec2i motion = block_motion.empty() ? Vec2i(0, 0) : block_motion[(pixel / IMAGE_WIDTH / BLOCK_SIZE) * NUM_BLOCKS_X + (pixel % IMAGE_WIDTH) / BLOCK_SIZE];
+    const long previous_label = previous_solution[move_pixel(pixel, Vec2i(-motion[0], -motion[1]))];
+    int foreground_pixel = move_pixel(previous_label / NUM_PIXELS, motion);
+    int background_pixel = move_pixel(previous_label % NUM_PIXELS, motion);
+    if (foreground_mask.at(foreground_pixel) == false)
+      foreground_pixel = foreground_boundary_map[foreground_pixel];
+    if (background_mask.at(background_pixel) == false)
+      background_pixel = background_boundary_map[background_pixel];
+    solution[pixel] = static_cast<long>(foreground_pixel) * NUM_PIXELS + background_pixel;
+  }
+  return solution;
+}
@@ -0,0 +1,70 @@
+#ifndef ALPHA_MATTING_SEQUENCE_H__
+#define ALPHA_MATTING_SEQUENCE_H__
+
+#include <vector>
+#include <string>
+#include <opencv2/core/core.hpp>
+
+#include "cv_utils.h"
+#include "NeighborGraph.h"
+#include "Diagnostics.h"
+
+
+//Video matting with temporal warm start. A keyframe is matted like matte (coarse-to-fine initialization and num_keyframe_iterations fusions). Every following frame starts from the label field of the previous frame, motion-compensated by block matching if motion_compensation is set, and runs num_iterations fusions.
+//Frames with the trimap of the keyframe also take over its pixel neighbor graph and representative colors. A new keyframe starts once the trimap changes, the mean absolute color difference to the keyframe exceeds max_frame_difference, or keyframe_interval frames have passed.
+//Taking over the neighbor graph is an approximation: its smoothness weights are the matting Laplacian affinities of the keyframe colors, so the following frames are smoothed along the keyframe's edges (the unary costs use their own colors). max_frame_difference and keyframe_interval bound how far the frames drift from the affinities they use.
+//Neighbor graphs of keyframes are cached in cache_directory unless it is empty, and intermediate outputs go to diagnostics_sink (not owned), as for matte.
+struct SequenceOptions
+{
+  int num_coarse_levels;
+  int num_level_iterations;
+  int num_keyframe_iterations;
+  int num_iterations;
+  int keyframe_interval;
+  double max_frame_difference;
+  bool motion_compensation;
+  int block_size;
+  int search_radius;
+  int num_threads;
+  std::string cache_directory;
+  DiagnosticsSink *diagnostics_sink;
+  
+  SequenceOptions() : num_coarse_levels(2), num_level_iterations(10), num_keyframe_iterations(30), num_iterations(3), keyframe_interval(30), max_frame_difference(4), motion_compensation(true), block_size(16), search_radius(8), num_threads(0), diagnostics_sink(NULL) {};
+};
+
+class MattingSequence
+{
+ public:
+  MattingSequence(const SequenceOptions &options = SequenceOptions());
+  
+  //alpha matte of the next frame, with the input requirements of matte. Returns false and leaves the sequence untouched if the inputs do not match (or the frame size differs from the previous frame) or the solver rejects the problem.
+  bool matteFrame(const cv::Mat &image, const cv::Mat &trimap, cv::Mat &alpha);
+  //the next frame becomes a keyframe
+  void reset();
+  
+  int getNumFrames() const { return num_frames_; };
+  bool isKeyframe() const { return num_frames_since_keyframe_ == 0; };
+  
+ private:
+  const SequenceOptions options_;
+  int num_frames_;
+  int num_frames_since_keyframe_;
+  
+  cv::Mat keyframe_image_;
+  cv::Mat keyframe_trimap_;
+  NeighborGraph keyframe_neighbor_graph_;
+  std::vector<int> representative_foreground_pixels_;
+  std::vector<int> representative_background_pixels_;
+  
+  cv::Mat previous_image_;
+  std::vector<long> previous_solution_;
+  
+  bool needsKeyframe(const cv::Mat &image, const cv::Mat &trimap) const;
+};
+
+//motion (dx, dy) of every BLOCK_SIZE x BLOCK_SIZE block of image (in row-major block order) such that the block matches previous_image shifted by it, found by exhaustive search of the sum of absolute gray value differences within SEARCH_RADIUS (ties keep the smaller motion)
+std::vector<cv::Vec2i> calcBlockMotion(const cv::Mat &previous_image, const cv::Mat &image, const int BLOCK_SIZE, const int SEARCH_RADIUS);
+//Warps the pixel solution of the previous frame to the current frame: every unknown pixel takes the labels of the previous pixel its block came from, with both sample pixels moved along the block motion and snapped to the nearest boundary pixel of the current mask if they fall outside it. An empty motion means no motion.
+std::vector<long> warpSolution(const std::vector<long> &previous_solution, const std::vector<cv::Vec2i> &block_motion, const int BLOCK_SIZE, const cv_utils::ImageMask &foreground_mask, const cv_utils::ImageMask &background_mask, const int IMAGE_WIDTH, const int IMAGE_HEIGHT);
+
+#endif
@@ -0,0 +1,257 @@
+#include "AlphaMattingSession.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+#include <stdexcept>
+#include <algorithm>
+
+#include "AlphaMatting.h"
+#include "AlphaMattingPyramid.h"
+#include "AlphaImage.h"
+#include "FusionSpaceSolver.h"
+#include "ParallelFor.h"
+
+
+using namespace std;
+using namespace cv;
+using namespace cv_utils;
+
+MattingSession::MattingSession(const Mat &image, const Mat &trimap, const SessionOptions &options) : options_(options), image_(image.clone()), trimap_(trimap.clone()), valid_(false), num_foreground_pixels_(0), num_background_pixels_(0), num_active_pixels_(0), num_sample_user_entries_(0)
+{
+  if (image.empty() || image.type() != CV_8UC3 || trimap.type() != CV_8UC1 || image.cols != trimap.cols || image.rows != trimap.rows)
+    return;
+  calcTrimapMasks(trimap_, foreground_mask_, background_mask_);
+  num_foreground_pixels_ = foreground_mask_.getNumPixels();
+  num_background_pixels_ = background_mask_.getNumPixels();
+  if (num_foreground_pixels_ == 0 || num_background_pixels_ == 0)
+    return;
+  
+  try {
+    ThreadLimitGuard thread_limit_guard(options_.num_threads);
+    solution_ = calcCoarseToFineSolution(image_, trimap_, options_.num_coarse_levels, options_.num_level_iterations);
+    cost_functor_.reset(new AlphaMattingCostFunctor(image_, foreground_mask_, background_mask_));
+    proposal_generator_.reset(new AlphaMattingProposalGenerator(image_, foreground_mask_, background_mask_, options_.diagnostics_sink));
+    proposal_generator_->setNeighbors(cost_functor_->getNeighborGraph());
+    fuseNodes(options_.num_iterations);
+  } catch (const invalid_argument &) {
+    return;
+  }
+  valid_ = true;
+  
+  const vector<int> &node_pixels = cost_functor_->getNodePixels();
+  for (vector<int>::const_iterator pixel_it = node_pixels.begin(); pixel_it != node_pixels.end(); pixel_it++)
+    addSampleUser(*pixel_it);
+  calcSolutionAlpha(image_, trimap_, solution_, alpha_);
+}
+
+bool MattingSession::updateTrimap(const Mat &trimap, const Rect &dirty_rect)
+{
+  return update(trimap, dirty_rect, Mat());
+}
+
+bool MattingSession::updateTrimap(const Mat &trimap, const Mat &dirty_mask)
+{
+  if (valid_ == false || dirty_mask.type() != CV_8UC1 || dirty_mask.cols != image_.cols || dirty_mask.rows != image_.rows)
+    return false;
+  int min_x = image_.cols, min_y = image_.rows, max_x = -1, max_y = -1;
+  for (int y = 0; y < dirty_mask.rows; y++) {
+    const uchar *dirty_mask_row = dirty_mask.ptr<uchar>(y);
+    for (int x = 0; x < dirty_mask.cols; x++) {
+      if (dirty_mask_row[x] == 0)
+	continue;
+      min_x = min(min_x, x);
+      max_x = max(max_x, x);
+      min_y = min(min_y, y);
+      max_y = max(max_y, y);
+    }
+  }
+  if (max_x < 0)
+    return update(trimap, Rect(0, 0, 0, 0), dirty_mask);
+  return update(trimap, Rect(min_x, min_y, max_x - min_x + 1, max_y - min_y + 1), dirty_mask);
+}
+
+bool MattingSession::update(const Mat &trimap, const Rect &dirty_rect, const Mat &dirty_mask)
+{
+  const int IMAGE_WIDTH = image_.cols;
+  const int IMAGE_HEIGHT = image_.rows;
+  const int NUM_PIXELS = IMAGE_WIDTH * IMAGE_HEIGHT;
+  if (valid_ == false || trimap.type() != CV_8UC1 || trimap.cols != IMAGE_WIDTH || trimap.rows != IMAGE_HEIGHT)
+    return false;
+  const int DIRTY_X_1 = max(dirty_rect.x, 0);
+  const int DIRTY_Y_1 = max(dirty_rect.y, 0);
+  const int DIRTY_X_2 = min(dirty_rect.x + dirty_rect.width, IMAGE_WIDTH);
+  const int DIRTY_Y_2 = min(dirty_rect.y + dirty_rect.height, IMAGE_HEIGHT);
+  num_active_pixels_ = 0;
+  if (DIRTY_X_1 >= DIRTY_X_2 || DIRTY_Y_1 >= DIRTY_Y_2)
+    return true;
+  const Rect DIRTY_RECT(DIRTY_X_1, DIRTY_Y_1, DIRTY_X_2 - DIRTY_X_1, DIRTY_Y_2 - DIRTY_Y_1);
+  
+  //the masks only change inside the dirty rectangle (with the thresholds of calcTrimapMasks), so the pixel counts are updated from it
+  int num_foreground_pixels = num_foreground_pixels_;
+  int num_background_pixels = num_background_pixels_;
+  for (int y = DIRTY_Y_1; y < DIRTY_Y_2; y++) {
+    for (int x = DIRTY_X_1; x < DIRTY_X_2; x++) {
+      const int pixel = y * IMAGE_WIDTH + x;
+      num_foreground_pixels += (trimap.at<uchar>(y, x) > 200) - foreground_mask_.at(pixel);
+      num_background_pixels += (trimap.at<uchar>(y, x) < 100) - background_mask_.at(pixel);
+    }
+  }
+  if (num_foreground_pixels == 0 || num_background_pixels == 0)
+    return false;
+  
+  Mat trimap_region = trimap_(DIRTY_RECT);
+  trimap(DIRTY_RECT).copyTo(trimap_region);
+  vector<int> left_mask_pixels;
+  for (int y = DIRTY_Y_1; y < DIRTY_Y_2; y++) {
+    for (int x = DIRTY_X_1; x < DIRTY_X_2; x++) {
+      const int pixel = y * IMAGE_WIDTH + x;
+      const bool IS_FOREGROUND = trimap.at<uchar>(y, x) > 200;
+      const bool IS_BACKGROUND = trimap.at<uchar>(y, x) < 100;
+      if ((foreground_mask_.at(pixel) && IS_FOREGROUND == false) || (background_mask_.at(pixel) && IS_BACKGROUND == false))
+	left_mask_pixels.push_back(pixel);
+      foreground_mask_.set(pixel, IS_FOREGROUND);
+      background_mask_.set(pixel, IS_BACKGROUND);
+    }
+  }
+  num_foreground_pixels_ = num_foreground_pixels;
+  num_background_pixels_ = num_background_pixels;
+  
+  ThreadLimitGuard thread_limit_guard(options_.num_threads);
+  
+  //the band is the dirty rectangle grown by band_radius, or the dilated dirty mask within it
+  const int BAND_X_1 = max(DIRTY_X_1 - options_.band_radius, 0);
+  const int BAND_Y_1 = max(DIRTY_Y_1 - options_.band_radius, 0);
+  const int BAND_X_2 = min(DIRTY_X_2 + options_.band_radius, IMAGE_WIDTH);
+  const int BAND_Y_2 = min(DIRTY_Y_2 + options_.band_radius, IMAGE_HEIGHT);
+  const Rect BAND_RECT(BAND_X_1, BAND_Y_1, BAND_X_2 - BAND_X_1, BAND_Y_2 - BAND_Y_1);
+  Mat band_mask;
+  if (dirty_mask.empty())
+    band_mask = Mat::ones(BAND_RECT.height, BAND_RECT.width, CV_8UC1);
+  else
+    dilate(dirty_mask(BAND_RECT), band_mask, getStructuringElement(MORPH_RECT, Size(options_.band_radius * 2 + 1, options_.band_radius * 2 + 1)));
+  
+  //Unknown pixels in the band are fused again, as are those whose samples left their mask, which are looked up by sample. Their labels are repaired first by moving invalid samples to the nearest pixel of the right mask (newly unknown pixels have their own pixel as both samples).
+  vector<int> active_pixels;
+  for (int y = BAND_Y_1; y < BAND_Y_2; y++) {
+    for (int x = BAND_X_1; x < BAND_X_2; x++) {
+      const int pixel = y * IMAGE_WIDTH + x;
+      if (band_mask.at<uchar>(y - BAND_Y_1, x - BAND_X_1) == 0)
+	continue;
+      if (foreground_mask_.at(pixel) || background_mask_.at(pixel))
+	solution_[pixel] = static_cast<long>(pixel) * NUM_PIXELS + pixel;
+      else
+	active_pixels.push_back(pixel);
+    }
+  }
+  for (vector<int>::const_iterator sample_pixel_it = left_mask_pixels.begin(); sample_pixel_it != left_mask_pixels.end(); sample_pixel_it++) {
+    unordered_map<int, vector<int> >::iterator users_it = sample_users_.find(*sample_pixel_it);
+    if (users_it == sample_users_.end())
+      continue;
+    for (vector<int>::const_iterator pixel_it = users_it->second.begin(); pixel_it != users_it->second.end(); pixel_it++)
+      if (isSampleUser(*pixel_it, *sample_pixel_it))
+	active_pixels.push_back(*pixel_it);
+    //the users get new samples below and are listed under them after the fusion
+    num_sample_user_entries_ -= users_it->second.size();
+    sample_users_.erase(users_it);
+  }
+  sort(active_pixels.begin(), active_pixels.end());
+  active_pixels.erase(unique(active_pixels.begin(), active_pixels.end()), active_pixels.end());
+  for (vector<int>::const_iterator pixel_it = active_pixels.begin(); pixel_it != active_pixels.end(); pixel_it++) {
+    int foreground_pixel = solution_[*pixel_it] / NUM_PIXELS;
+    int background_pixel = solution_[*pixel_it] % NUM_PIXELS;
+    if (foreground_mask_.at(foreground_pixel) == false)
+      foreground_pixel = findNearestMaskPixel(foreground_mask_, foreground_pixel, IMAGE_WIDTH, IMAGE_HEIGHT);
+    if (background_mask_.at(background_pixel) == false)
+      background_pixel = findNearestMaskPixel(background_mask_, background_pixel, IMAGE_WIDTH, IMAGE_HEIGHT);
+    solution_[*pixel_it] = static_cast<long>(foreground_pixel) * NUM_PIXELS + background_pixel;
+  }
+  num_active_pixels_ = active_pixels.size();
+  
+  //the solver rejecting the edited problem leaves the session half updated, so it becomes invalid
+  try {
+    cost_functor_->updateTrimap(foreground_mask_, background_mask_, DIRTY_RECT, active_pixels);
+    proposal_generator_->updateTrimap(foreground_mask_, background_mask_, DIRTY_RECT);
+    cost_functor_->setNodePixels(active_pixels, solution_);
+    proposal_generator_->setNodePixels(active_pixels, solution_);
+    if (active_pixels.empty() == false)
+      fuseNodes(options_.num_band_iterations);
+  } catch (const invalid_argument &) {
+    valid_ = false;
+    return false;
+  }
+  for (vector<int>::const_iterator pixel_it = active_pixels.begin(); pixel_it != active_pixels.end(); pixel_it++)
+    addSampleUser(*pixel_it);
+  //every unknown pixel has two valid entries, so the stale ones are dropped once they are as many
+  if (num_sample_user_entries_ > 4 * (NUM_PIXELS - num_foreground_pixels_ - num_background_pixels_))
+    compactSampleUsers();
+  
+  for (int y = BAND_Y_1; y < BAND_Y_2; y++)
+    for (int x = BAND_X_1; x < BAND_X_2; x++)
+      updateAlpha(y * IMAGE_WIDTH + x);
+  for (vector<int>::const_iterator pixel_it = active_pixels.begin(); pixel_it != active_pixels.end(); pixel_it++)
+    updateAlpha(*pixel_it);
+  return true;
+}
+
+void MattingSession::fuseNodes(const int NUM_ITERATIONS)
+{
+  const vector<int> &node_pixels = cost_functor_->getNodePixels();
+  const int NUM_NODES = node_pixels.size();
+  FusionSpaceSolver solver(NUM_NODES, cost_functor_->getNodeGraph(), *cost_functor_, *proposal_generator_, 200);
+  solver.setDiagnosticsSink(options_.diagnostics_sink);
+  solver.setTiling(getNumThreads());
+  
+  vector<long> node_solution(NUM_NODES);
+  for (int node = 0; node < NUM_NODES; node++)
+    node_solution[node] = solution_[node_pixels[node]];
+  node_solution = solver.solve(NUM_ITERATIONS, node_solution);
+  for (int node = 0; node < NUM_NODES; node++)
+    solution_[node_pixels[node]] = node_solution[node];
+}
+
+//the same as calcSolutionAlpha for one pixel
+void MattingSession::updateAlpha(const int pixel)
+{
+  const int IMAGE_WIDTH = image_.cols;
+  const int NUM_PIXELS = image_.cols * image_.rows;
+  const int trimap_value = trimap_.at<uchar>(pixel / IMAGE_WIDTH, pixel % IMAGE_WIDTH);
+  double pixel_alpha = trimap_value > 200 ? 1 : 0;
+  if (trimap_value >= 100 && trimap_value <= 200)
+    pixel_alpha = calcAlpha(image_, pixel, solution_[pixel] / NUM_PIXELS, solution_[pixel] % NUM_PIXELS);
+  alpha_.at<uchar>(pixel / IMAGE_WIDTH, pixel % IMAGE_WIDTH) = pixel_alpha * 255;
+}
+
+//lists the unknown pixel under both samples of its label
+void MattingSession::addSampleUser(const int pixel)
+{
+  const int NUM_PIXELS = image_.cols * image_.rows;
+  sample_users_[solution_[pixel] / NUM_PIXELS].push_back(pixel);
+  sample_users_[solution_[pixel] % NUM_PIXELS].push_back(pixel);
+  num_sample_user_entries_ += 2;
+}
+
+//whether pixel is unknown and its label has sample_pixel as a sample
+bool MattingSession::isSampleUser(const int pixel, const int sample_pixel) const
+{
+  const int NUM_PIXELS = image_.cols * image_.rows;
+  if (foreground_mask_.at(pixel) || background_mask_.at(pixel))
+    return false;
+  return solution_[pixel] / NUM_PIXELS == sample_pixel || solution_[pixel] % NUM_PIXELS == sample_pixel;
+}
+
+//drops stale and repeated entries, which takes time proportional to the entries rather than the image
+void MattingSession::compactSampleUsers()
+{
+  num_sample_user_entries_ = 0;
+  for (unordered_map<int, vector<int> >::iterator users_it = sample_users_.begin(); users_it != sample_users_.end(); ) {
+    vector<int> &users = users_it->second;
+    sort(users.begin(), users.end());
+    users.erase(unique(users.begin(), users.end()), users.end());
+    const int sample_pixel = users_it->first;
+    users.erase(remove_if(users.begin(), users.end(), [&](const int pixel) { return isSampleUser(pixel, sample_pixel) == false; }), users.end());
+    num_sample_user_entries_ += users.size();
+    if (users.empty())
+      users_it = sample_users_.erase(users_it);
+    else
+      users_it++;
+  }
+}
@@ -0,0 +1,77 @@
+#ifndef ALPHA_MATTING_SESSION_H__
+#define ALPHA_MATTING_SESSION_H__
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <opencv2/core/core.hpp>
+
+#include "cv_utils.h"
+#include "AlphaMattingCostFunctor.h"
+#include "AlphaMattingProposalGenerator.h"
+#include "Diagnostics.h"
+
+
+//Interactive matting. The session mattes the first trimap like matte and keeps the cost functor, the proposal generator and the label field. After a local trimap edit only the masks inside the edit and the neighbor weights of the edges touching it are updated, and only the unknown pixels within band_radius of the edited pixels (and those whose samples the edit moved out of their mask) are fused again, as a problem of their own with all other labels fixed, for num_band_iterations. The work per edit follows the size of the edit.
+struct SessionOptions
+{
+  int num_coarse_levels;
+  int num_level_iterations;
+  int num_iterations;
+  int num_band_iterations;
+  int band_radius;
+  int num_threads;
+  DiagnosticsSink *diagnostics_sink;
+  
+  SessionOptions() : num_coarse_levels(2), num_level_iterations(10), num_iterations(30), num_band_iterations(5), band_radius(8), num_threads(0), diagnostics_sink(NULL) {};
+};
+
+class MattingSession
+{
+ public:
+  //image and trimap have the input requirements of matte; both are copied. If they do not meet them, the trimap has no foreground or background pixels or the solver rejects the problem (see matte), the session is invalid and stays empty.
+  MattingSession(const cv::Mat &image, const cv::Mat &trimap, const SessionOptions &options = SessionOptions());
+  
+  bool isValid() const { return valid_; };
+  
+  //Takes the edited trimap, which differs from the current one only inside dirty_rect (resp. at the nonzero pixels of the CV_8UC1 dirty_mask). Returns false and leaves the session untouched if the session is invalid, the inputs do not match or the edit removes all foreground or background pixels. If the solver rejects the edited problem, it returns false and the session becomes invalid.
+  bool updateTrimap(const cv::Mat &trimap, const cv::Rect &dirty_rect);
+  bool updateTrimap(const cv::Mat &trimap, const cv::Mat &dirty_mask);
+  
+  //CV_8UC1 alpha matte of the current trimap
+  const cv::Mat &getAlpha() const { return alpha_; };
+  //pixel solution as returned by solveLevel
+  const std::vector<long> &getSolution() const { return solution_; };
+  //unknown pixels fused again by the last update
+  int getNumActivePixels() const { return num_active_pixels_; };
+  
+ private:
+  const SessionOptions options_;
+  const cv::Mat image_;
+  cv::Mat trimap_;
+  bool valid_;
+  
+  cv_utils::ImageMask foreground_mask_;
+  cv_utils::ImageMask background_mask_;
+  int num_foreground_pixels_;
+  int num_background_pixels_;
+  
+  std::unique_ptr<AlphaMattingCostFunctor> cost_functor_;
+  std::unique_ptr<AlphaMattingProposalGenerator> proposal_generator_;
+  std::vector<long> solution_;
+  cv::Mat alpha_;
+  int num_active_pixels_;
+  //Unknown pixels by the samples of their labels. Every unknown pixel is listed under both of its samples; entries are added whenever a label changes and stale ones are only dropped by compactSampleUsers, so they are checked against solution_.
+  std::unordered_map<int, std::vector<int> > sample_users_;
+  int num_sample_user_entries_;
+  
+  bool update(const cv::Mat &trimap, const cv::Rect &dirty_rect, const cv::Mat &dirty_mask);
+  //fuses the current nodes of the cost functor (tiled) with all other labels fixed
+  void fuseNodes(const int NUM_ITERATIONS);
+  void updateAlpha(const int pixel);
+  void addSampleUser(const int pixel);
+  bool isSampleUser(const int pixel, const int sample_pixel) const;
+  void compactSampleUsers();
+};
+
+#endif
@@ -0,0 +1,245 @@
+#include "BatchRunner.h"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <sys/stat.h>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+#include "AlphaMatting.h"
+#include "AlphaMattingSequence.h"
+#include "ParallelFor.h"
+#include "SolverTelemetry.h"
+
+
+using namespace std;
+using namespace cv;
+
+bool readManifest(const string &manifest_filename, vector<MattingJob> &jobs)
+{
+  ifstream manifest_in_str(manifest_filename.c_str());
+  if (!manifest_in_str)
+    return false;
+  string line;
+  while (getline(manifest_in_str, line)) {
+    stringstream line_str(line);
+    MattingJob job;
+    if (!(line_str >> job.image_filename) || job.image_filename[0] == '#')
+      continue;
+    if (!(line_str >> job.trimap_filename >> job.output_filename))
+      return false;
+    jobs.push_back(job);
+  }
+  return true;
+}
+
+bool isUpToDate(const string &output_filename, const vector<string> &input_filenames)
+{
+  struct stat output_status;
+  if (stat(output_filename.c_str(), &output_status) != 0)
+    return false;
+  for (vector<string>::const_iterator input_filename_it = input_filenames.begin(); input_filename_it != input_filenames.end(); input_filename_it++) {
+    struct stat input_status;
+    if (stat(input_filename_it->c_str(), &input_status) != 0)
+      return false;
+    //an input written within the same timestamp tick as the output counts as newer
+    if (input_status.st_mtim.tv_sec > output_status.st_mtim.tv_sec || (input_status.st_mtim.tv_sec == output_status.st_mtim.tv_sec && input_status.st_mtim.tv_nsec >= output_status.st_mtim.tv_nsec))
+      return false;
+  }
+  return true;
+}
+
+namespace
+{
+  const char *getJobStatusName(const JobStatus status)
+  {
+    switch (status) {
+    case JOB_DONE:
+      return "done";
+    case JOB_SKIPPED:
+      return "skipped";
+    case JOB_FAILED:
+      return "failed";
+    case JOB_OVER_MEMORY_LIMIT:
+      return "over memory limit";
+    }
+    return "unknown";
+  }
+  
+  //quoted JSON string with quotes, backslashes and control characters escaped
+  string toJsonString(const string &value)
+  {
+    stringstream value_str;
+    value_str << '"';
+    for (string::const_iterator char_it = value.begin(); char_it != value.end(); char_it++) {
+      const unsigned char c = *char_it;
+      if (c == '"' || c == '\\')
+	value_str << '\\' << c;
+      else if (c == '\n')
+	value_str << "\\n";
+      else if (c == '\t')
+	value_str << "\\t";
+      else if (c < 0x20)
+	value_str << "\\u" << hex << setw(4) << setfill('0') << static_cast<int>(c) << dec;
+      else
+	value_str << c;
+    }
+    value_str << '"';
+    return value_str.str();
+  }
+  
+  //memory reserved by the running jobs
+  class MemoryBudget
+  {
+  public:
+    MemoryBudget(const long budget) : BUDGET_(budget), reserved_(0) {};
+    
+    void reserve(const long bytes)
+    {
+      unique_lock<mutex> lock(mutex_);
+      while (BUDGET_ > 0 && reserved_ > 0 && reserved_ + bytes > BUDGET_)
+	released_.wait(lock);
+      reserved_ += bytes;
+    };
+    void release(const long bytes)
+    {
+      {
+	lock_guard<mutex> lock(mutex_);
+	reserved_ -= bytes;
+      }
+      released_.notify_all();
+    };
+    
+  private:
+    const long BUDGET_;
+    long reserved_;
+    mutex mutex_;
+    condition_variable released_;
+  };
+  
+  //holds a reservation of memory_budget until it goes out of scope, also when the job throws
+  class MemoryReservation
+  {
+  public:
+    MemoryReservation(MemoryBudget &memory_budget, const long bytes) : memory_budget_(memory_budget), BYTES_(bytes) { memory_budget_.reserve(BYTES_); };
+    ~MemoryReservation() { memory_budget_.release(BYTES_); };
+    
+  private:
+    MemoryBudget &memory_budget_;
+    const long BYTES_;
+  };
+  
+  //frames of a sequence go through matting_sequence (NULL for independent jobs); a job throwing (e.g. on a failed allocation) fails with the message in its report
+  JobReport runJob(const MattingJob &job, const BatchOptions &options, MemoryBudget &memory_budget, MattingSequence *matting_sequence)
+  {
+    JobReport report;
+    const chrono::steady_clock::time_point JOB_START = chrono::steady_clock::now();
+    chrono::steady_clock::time_point lap_start = JOB_START;
+    
+    try {
+      vector<string> input_filenames;
+      input_filenames.push_back(job.image_filename);
+      input_filenames.push_back(job.trimap_filename);
+      if (options.skip_up_to_date && isUpToDate(job.output_filename, input_filenames)) {
+        //the frame after a frame which is not matted has no previous solution to start from
+        if (matting_sequence != NULL)
+	  matting_sequence->reset();
+        report.status = JOB_SKIPPED;
+        report.total_seconds = calcLapSeconds(lap_start);
+        return report;
+      }
+      
+      Mat image = imread(job.image_filename);
+      Mat trimap = imread(job.trimap_filename, 0);
+      report.load_seconds = calcLapSeconds(lap_start);
+      if (image.empty() || trimap.empty() || image.cols != trimap.cols || image.rows != trimap.rows) {
+        if (matting_sequence != NULL)
+	  matting_sequence->reset();
+        report.status = JOB_FAILED;
+        report.total_seconds = chrono::duration<double>(chrono::steady_clock::now() - JOB_START).count();
+        return report;
+      }
+      report.estimated_bytes = static_cast<long>(image.cols) * image.rows * options.bytes_per_pixel;
+      if (options.job_memory_limit > 0 && report.estimated_bytes > options.job_memory_limit) {
+        if (matting_sequence != NULL)
+	  matting_sequence->reset();
+        report.status = JOB_OVER_MEMORY_LIMIT;
+        report.total_seconds = chrono::duration<double>(chrono::steady_clock::now() - JOB_START).count();
+        return report;
+      }
+      
+      Mat alpha_image;
+      bool succeeded = false;
+      {
+        MemoryReservation memory_reservation(memory_budget, report.estimated_bytes);
+        report.wait_seconds = calcLapSeconds(lap_start);
+        MattingOptions matting_options;
+        matting_options.num_coarse_levels = options.num_coarse_levels;
+        matting_options.num_iterations = options.num_iterations;
+        matting_options.cache_directory = options.cache_directory;
+        succeeded = matting_sequence != NULL ? matting_sequence->matteFrame(image, trimap, alpha_image) : matte(image, trimap, alpha_image, matting_options);
+        report.solve_seconds = calcLapSeconds(lap_start);
+      }
+      report.status = succeeded && imwrite(job.output_filename, alpha_image) ? JOB_DONE : JOB_FAILED;
+      report.write_seconds = calcLapSeconds(lap_start);
+      report.total_seconds = chrono::duration<double>(chrono::steady_clock::now() - JOB_START).count();
+      return report;
+    } catch (const exception &error) {
+      if (matting_sequence != NULL)
+	matting_sequence->reset();
+      report.status = JOB_FAILED;
+      report.error_message = error.what();
+      report.total_seconds = chrono::duration<double>(chrono::steady_clock::now() - JOB_START).count();
+      return report;
+    }
+  }
+}
+
+vector<JobReport> runBatch(const vector<MattingJob> &jobs, const BatchOptions &options, ostream &report_str)
+{
+  const int NUM_JOBS = jobs.size();
+  const int NUM_WORKERS = options.sequence ? 1 : max(min(options.num_workers > 0 ? options.num_workers : getNumThreads(), NUM_JOBS), 1);
+  const int NUM_WORKER_THREADS = max(getNumThreads() / NUM_WORKERS, 1);
+  MemoryBudget memory_budget(options.memory_budget);
+  vector<JobReport> reports(NUM_JOBS);
+  atomic<int> next_job_index(0);
+  mutex report_mutex;
+  SequenceOptions sequence_options;
+  sequence_options.num_coarse_levels = options.num_coarse_levels;
+  sequence_options.num_keyframe_iterations = options.num_iterations;
+  sequence_options.num_iterations = options.num_sequence_iterations;
+  sequence_options.cache_directory = options.cache_directory;
+  MattingSequence matting_sequence(sequence_options);
+  auto worker = [&]() {
+    getThreadLimit() = NUM_WORKER_THREADS;
+    while (true) {
+      const int job_index = next_job_index++;
+      if (job_index >= NUM_JOBS)
+	break;
+      JobReport report = runJob(jobs[job_index], options, memory_budget, options.sequence ? &matting_sequence : NULL);
+      report.job_index = job_index;
+      reports[job_index] = report;
+      
+      lock_guard<mutex> lock(report_mutex);
+      report_str << "{\"job\":" << job_index << ",\"image\":" << toJsonString(jobs[job_index].image_filename) << ",\"output\":" << toJsonString(jobs[job_index].output_filename) << ",\"status\":\"" << getJobStatusName(report.status) << "\"";
+      report_str << ",\"estimated_bytes\":" << report.estimated_bytes << ",\"load_seconds\":" << report.load_seconds << ",\"wait_seconds\":" << report.wait_seconds;
+      report_str << ",\"solve_seconds\":" << report.solve_seconds << ",\"write_seconds\":" << report.write_seconds << ",\"total_seconds\":" << report.total_seconds;
+      if (report.error_message.empty() == false)
+	report_str << ",\"error\":" << toJsonString(report.error_message);
+      report_str << "}" << endl;
+    }
+  };
+  
+  vector<thread> threads;
+  for (int thread_index = 0; thread_index < NUM_WORKERS; thread_index++)
+    threads.push_back(thread(worker));
+  for (vector<thread>::iterator thread_it = threads.begin(); thread_it != threads.end(); thread_it++)
+    thread_it->join();
+  return reports;
+}
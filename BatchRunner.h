@@ -0,0 +1,60 @@
+#ifndef BATCH_RUNNER_H__
+#define BATCH_RUNNER_H__
+
+#include <vector>
+#include <string>
+#include <ostream>
+
+
+struct MattingJob
+{
+  std::string image_filename;
+  std::string trimap_filename;
+  std::string output_filename;
+};
+
+//one job per line: image, trimap and output filenames separated by whitespace; empty lines and lines starting with # are skipped. Returns false if the manifest cannot be read or a line is incomplete.
+bool readManifest(const std::string &manifest_filename, std::vector<MattingJob> &jobs);
+
+//Memory is accounted with an estimate of bytes_per_pixel per image pixel. Jobs wait until their estimate fits into memory_budget next to the running jobs (a job larger than the budget runs alone); jobs above job_memory_limit are not run. 0 disables either limit, and num_workers = 0 uses one worker per hardware thread. Neighbor graphs are cached in cache_directory unless it is empty.
+//With sequence set the jobs are consecutive video frames: they run in order on one worker through a MattingSequence, keyframes with num_iterations fusions and the other frames with num_sequence_iterations.
+struct BatchOptions
+{
+  int num_workers;
+  long memory_budget;
+  long job_memory_limit;
+  long bytes_per_pixel;
+  int num_coarse_levels;
+  int num_iterations;
+  bool skip_up_to_date;
+  std::string cache_directory;
+  bool sequence;
+  int num_sequence_iterations;
+  
+  BatchOptions() : num_workers(0), memory_budget(0), job_memory_limit(0), bytes_per_pixel(4096), num_coarse_levels(2), num_iterations(30), skip_up_to_date(true), cache_directory("Cache/"), sequence(false), num_sequence_iterations(3) {};
+};
+
+enum JobStatus { JOB_DONE, JOB_SKIPPED, JOB_FAILED, JOB_OVER_MEMORY_LIMIT };
+
+struct JobReport
+{
+  int job_index;
+  JobStatus status;
+  long estimated_bytes;
+  double load_seconds;
+  double wait_seconds;
+  double solve_seconds;
+  double write_seconds;
+  double total_seconds;
+  //what() of the exception a failed job threw (empty otherwise)
+  std::string error_message;
+  
+  JobReport() : job_index(0), status(JOB_FAILED), estimated_bytes(0), load_seconds(0), wait_seconds(0), solve_seconds(0), write_seconds(0), total_seconds(0) {};
+};
+
+//true if output_filename exists and is newer than all inputs (by modification time in nanoseconds)
+bool isUpToDate(const std::string &output_filename, const std::vector<std::string> &input_filenames);
+//runs all jobs on a pool of workers; the parallel loops of every job use an equal share of the hardware threads. Every finished job is written to report_str as one JSON line, and the reports are returned in job order.
+std::vector<JobReport> runBatch(const std::vector<MattingJob> &jobs, const BatchOptions &options, std::ostream &report_str);
+
+#endif
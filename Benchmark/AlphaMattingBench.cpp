@@ -0,0 +1,182 @@
+#include <opencv2/core/core.hpp>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+#include "AlphaMattingCostFunctor.h"
+#include "AlphaMattingProposalGenerator.h"
+#include "AlphaMattingPyramid.h"
+#include "AlphaImage.h"
+#include "FusionSpaceSolver.h"
+#include "ParallelFor.h"
+#include "SolverTelemetry.h"
+#include "SyntheticMatting.h"
+#include "cv_utils.h"
+
+
+using namespace std;
+using namespace cv;
+using namespace cv_utils;
+
+//sums the per-fusion time splits of all solves
+class StageTimingSink : public TelemetrySink
+{
+ public:
+  StageTimingSink() : num_fusions_(0), stop_reason_("not started") {};
+  
+  virtual void recordFusion(const FusionTelemetry &fusion_telemetry)
+  {
+    totals_.proposal_seconds += fusion_telemetry.proposal_seconds;
+    totals_.unary_seconds += fusion_telemetry.unary_seconds;
+    totals_.pairwise_seconds += fusion_telemetry.pairwise_seconds;
+    totals_.optimization_seconds += fusion_telemetry.optimization_seconds;
+    totals_.decode_seconds += fusion_telemetry.decode_seconds;
+    totals_.num_edges = fusion_telemetry.num_edges;
+    totals_.num_labels = fusion_telemetry.num_labels;
+    num_fusions_++;
+  };
+  virtual void recordSolve(const SolveTelemetry &solve_telemetry) { stop_reason_ = solve_telemetry.stop_reason; };
+  
+  const FusionTelemetry &getTotals() const { return totals_; };
+  int getNumFusions() const { return num_fusions_; };
+  const string &getStopReason() const { return stop_reason_; };
+  
+ private:
+  FusionTelemetry totals_;
+  int num_fusions_;
+  string stop_reason_;
+};
+
+void printUsage()
+{
+  cout << "usage: AlphaMattingBench [--megapixels 0.1,1,10] [--band-width 20] [--texture 10] [--colors 4] [--seed 0] [--fusions 10] [--tiles <threads>] [--alpha-image 1] [--output AlphaMattingBench.json]" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+  vector<double> megapixels;
+  SyntheticMattingOptions synthetic_options;
+  int num_fusions = 10;
+  int num_tiles = getNumThreads();
+  bool run_alpha_image = true;
+  string output_filename = "AlphaMattingBench.json";
+  for (int arg_index = 1; arg_index < argc; arg_index++) {
+    const string arg = argv[arg_index];
+    if (arg_index + 1 >= argc) {
+      printUsage();
+      exit(1);
+    }
+    const string value = argv[++arg_index];
+    if (arg == "--megapixels") {
+      stringstream value_str(value);
+      string size;
+      while (getline(value_str, size, ','))
+	megapixels.push_back(atof(size.c_str()));
+    } else if (arg == "--band-width")
+      synthetic_options.band_width = atoi(value.c_str());
+    else if (arg == "--texture")
+      synthetic_options.texture = atof(value.c_str());
+    else if (arg == "--colors")
+      synthetic_options.num_colors = atoi(value.c_str());
+    else if (arg == "--seed")
+      synthetic_options.seed = strtoull(value.c_str(), NULL, 10);
+    else if (arg == "--fusions")
+      num_fusions = atoi(value.c_str());
+    else if (arg == "--tiles")
+      num_tiles = atoi(value.c_str());
+    else if (arg == "--alpha-image")
+      run_alpha_image = atoi(value.c_str()) != 0;
+    else if (arg == "--output")
+      output_filename = value;
+    else {
+      printUsage();
+      exit(1);
+    }
+  }
+  if (megapixels.empty())
+    megapixels.push_back(0.1);
+  
+  stringstream json_str;
+  json_str << "{\"num_threads\":" << getNumThreads() << ",\"runs\":[";
+  for (int size_index = 0; size_index < megapixels.size(); size_index++) {
+    //4:3 images of the requested size
+    synthetic_options.width = max(static_cast<int>(round(sqrt(megapixels[size_index] * 1000000 * 4 / 3))), 16);
+    synthetic_options.height = max(synthetic_options.width * 3 / 4, 12);
+    cout << "benchmark: " << synthetic_options.width << 'x' << synthetic_options.height << endl;
+  
+    Mat image, trimap, alpha_ground_truth;
+    chrono::steady_clock::time_point lap_start = chrono::steady_clock::now();
+    generateSyntheticMatting(synthetic_options, image, trimap, alpha_ground_truth);
+    const double GENERATION_SECONDS = calcLapSeconds(lap_start);
+  
+    ImageMask foreground_mask, background_mask;
+    calcTrimapMasks(trimap, foreground_mask, background_mask);
+    //no neighbor graph cache, so that calcNeighborsInfo is always measured
+    AlphaMattingCostFunctor cost_functor(image, foreground_mask, background_mask);
+    const double COST_FUNCTOR_SECONDS = calcLapSeconds(lap_start);
+    //the proposal generator seeds itself from rand()
+    srand(synthetic_options.seed);
+    AlphaMattingProposalGenerator proposal_generator(image, foreground_mask, background_mask);
+    proposal_generator.setNeighbors(cost_functor.getNeighborGraph());
+    const double PROPOSAL_GENERATOR_SECONDS = calcLapSeconds(lap_start);
+  
+    FusionSpaceSolver solver(cost_functor.getNumNodes(), cost_functor.getNodeGraph(), cost_functor, proposal_generator, 200);
+    solver.setTiling(num_tiles);
+    //a fixed number of fusions keeps runs comparable
+    ConvergencePolicy convergence_policy;
+    convergence_policy.patience = 0;
+    solver.setConvergencePolicy(convergence_policy);
+    StageTimingSink stage_timing_sink;
+    solver.setTelemetrySink(&stage_timing_sink);
+  
+    const vector<long> pixel_solution = calcBoundarySolution(foreground_mask, background_mask, image.cols, image.rows);
+    const vector<int> &node_pixels = cost_functor.getNodePixels();
+    vector<long> node_solution(node_pixels.size());
+    for (int node = 0; node < node_pixels.size(); node++)
+      node_solution[node] = pixel_solution[node_pixels[node]];
+    lap_start = chrono::steady_clock::now();
+    node_solution = solver.solve(num_fusions, node_solution);
+    const double SOLVE_SECONDS = calcLapSeconds(lap_start);
+  
+    double error = 0;
+    for (int node = 0; node < node_pixels.size(); node++)
+      error += pow(cost_functor.calcAlpha(node_pixels[node], node_solution[node]) - alpha_ground_truth.at<uchar>(node_pixels[node] / image.cols, node_pixels[node] % image.cols) / 255.0, 2);
+    const double RMSE = node_pixels.empty() ? 0 : sqrt(error / node_pixels.size());
+  
+    double alpha_image_seconds = 0, alpha_image_in_strips_seconds = 0;
+    if (run_alpha_image) {
+      lap_start = chrono::steady_clock::now();
+      calcAlphaImage(image, trimap);
+      alpha_image_seconds = calcLapSeconds(lap_start);
+      calcAlphaImageInStrips(image, trimap);
+      alpha_image_in_strips_seconds = calcLapSeconds(lap_start);
+    }
+  
+    const FusionTelemetry &totals = stage_timing_sink.getTotals();
+    if (size_index > 0)
+      json_str << ',';
+    json_str << "{\"width\":" << image.cols << ",\"height\":" << image.rows << ",\"megapixels\":" << 1e-6 * image.cols * image.rows;
+    json_str << ",\"band_width\":" << synthetic_options.band_width << ",\"texture\":" << synthetic_options.texture << ",\"colors\":" << synthetic_options.num_colors << ",\"seed\":" << synthetic_options.seed;
+    json_str << ",\"num_unknown_pixels\":" << node_pixels.size() << ",\"num_edges\":" << totals.num_edges << ",\"num_labels\":" << totals.num_labels;
+    json_str << ",\"num_fusions\":" << stage_timing_sink.getNumFusions() << ",\"stop_reason\":\"" << stage_timing_sink.getStopReason() << "\",\"rmse\":" << RMSE;
+    json_str << ",\"stages\":{\"generation\":" << GENERATION_SECONDS << ",\"calcNeighborsInfo\":" << cost_functor.getNeighborsInfoSeconds() << ",\"cost_functor\":" << COST_FUNCTOR_SECONDS;
+    json_str << ",\"calcRepresentativeLabels\":" << proposal_generator.getRepresentativeLabelsSeconds() << ",\"proposal_generator\":" << PROPOSAL_GENERATOR_SECONDS;
+    json_str << ",\"getProposal\":" << totals.proposal_seconds << ",\"fuse\":" << totals.unary_seconds + totals.pairwise_seconds + totals.optimization_seconds + totals.decode_seconds;
+    json_str << ",\"fuse_unary\":" << totals.unary_seconds << ",\"fuse_pairwise\":" << totals.pairwise_seconds << ",\"fuse_optimization\":" << totals.optimization_seconds << ",\"fuse_decode\":" << totals.decode_seconds;
+    json_str << ",\"solve\":" << SOLVE_SECONDS;
+    if (run_alpha_image)
+      json_str << ",\"calcAlphaImage\":" << alpha_image_seconds << ",\"calcAlphaImageInStrips\":" << alpha_image_in_strips_seconds;
+    json_str << "}}";
+  }
+  json_str << "]}";
+  
+  ofstream output_str(output_filename.c_str());
+  output_str << json_str.str() << endl;
+  cout << json_str.str() << endl;
+  return 0;
+}
@@ -0,0 +1,58 @@
+#include "SyntheticMatting.h"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "CounterRandom.h"
+#include "ParallelFor.h"
+
+
+using namespace std;
+using namespace cv;
+
+void generateSyntheticMatting(const SyntheticMattingOptions &options, Mat &image, Mat &trimap, Mat &alpha)
+{
+  const int IMAGE_WIDTH = options.width;
+  const int IMAGE_HEIGHT = options.height;
+  const int NUM_COLORS = max(options.num_colors, 1);
+  const int CELL_SIZE = max(min(IMAGE_WIDTH, IMAGE_HEIGHT) / 16, 4);
+  const double RADIUS = 0.3 * min(IMAGE_WIDTH, IMAGE_HEIGHT);
+  const double HALF_BAND_WIDTH = 0.5 * max(options.band_width, 1);
+  
+  //palette 0 is the foreground palette, palette 1 the background palette (stream 0 of the generator)
+  vector<Vec3b> palettes(2 * NUM_COLORS);
+  CounterRandom palette_random(options.seed, 0, 0);
+  for (int color_index = 0; color_index < 2 * NUM_COLORS; color_index++)
+    for (int c = 0; c < 3; c++)
+      palettes[color_index][c] = palette_random(256);
+  
+  image.create(IMAGE_HEIGHT, IMAGE_WIDTH, CV_8UC3);
+  trimap.create(IMAGE_HEIGHT, IMAGE_WIDTH, CV_8UC1);
+  alpha.create(IMAGE_HEIGHT, IMAGE_WIDTH, CV_8UC1);
+  parallelFor(0, IMAGE_HEIGHT, min(getNumThreads() * 4, max(IMAGE_HEIGHT, 1)), [&](const int, const int first_row, const int last_row) {
+      for (int y = first_row; y < last_row; y++) {
+	for (int x = 0; x < IMAGE_WIDTH; x++) {
+	  const int pixel = y * IMAGE_WIDTH + x;
+	  //signed distance to the blob boundary r(theta) = RADIUS * (1 + 0.15 sin(5 theta)), positive inside
+	  const double dx = x - 0.5 * IMAGE_WIDTH;
+	  const double dy = y - 0.5 * IMAGE_HEIGHT;
+	  const double distance = RADIUS * (1 + 0.15 * sin(5 * atan2(dy, dx))) - sqrt(dx * dx + dy * dy);
+	  const double pixel_alpha = max(min(0.5 + distance / HALF_BAND_WIDTH, 1.0), 0.0);
+  
+	  CounterRandom cell_random(options.seed, 1, (y / CELL_SIZE) * ((IMAGE_WIDTH + CELL_SIZE - 1) / CELL_SIZE) + x / CELL_SIZE);
+	  const Vec3b foreground_color = palettes[cell_random(NUM_COLORS)];
+	  const Vec3b background_color = palettes[NUM_COLORS + cell_random(NUM_COLORS)];
+	  CounterRandom pixel_random(options.seed, 2, pixel);
+	  Vec3b color;
+	  for (int c = 0; c < 3; c++) {
+	    const double noise = options.texture * (2.0 * pixel_random(1 << 16) / (1 << 16) - 1);
+	    color[c] = saturate_cast<uchar>(pixel_alpha * foreground_color[c] + (1 - pixel_alpha) * background_color[c] + noise);
+	  }
+	  image.at<Vec3b>(y, x) = color;
+	  alpha.at<uchar>(y, x) = saturate_cast<uchar>(pixel_alpha * 255);
+	  trimap.at<uchar>(y, x) = distance > HALF_BAND_WIDTH ? 255 : (distance < -HALF_BAND_WIDTH ? 0 : 128);
+	}
+      }
+    });
+}
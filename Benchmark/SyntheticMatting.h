@@ -0,0 +1,24 @@
+#ifndef SYNTHETIC_MATTING_H__
+#define SYNTHETIC_MATTING_H__
+
+#include <stdint.h>
+#include <opencv2/core/core.hpp>
+
+
+//Parameters of a synthetic matting problem: a wavy blob composited over a background. Foreground and background are tiled with cells of num_colors palette colors each and textured with noise of amplitude texture (in 8-bit color units). The true alpha ramps over half of the unknown band, whose width is band_width pixels.
+struct SyntheticMattingOptions
+{
+  int width;
+  int height;
+  int band_width;
+  double texture;
+  int num_colors;
+  uint64_t seed;
+  
+  SyntheticMattingOptions() : width(640), height(480), band_width(20), texture(10), num_colors(4), seed(0) {};
+};
+
+//image (CV_8UC3), trimap (CV_8UC1 with 255 / 128 / 0) and ground truth alpha (CV_8UC1); the output only depends on options
+void generateSyntheticMatting(const SyntheticMattingOptions &options, cv::Mat &image, cv::Mat &trimap, cv::Mat &alpha);
+
+#endif
@@ -0,0 +1,103 @@
+#include "BoxFilter.h"
+
+#include <algorithm>
+
+#include "ParallelFor.h"
+
+
+using namespace std;
+
+void calcBoxMeans(const vector<float> &values, const int NUM_CHANNELS, const int IMAGE_WIDTH, const int IMAGE_HEIGHT, const int RADIUS, vector<float> &means)
+{
+  const int ROW_SIZE = IMAGE_WIDTH * NUM_CHANNELS;
+  means.resize(static_cast<long>(IMAGE_HEIGHT) * ROW_SIZE);
+  //every band of rows starts its own column sums, which costs RADIUS extra rows per band
+  parallelFor(0, IMAGE_HEIGHT, min(getNumThreads() * 4, IMAGE_HEIGHT), [&](const int, const int first_row, const int last_row) {
+      vector<double> column_sums(ROW_SIZE, 0);
+      vector<double> window_sums(NUM_CHANNELS);
+      auto add_row = [&](const int y) {
+	const float *row_values = &values[static_cast<long>(y) * ROW_SIZE];
+	for (int index = 0; index < ROW_SIZE; index++)
+	  column_sums[index] += row_values[index];
+      };
+      auto subtract_row = [&](const int y) {
+	const float *row_values = &values[static_cast<long>(y) * ROW_SIZE];
+	for (int index = 0; index < ROW_SIZE; index++)
+	  column_sums[index] -= row_values[index];
+      };
+  
+      for (int y = max(first_row - RADIUS, 0); y < min(first_row + RADIUS, IMAGE_HEIGHT); y++)
+	add_row(y);
+      for (int y = first_row; y < last_row; y++) {
+	if (y + RADIUS < IMAGE_HEIGHT)
+	  add_row(y + RADIUS);
+	if (y > first_row && y - RADIUS - 1 >= 0)
+	  subtract_row(y - RADIUS - 1);
+	const int NUM_WINDOW_ROWS = min(y + RADIUS, IMAGE_HEIGHT - 1) - max(y - RADIUS, 0) + 1;
+  
+	fill(window_sums.begin(), window_sums.end(), 0);
+	for (int x = 0; x < min(RADIUS, IMAGE_WIDTH); x++)
+	  for (int c = 0; c < NUM_CHANNELS; c++)
+	    window_sums[c] += column_sums[x * NUM_CHANNELS + c];
+	float *row_means = &means[static_cast<long>(y) * ROW_SIZE];
+	for (int x = 0; x < IMAGE_WIDTH; x++) {
+	  if (x + RADIUS < IMAGE_WIDTH)
+	    for (int c = 0; c < NUM_CHANNELS; c++)
+	      window_sums[c] += column_sums[(x + RADIUS) * NUM_CHANNELS + c];
+	  if (x - RADIUS - 1 >= 0)
+	    for (int c = 0; c < NUM_CHANNELS; c++)
+	      window_sums[c] -= column_sums[(x - RADIUS - 1) * NUM_CHANNELS + c];
+	  const double AREA = NUM_WINDOW_ROWS * (min(x + RADIUS, IMAGE_WIDTH - 1) - max(x - RADIUS, 0) + 1);
+	  for (int c = 0; c < NUM_CHANNELS; c++)
+	    row_means[x * NUM_CHANNELS + c] = window_sums[c] / AREA;
+	}
+      }
+    });
+}
+
+void calcIntegralImage(const vector<float> &values, const int NUM_CHANNELS, const int IMAGE_WIDTH, const int IMAGE_HEIGHT, vector<double> &integral)
+{
+  const int ROW_SIZE = IMAGE_WIDTH * NUM_CHANNELS;
+  const int INTEGRAL_ROW_SIZE = (IMAGE_WIDTH + 1) * NUM_CHANNELS;
+  integral.assign(static_cast<long>(IMAGE_HEIGHT + 1) * INTEGRAL_ROW_SIZE, 0);
+  //row prefix sums, then column prefix sums over blocks of columns
+  parallelFor(0, IMAGE_HEIGHT, min(getNumThreads() * 4, IMAGE_HEIGHT), [&](const int, const int first_row, const int last_row) {
+      for (int y = first_row; y < last_row; y++) {
+	const float *row_values = &values[static_cast<long>(y) * ROW_SIZE];
+	double *integral_row = &integral[static_cast<long>(y + 1) * INTEGRAL_ROW_SIZE];
+	for (int index = 0; index < ROW_SIZE; index++)
+	  integral_row[NUM_CHANNELS + index] = integral_row[index] + row_values[index];
+      }
+    });
+  parallelFor(0, INTEGRAL_ROW_SIZE, min(getNumThreads() * 4, INTEGRAL_ROW_SIZE), [&](const int, const int first_index, const int last_index) {
+      for (int y = 1; y <= IMAGE_HEIGHT; y++) {
+	const double *previous_integral_row = &integral[static_cast<long>(y - 1) * INTEGRAL_ROW_SIZE];
+	double *integral_row = &integral[static_cast<long>(y) * INTEGRAL_ROW_SIZE];
+	for (int index = first_index; index < last_index; index++)
+	  integral_row[index] += previous_integral_row[index];
+      }
+    });
+}
+
+void calcIntegralBoxMeans(const vector<double> &integral, const int NUM_CHANNELS, const int IMAGE_WIDTH, const int IMAGE_HEIGHT, const int RADIUS, vector<float> &means)
+{
+  const int ROW_SIZE = IMAGE_WIDTH * NUM_CHANNELS;
+  const int INTEGRAL_ROW_SIZE = (IMAGE_WIDTH + 1) * NUM_CHANNELS;
+  means.resize(static_cast<long>(IMAGE_HEIGHT) * ROW_SIZE);
+  parallelFor(0, IMAGE_HEIGHT, min(getNumThreads() * 4, IMAGE_HEIGHT), [&](const int, const int first_row, const int last_row) {
+      for (int y = first_row; y < last_row; y++) {
+	const int MIN_Y = max(y - RADIUS, 0);
+	const int MAX_Y = min(y + RADIUS, IMAGE_HEIGHT - 1);
+	const double *top_row = &integral[static_cast<long>(MIN_Y) * INTEGRAL_ROW_SIZE];
+	const double *bottom_row = &integral[static_cast<long>(MAX_Y + 1) * INTEGRAL_ROW_SIZE];
+	float *row_means = &means[static_cast<long>(y) * ROW_SIZE];
+	for (int x = 0; x < IMAGE_WIDTH; x++) {
+	  const int MIN_X = max(x - RADIUS, 0);
+	  const int MAX_X = min(x + RADIUS, IMAGE_WIDTH - 1);
+	  const double AREA = (MAX_Y - MIN_Y + 1) * (MAX_X - MIN_X + 1);
+	  for (int c = 0; c < NUM_CHANNELS; c++)
+	    row_means[x * NUM_CHANNELS + c] = (bottom_row[(MAX_X + 1) * NUM_CHANNELS + c] - bottom_row[MIN_X * NUM_CHANNELS + c] - top_row[(MAX_X + 1) * NUM_CHANNELS + c] + top_row[MIN_X * NUM_CHANNELS + c]) / AREA;
+	}
+      }
+    });
+}
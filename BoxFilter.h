@@ -0,0 +1,16 @@
+#ifndef BOX_FILTER_H__
+#define BOX_FILTER_H__
+
+#include <vector>
+
+
+//Means of NUM_CHANNELS interleaved channels (values[pixel * NUM_CHANNELS + channel]) over (2 * RADIUS + 1)^2 windows clipped at the image border, i.e. divided by the number of pixels inside the image.
+//All channels go through one sweep of running column and row sums, so the cost per pixel does not depend on RADIUS. Sums are accumulated in double, since running sums drift in float; values and means are float.
+void calcBoxMeans(const std::vector<float> &values, const int NUM_CHANNELS, const int IMAGE_WIDTH, const int IMAGE_HEIGHT, const int RADIUS, std::vector<float> &means);
+
+//Summed-area table of interleaved channels with a leading zero row and column: integral[(y * (IMAGE_WIDTH + 1) + x) * NUM_CHANNELS + c] sums channel c over the pixels above and to the left of (x, y). Built once, it gives the means of calcBoxMeans for any number of radiuses at O(1) per pixel each.
+void calcIntegralImage(const std::vector<float> &values, const int NUM_CHANNELS, const int IMAGE_WIDTH, const int IMAGE_HEIGHT, std::vector<double> &integral);
+//the means of calcBoxMeans, read from an integral image of calcIntegralImage
+void calcIntegralBoxMeans(const std::vector<double> &integral, const int NUM_CHANNELS, const int IMAGE_WIDTH, const int IMAGE_HEIGHT, const int RADIUS, std::vector<float> &means);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef CONVERGENCE_POLICY_H__
+#define CONVERGENCE_POLICY_H__
+
+
+enum StopReason { NOT_STARTED, MAX_ITERATIONS_REACHED, NO_IMPROVEMENT, EMPTY_PROBLEM, DEADLINE_REACHED };
+
+inline const char *getStopReasonName(const StopReason stop_reason)
+{
+  switch (stop_reason) {
+  case NOT_STARTED:
+    return "not started";
+  case MAX_ITERATIONS_REACHED:
+    return "max iterations reached";
+  case NO_IMPROVEMENT:
+    return "no improvement";
+  case EMPTY_PROBLEM:
+    return "empty problem";
+  case DEADLINE_REACHED:
+    return "deadline reached";
+  }
+  return "unknown";
+}
+
+//When FusionSpaceSolver::solve and the TRW-S runs inside every fusion stop early.
+//A fusion counts as stalled if it is rejected or lowers the energy by less than relative_improvement_threshold * |energy|; solve stops after patience stalled fusions in a row (patience <= 0 never stops early).
+//TRW-S runs in chunks of trws_check_interval iterations and stops once energy - lower_bound <= trws_relative_gap * |energy| or the lower bound improves by less than trws_eps from one chunk to the next.
+//The defaults keep the fixed-iteration behavior: solve never stops early and TRW-S only stops at the former relative gap of 1e-6; set patience (e.g. 5) and a larger trws_relative_gap (e.g. 0.001) to trade energy for time.
+struct ConvergencePolicy
+{
+  double relative_improvement_threshold;
+  int patience;
+  double trws_relative_gap;
+  int trws_check_interval;
+  double trws_eps;
+
+  ConvergencePolicy() : relative_improvement_threshold(0.0001), patience(0), trws_relative_gap(0.000001), trws_check_interval(10), trws_eps(0.1) {};
+};
+
+#endif
@@ -1,6 +1,10 @@
 #ifndef COST_FUNCTOR_H__
 #define COST_FUNCTOR_H__
 
+#include <vector>
+
+#include "ProposalLabels.h"
+
 class CostFunctor
 {
  public:
@@ -9,6 +13,31 @@ class CostFunctor
   virtual void setCurrentSolution(const std::vector<long> &current_solution) {};
   virtual double getLabelCost() const { return 0; };
   virtual double getLabelIndicatorConflictCost() const { return 0; };
+  
+  //pairwise cost of the edge with the given index in the neighbor graph the solver iterates over
+  virtual double calcPairwiseCost(const int edge_index, const int node_index_1, const int node_index_2, const long label_1, const long label_2) const { return (*this)(node_index_1, node_index_2, label_1, label_2); };
+
+  //true if every pairwise cost equals getEdgeWeight(...) * |embedding_1 - embedding_2| with the scalar label embeddings from calcLabelEmbeddings
+  virtual bool hasFactorizedPairwiseCost() const { return false; };
+  virtual void calcLabelEmbeddings(const int node_index, const long *labels, const int NUM_LABELS, double *embeddings) const {};
+  virtual double getEdgeWeight(const int edge_index, const int node_index_1, const int node_index_2) const { return 0; };
+
+  //unary costs of all candidate labels of one node (costs[i] = (*this)(node_index, labels[i]))
+  virtual void calcUnaryCosts(const int node_index, const long *labels, const int NUM_LABELS, double *costs) const
+  {
+    for (int label_index = 0; label_index < NUM_LABELS; label_index++)
+      costs[label_index] = (*this)(node_index, labels[label_index]);
+  };
+  //unary costs of nodes [first_node_index, last_node_index), written consecutively to costs in node order
+  virtual void calcUnaryCosts(const int first_node_index, const int last_node_index, const ProposalLabels &node_labels, double *costs) const
+  {
+    for (int node_index = first_node_index; node_index < last_node_index; node_index++) {
+      const int NUM_LABELS = node_labels.getNumLabels(node_index);
+      if (NUM_LABELS > 0)
+	calcUnaryCosts(node_index, node_labels.getLabels(node_index), NUM_LABELS, costs);
+      costs += NUM_LABELS;
+    }
+  };
 };
 
 #endif
@@ -0,0 +1,63 @@
+#ifndef COUNTER_RANDOM_H__
+#define COUNTER_RANDOM_H__
+
+#include <stdint.h>
+
+
+//Counter-based random numbers (Philox4x32-10, Salmon et al. 2011). The stream is a pure function of (key, stream_index, substream_index), so every pixel can draw its own numbers on any thread and the results do not depend on the thread count or evaluation order.
+class CounterRandom
+{
+ public:
+  CounterRandom(const uint64_t key, const uint32_t stream_index, const uint32_t substream_index) : block_index_(0), num_remaining_values_(0)
+  {
+    key_[0] = static_cast<uint32_t>(key);
+    key_[1] = static_cast<uint32_t>(key >> 32);
+    counter_[0] = 0;
+    counter_[1] = 0;
+    counter_[2] = substream_index;
+    counter_[3] = stream_index;
+  };
+  
+  uint32_t operator()()
+  {
+    if (num_remaining_values_ == 0) {
+      counter_[0] = block_index_++;
+      generateBlock(counter_, key_, values_);
+      num_remaining_values_ = 4;
+    }
+    return values_[4 - num_remaining_values_--];
+  };
+  //integer in [0, n) (by modulo, like rand() % n)
+  int operator()(const int n) { return (*this)() % static_cast<uint32_t>(n); };
+  
+  //one Philox4x32-10 block: the 4 values of counter under key
+  static void generateBlock(const uint32_t counter[4], const uint32_t key_words[2], uint32_t values[4])
+  {
+    const uint32_t MULTIPLIER_0 = 0xD2511F53;
+    const uint32_t MULTIPLIER_1 = 0xCD9E8D57;
+    const uint32_t WEYL_0 = 0x9E3779B9;
+    const uint32_t WEYL_1 = 0xBB67AE85;
+    uint32_t x[4] = { counter[0], counter[1], counter[2], counter[3] };
+    uint32_t key[2] = { key_words[0], key_words[1] };
+    for (int round = 0; round < 10; round++) {
+      const uint64_t product_0 = static_cast<uint64_t>(MULTIPLIER_0) * x[0];
+      const uint64_t product_1 = static_cast<uint64_t>(MULTIPLIER_1) * x[2];
+      const uint32_t y[4] = { static_cast<uint32_t>(product_1 >> 32) ^ x[1] ^ key[0], static_cast<uint32_t>(product_1), static_cast<uint32_t>(product_0 >> 32) ^ x[3] ^ key[1], static_cast<uint32_t>(product_0) };
+      for (int c = 0; c < 4; c++)
+	x[c] = y[c];
+      key[0] += WEYL_0;
+      key[1] += WEYL_1;
+    }
+    for (int c = 0; c < 4; c++)
+      values[c] = x[c];
+  };
+  
+ private:
+  uint32_t key_[2];
+  uint32_t counter_[4];
+  uint32_t values_[4];
+  uint32_t block_index_;
+  int num_remaining_values_;
+};
+
+#endif
@@ -0,0 +1,131 @@
+#include "Diagnostics.h"
+
+#include <opencv2/highgui/highgui.hpp>
+#include <fstream>
+#include <utility>
+
+
+using namespace std;
+using namespace cv;
+
+void InMemoryDiagnosticsSink::writeImage(const string &name, const Mat &image)
+{
+  const Mat image_copy = image.clone();
+  lock_guard<mutex> lock(mutex_);
+  images_[name] = image_copy;
+}
+
+void InMemoryDiagnosticsSink::writeSolution(const string &name, const vector<long> &solution)
+{
+  lock_guard<mutex> lock(mutex_);
+  solutions_[name] = solution;
+}
+
+Mat InMemoryDiagnosticsSink::getImage(const string &name) const
+{
+  lock_guard<mutex> lock(mutex_);
+  map<string, Mat>::const_iterator image_it = images_.find(name);
+  return image_it != images_.end() ? image_it->second : Mat();
+}
+
+vector<long> InMemoryDiagnosticsSink::getSolution(const string &name) const
+{
+  lock_guard<mutex> lock(mutex_);
+  map<string, vector<long> >::const_iterator solution_it = solutions_.find(name);
+  return solution_it != solutions_.end() ? solution_it->second : vector<long>();
+}
+
+vector<string> InMemoryDiagnosticsSink::getNames() const
+{
+  lock_guard<mutex> lock(mutex_);
+  vector<string> names;
+  for (map<string, Mat>::const_iterator image_it = images_.begin(); image_it != images_.end(); image_it++)
+    names.push_back(image_it->first);
+  for (map<string, vector<long> >::const_iterator solution_it = solutions_.begin(); solution_it != solutions_.end(); solution_it++)
+    names.push_back(solution_it->first);
+  return names;
+}
+
+AsyncFileDiagnosticsSink::AsyncFileDiagnosticsSink(const string &directory, const DiagnosticsLevel level) : DiagnosticsSink(level), DIRECTORY_(directory), writing_(false), stopping_(false), num_failed_outputs_(0)
+{
+  writer_thread_ = thread(&AsyncFileDiagnosticsSink::writeOutputs, this);
+}
+
+AsyncFileDiagnosticsSink::~AsyncFileDiagnosticsSink()
+{
+  {
+    lock_guard<mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  queued_.notify_one();
+  writer_thread_.join();
+}
+
+void AsyncFileDiagnosticsSink::writeImage(const string &name, const Mat &image)
+{
+  Output output;
+  output.name = name;
+  output.image = image.clone();
+  enqueue(output);
+}
+
+void AsyncFileDiagnosticsSink::writeSolution(const string &name, const vector<long> &solution)
+{
+  Output output;
+  output.name = name;
+  output.solution = solution;
+  enqueue(output);
+}
+
+void AsyncFileDiagnosticsSink::flush()
+{
+  unique_lock<mutex> lock(mutex_);
+  written_.wait(lock, [&]() { return queue_.empty() && writing_ == false; });
+}
+
+int AsyncFileDiagnosticsSink::getNumFailedOutputs() const
+{
+  lock_guard<mutex> lock(mutex_);
+  return num_failed_outputs_;
+}
+
+void AsyncFileDiagnosticsSink::enqueue(Output &output)
+{
+  {
+    lock_guard<mutex> lock(mutex_);
+    queue_.push_back(move(output));
+  }
+  queued_.notify_one();
+}
+
+void AsyncFileDiagnosticsSink::writeOutputs()
+{
+  unique_lock<mutex> lock(mutex_);
+  while (true) {
+    queued_.wait(lock, [&]() { return queue_.empty() == false || stopping_; });
+    if (queue_.empty())
+      break;
+    Output output = move(queue_.front());
+    queue_.pop_front();
+    writing_ = true;
+    lock.unlock();
+  
+    const string filename = DIRECTORY_ + output.name;
+    bool succeeded = true;
+    if (output.image.empty() == false)
+      succeeded = imwrite(filename, output.image);
+    else {
+      ofstream out_str(filename.c_str());
+      for (int index = 0; index < output.solution.size(); index++)
+	out_str << output.solution[index] << '\n';
+      succeeded = out_str.good();
+    }
+  
+    lock.lock();
+    if (succeeded == false)
+      num_failed_outputs_++;
+    writing_ = false;
+    if (queue_.empty())
+      written_.notify_all();
+  }
+}
@@ -0,0 +1,103 @@
+#ifndef DIAGNOSTICS_H__
+#define DIAGNOSTICS_H__
+
+#include <vector>
+#include <string>
+#include <map>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <opencv2/core/core.hpp>
+
+
+//Detail of intermediate outputs: SUMMARY keeps one output per stage (e.g. clustered_image.bmp), ITERATIONS adds one per iteration or fusion (alpha_image_<iteration>.bmp, solution_<iteration>.txt), ALL adds the inner loops (alpha_image_<iteration>_<radius>.bmp).
+enum DiagnosticsLevel { DIAGNOSTICS_OFF, DIAGNOSTICS_SUMMARY, DIAGNOSTICS_ITERATIONS, DIAGNOSTICS_ALL };
+
+//Receives named intermediate images and solutions. Producers check isDiagnosticsEnabled before building an output, so a missing or disabled sink costs nothing. Sinks copy what they keep and may be called from any thread.
+class DiagnosticsSink
+{
+ public:
+  DiagnosticsSink(const DiagnosticsLevel level) : LEVEL_(level) {};
+  virtual ~DiagnosticsSink() {};
+  
+  bool isEnabled(const DiagnosticsLevel level) const { return level != DIAGNOSTICS_OFF && level <= LEVEL_; };
+  virtual void writeImage(const std::string &name, const cv::Mat &image) = 0;
+  virtual void writeSolution(const std::string &name, const std::vector<long> &solution) = 0;
+  //blocks until every output written so far is stored
+  virtual void flush() {};
+  
+ private:
+  const DiagnosticsLevel LEVEL_;
+};
+
+inline bool isDiagnosticsEnabled(const DiagnosticsSink *diagnostics_sink, const DiagnosticsLevel level)
+{
+  return diagnostics_sink != NULL && diagnostics_sink->isEnabled(level);
+}
+
+class DiscardDiagnosticsSink : public DiagnosticsSink
+{
+ public:
+  DiscardDiagnosticsSink() : DiagnosticsSink(DIAGNOSTICS_OFF) {};
+  
+  virtual void writeImage(const std::string &name, const cv::Mat &image) {};
+  virtual void writeSolution(const std::string &name, const std::vector<long> &solution) {};
+};
+
+//keeps the last output of every name, e.g. for tests or an embedding viewer
+class InMemoryDiagnosticsSink : public DiagnosticsSink
+{
+ public:
+  InMemoryDiagnosticsSink(const DiagnosticsLevel level = DIAGNOSTICS_ALL) : DiagnosticsSink(level) {};
+  
+  virtual void writeImage(const std::string &name, const cv::Mat &image);
+  virtual void writeSolution(const std::string &name, const std::vector<long> &solution);
+  
+  //an empty image or solution if nothing of that name was written
+  cv::Mat getImage(const std::string &name) const;
+  std::vector<long> getSolution(const std::string &name) const;
+  std::vector<std::string> getNames() const;
+  
+ private:
+  mutable std::mutex mutex_;
+  std::map<std::string, cv::Mat> images_;
+  std::map<std::string, std::vector<long> > solutions_;
+};
+
+//Encodes and writes outputs to directory + name on a background thread, so producers only pay for a copy. Images are written with imwrite (the extension of name picks the format), solutions as one label per line. The destructor writes everything still queued.
+class AsyncFileDiagnosticsSink : public DiagnosticsSink
+{
+ public:
+  AsyncFileDiagnosticsSink(const std::string &directory, const DiagnosticsLevel level = DIAGNOSTICS_ALL);
+  ~AsyncFileDiagnosticsSink();
+  
+  virtual void writeImage(const std::string &name, const cv::Mat &image);
+  virtual void writeSolution(const std::string &name, const std::vector<long> &solution);
+  virtual void flush();
+  //outputs which could not be written (e.g. because the directory is missing)
+  int getNumFailedOutputs() const;
+  
+ private:
+  struct Output
+  {
+    std::string name;
+    cv::Mat image;
+    std::vector<long> solution;
+  };
+  
+  const std::string DIRECTORY_;
+  mutable std::mutex mutex_;
+  std::condition_variable queued_;
+  std::condition_variable written_;
+  std::deque<Output> queue_;
+  bool writing_;
+  bool stopping_;
+  int num_failed_outputs_;
+  std::thread writer_thread_;
+  
+  void enqueue(Output &output);
+  void writeOutputs();
+};
+
+#endif
@@ -0,0 +1,295 @@
+#include "FactorizedTRWS.h"
+
+#include <limits>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+
+FactorizedTRWS::FactorizedTRWS() : num_nodes_(0), num_edges_(0), deadline_(chrono::steady_clock::time_point::max())
+{
+}
+
+void FactorizedTRWS::setEnergy(const int NUM_NODES, const int *label_offsets, const double *unary_costs, const double *embeddings, const int NUM_EDGES, const int *edge_nodes_1, const int *edge_nodes_2, const double *edge_weights)
+{
+  setGraph(NUM_NODES, NUM_EDGES, edge_nodes_1, edge_nodes_2, edge_weights);
+  setLabels(label_offsets, unary_costs, embeddings);
+}
+
+void FactorizedTRWS::setGraph(const int NUM_NODES, const int NUM_EDGES, const int *edge_nodes_1, const int *edge_nodes_2, const double *edge_weights)
+{
+  num_nodes_ = NUM_NODES;
+  num_edges_ = NUM_EDGES;
+  
+  edge_nodes_1_.assign(edge_nodes_1, edge_nodes_1 + NUM_EDGES);
+  edge_nodes_2_.assign(edge_nodes_2, edge_nodes_2 + NUM_EDGES);
+  edge_weights_.assign(edge_weights, edge_weights + NUM_EDGES);
+  
+  out_edge_offsets_.assign(NUM_NODES + 1, 0);
+  in_edge_offsets_.assign(NUM_NODES + 1, 0);
+  for (int edge = 0; edge < NUM_EDGES; edge++) {
+    out_edge_offsets_[edge_nodes_1_[edge] + 1]++;
+    in_edge_offsets_[edge_nodes_2_[edge] + 1]++;
+  }
+  for (int node = 0; node < NUM_NODES; node++) {
+    out_edge_offsets_[node + 1] += out_edge_offsets_[node];
+    in_edge_offsets_[node + 1] += in_edge_offsets_[node];
+  }
+  out_edges_.resize(NUM_EDGES);
+  in_edges_.resize(NUM_EDGES);
+  in_edge_positions_.resize(NUM_EDGES);
+  for (int edge = 0; edge < NUM_EDGES; edge++) {
+    out_edges_[out_edge_offsets_[edge_nodes_1_[edge]]++] = edge;
+    in_edge_positions_[edge] = in_edge_offsets_[edge_nodes_2_[edge]];
+    in_edges_[in_edge_offsets_[edge_nodes_2_[edge]]++] = edge;
+  }
+  for (int node = NUM_NODES; node > 0; node--) {
+    out_edge_offsets_[node] = out_edge_offsets_[node - 1];
+    in_edge_offsets_[node] = in_edge_offsets_[node - 1];
+  }
+  out_edge_offsets_[0] = 0;
+  in_edge_offsets_[0] = 0;
+  for (int edge = 0; edge < NUM_EDGES; edge++)
+    in_edge_positions_[edge] -= in_edge_offsets_[edge_nodes_2_[edge]];
+  
+  //every node is shared by max(#in-edges, #out-edges) monotonic chains
+  node_gammas_.resize(NUM_NODES);
+  for (int node = 0; node < NUM_NODES; node++)
+    node_gammas_[node] = 1.0 / max(max(out_edge_offsets_[node + 1] - out_edge_offsets_[node], in_edge_offsets_[node + 1] - in_edge_offsets_[node]), 1);
+  
+  solution_.assign(NUM_NODES, 0);
+  current_solution_.assign(NUM_NODES, 0);
+  message_offsets_.resize(NUM_EDGES + 1);
+}
+
+void FactorizedTRWS::setLabels(const int *label_offsets, const double *unary_costs, const double *embeddings)
+{
+  label_offsets_.assign(label_offsets, label_offsets + num_nodes_ + 1);
+  const int NUM_LABELS = label_offsets_[num_nodes_];
+  unary_costs_.assign(unary_costs, unary_costs + NUM_LABELS);
+  embeddings_.assign(embeddings, embeddings + NUM_LABELS);
+  sorted_labels_.resize(NUM_LABELS);
+  int max_num_labels = 1;
+  for (int node = 0; node < num_nodes_; node++) {
+    const int NUM_NODE_LABELS = label_offsets_[node + 1] - label_offsets_[node];
+    int *sorted_labels = &sorted_labels_[0] + label_offsets_[node];
+    const double *node_embeddings = &embeddings_[0] + label_offsets_[node];
+    for (int label = 0; label < NUM_NODE_LABELS; label++)
+      sorted_labels[label] = label;
+    sort(sorted_labels, sorted_labels + NUM_NODE_LABELS, [node_embeddings](const int label_1, const int label_2) { return node_embeddings[label_1] < node_embeddings[label_2]; });
+    max_num_labels = max(max_num_labels, NUM_NODE_LABELS);
+  }
+  
+  message_offsets_[0] = 0;
+  for (int edge = 0; edge < num_edges_; edge++)
+    message_offsets_[edge + 1] = message_offsets_[edge] + (label_offsets_[edge_nodes_1_[edge] + 1] - label_offsets_[edge_nodes_1_[edge]]) + (label_offsets_[edge_nodes_2_[edge] + 1] - label_offsets_[edge_nodes_2_[edge]]);
+  messages_.assign(message_offsets_[num_edges_], 0);
+  
+  node_buffer_.resize(max_num_labels);
+  source_buffer_.resize(max_num_labels);
+  chain_buffer_.resize(max_num_labels * 2);
+  belief_buffer_.resize(NUM_LABELS);
+}
+
+void FactorizedTRWS::minimize(const int MAX_NUM_ITERATIONS, const double EPS, double &lower_bound, double &energy, const double RELATIVE_GAP, const int BOUND_CHECK_INTERVAL)
+{
+  energy = numeric_limits<double>::max();
+  lower_bound = -numeric_limits<double>::max();
+  double previous_lower_bound = -numeric_limits<double>::max();
+  for (int iteration = 1; iteration <= max(MAX_NUM_ITERATIONS, 1); iteration++) {
+    if (MAX_NUM_ITERATIONS > 0) {
+      passMessages(true);
+      passMessages(false);
+    }
+    decodeSolution(current_solution_);
+    const double CURRENT_ENERGY = calcEnergy(current_solution_);
+    if (CURRENT_ENERGY < energy) {
+      energy = CURRENT_ENERGY;
+      solution_ = current_solution_;
+    }
+    if (chrono::steady_clock::now() >= deadline_)
+      break;
+    if (iteration % max(BOUND_CHECK_INTERVAL, 1) == 0 || iteration >= MAX_NUM_ITERATIONS) {
+      const double CURRENT_LOWER_BOUND = calcLowerBound();
+      lower_bound = max(lower_bound, CURRENT_LOWER_BOUND);
+      if (energy - lower_bound <= RELATIVE_GAP * max(fabs(energy), 1.0) || CURRENT_LOWER_BOUND - previous_lower_bound < EPS)
+	break;
+      previous_lower_bound = CURRENT_LOWER_BOUND;
+    }
+  }
+}
+
+double FactorizedTRWS::calcEnergy(const vector<int> &solution) const
+{
+  double energy = 0;
+  for (int node = 0; node < num_nodes_; node++)
+    energy += unary_costs_[label_offsets_[node] + solution[node]];
+  for (int edge = 0; edge < num_edges_; edge++)
+    energy += edge_weights_[edge] * fabs(embeddings_[label_offsets_[edge_nodes_1_[edge]] + solution[edge_nodes_1_[edge]]] - embeddings_[label_offsets_[edge_nodes_2_[edge]] + solution[edge_nodes_2_[edge]]]);
+  return energy;
+}
+
+long FactorizedTRWS::getBufferCapacity() const
+{
+  long capacity = 0;
+  capacity += (label_offsets_.capacity() + sorted_labels_.capacity() + edge_nodes_1_.capacity() + edge_nodes_2_.capacity() + message_offsets_.capacity()) * sizeof(int);
+  capacity += (out_edge_offsets_.capacity() + out_edges_.capacity() + in_edge_offsets_.capacity() + in_edges_.capacity() + in_edge_positions_.capacity()) * sizeof(int);
+  capacity += (solution_.capacity() + current_solution_.capacity()) * sizeof(int);
+  capacity += (unary_costs_.capacity() + embeddings_.capacity() + edge_weights_.capacity() + messages_.capacity() + node_gammas_.capacity()) * sizeof(double);
+  capacity += (node_buffer_.capacity() + source_buffer_.capacity() + chain_buffer_.capacity() + belief_buffer_.capacity()) * sizeof(double);
+  return capacity;
+}
+
+//belief of a node: unary costs plus the messages from all its neighbors
+void FactorizedTRWS::calcNodeBelief(const int node, double *belief) const
+{
+  const int NUM_LABELS = label_offsets_[node + 1] - label_offsets_[node];
+  const double *unary_costs = &unary_costs_[0] + label_offsets_[node];
+  for (int label = 0; label < NUM_LABELS; label++)
+    belief[label] = unary_costs[label];
+  for (int edge_index = out_edge_offsets_[node]; edge_index < out_edge_offsets_[node + 1]; edge_index++) {
+    const double *message = &messages_[0] + message_offsets_[out_edges_[edge_index]];
+    for (int label = 0; label < NUM_LABELS; label++)
+      belief[label] += message[label];
+  }
+  for (int edge_index = in_edge_offsets_[node]; edge_index < in_edge_offsets_[node + 1]; edge_index++) {
+    const int edge = in_edges_[edge_index];
+    const double *message = &messages_[0] + message_offsets_[edge] + (label_offsets_[edge_nodes_1_[edge] + 1] - label_offsets_[edge_nodes_1_[edge]]);
+    for (int label = 0; label < NUM_LABELS; label++)
+      belief[label] += message[label];
+  }
+}
+
+void FactorizedTRWS::passMessages(const bool forward)
+{
+  for (int node_index = 0; node_index < num_nodes_; node_index++) {
+    const int node = forward ? node_index : num_nodes_ - 1 - node_index;
+    const int NUM_LABELS = label_offsets_[node + 1] - label_offsets_[node];
+    calcNodeBelief(node, &node_buffer_[0]);
+    const double GAMMA = node_gammas_[node];
+    const int EDGE_BEGIN = forward ? out_edge_offsets_[node] : in_edge_offsets_[node];
+    const int EDGE_END = forward ? out_edge_offsets_[node + 1] : in_edge_offsets_[node + 1];
+    for (int edge_index = EDGE_BEGIN; edge_index < EDGE_END; edge_index++) {
+      const int edge = forward ? out_edges_[edge_index] : in_edges_[edge_index];
+      const int NUM_LABELS_1 = label_offsets_[edge_nodes_1_[edge] + 1] - label_offsets_[edge_nodes_1_[edge]];
+      double *message_to_1 = &messages_[0] + message_offsets_[edge];
+      double *message_to_2 = message_to_1 + NUM_LABELS_1;
+      const double *reverse_message = forward ? message_to_1 : message_to_2;
+      double *message = forward ? message_to_2 : message_to_1;
+      const int neighbor = forward ? edge_nodes_2_[edge] : edge_nodes_1_[edge];
+      
+      for (int label = 0; label < NUM_LABELS; label++)
+	source_buffer_[label] = GAMMA * node_buffer_[label] - reverse_message[label];
+      calcDistanceTransform(node, &source_buffer_[0], neighbor, edge_weights_[edge], message);
+      const int NUM_NEIGHBOR_LABELS = label_offsets_[neighbor + 1] - label_offsets_[neighbor];
+      const double MIN_MESSAGE = *min_element(message, message + NUM_NEIGHBOR_LABELS);
+      for (int label = 0; label < NUM_NEIGHBOR_LABELS; label++)
+	message[label] -= MIN_MESSAGE;
+    }
+  }
+}
+
+//labels are fixed in node order, each minimizing its unary cost, the pairwise costs to already fixed neighbors and the messages from the remaining ones
+void FactorizedTRWS::decodeSolution(vector<int> &solution)
+{
+  for (int node = 0; node < num_nodes_; node++) {
+    const int NUM_LABELS = label_offsets_[node + 1] - label_offsets_[node];
+    const double *embeddings = &embeddings_[0] + label_offsets_[node];
+    double *costs = &node_buffer_[0];
+    for (int label = 0; label < NUM_LABELS; label++)
+      costs[label] = unary_costs_[label_offsets_[node] + label];
+    for (int edge_index = out_edge_offsets_[node]; edge_index < out_edge_offsets_[node + 1]; edge_index++) {
+      const double *message = &messages_[0] + message_offsets_[out_edges_[edge_index]];
+      for (int label = 0; label < NUM_LABELS; label++)
+	costs[label] += message[label];
+    }
+    for (int edge_index = in_edge_offsets_[node]; edge_index < in_edge_offsets_[node + 1]; edge_index++) {
+      const int edge = in_edges_[edge_index];
+      const int neighbor = edge_nodes_1_[edge];
+      const double NEIGHBOR_EMBEDDING = embeddings_[label_offsets_[neighbor] + solution[neighbor]];
+      for (int label = 0; label < NUM_LABELS; label++)
+	costs[label] += edge_weights_[edge] * fabs(NEIGHBOR_EMBEDDING - embeddings[label]);
+    }
+    solution[node] = min_element(costs, costs + NUM_LABELS) - costs;
+  }
+}
+
+//Lower bound of the chain decomposition: at every node the i-th in-edge continues into the i-th out-edge, and every node contributes gamma times its belief to each chain through it
+double FactorizedTRWS::calcLowerBound()
+{
+  for (int node = 0; node < num_nodes_; node++)
+    calcNodeBelief(node, &belief_buffer_[0] + label_offsets_[node]);
+  
+  double lower_bound = 0;
+  for (int node = 0; node < num_nodes_; node++) {
+    const int NUM_LABELS = label_offsets_[node + 1] - label_offsets_[node];
+    const int NUM_IN_EDGES = in_edge_offsets_[node + 1] - in_edge_offsets_[node];
+    const int NUM_OUT_EDGES = out_edge_offsets_[node + 1] - out_edge_offsets_[node];
+    const double *belief = &belief_buffer_[0] + label_offsets_[node];
+    if (NUM_IN_EDGES == 0 && NUM_OUT_EDGES == 0) {
+      lower_bound += *min_element(belief, belief + NUM_LABELS);
+      continue;
+    }
+    //unpaired out-edges start new chains
+    for (int chain_index = NUM_IN_EDGES; chain_index < NUM_OUT_EDGES; chain_index++) {
+      double *chain_costs = &chain_buffer_[0];
+      double *next_chain_costs = &chain_buffer_[0] + chain_buffer_.size() / 2;
+      for (int label = 0; label < NUM_LABELS; label++)
+	chain_costs[label] = node_gammas_[node] * belief[label];
+      int chain_node = node;
+      int edge = out_edges_[out_edge_offsets_[node] + chain_index];
+      while (true) {
+	const int NUM_CHAIN_NODE_LABELS = label_offsets_[chain_node + 1] - label_offsets_[chain_node];
+	const double *message_to_1 = &messages_[0] + message_offsets_[edge];
+	const double *message_to_2 = message_to_1 + NUM_CHAIN_NODE_LABELS;
+	for (int label = 0; label < NUM_CHAIN_NODE_LABELS; label++)
+	  source_buffer_[label] = chain_costs[label] - message_to_1[label];
+	const int next_node = edge_nodes_2_[edge];
+	calcDistanceTransform(chain_node, &source_buffer_[0], next_node, edge_weights_[edge], next_chain_costs);
+	const int NUM_NEXT_NODE_LABELS = label_offsets_[next_node + 1] - label_offsets_[next_node];
+	const double *next_belief = &belief_buffer_[0] + label_offsets_[next_node];
+	for (int label = 0; label < NUM_NEXT_NODE_LABELS; label++)
+	  next_chain_costs[label] += node_gammas_[next_node] * next_belief[label] - message_to_2[label];
+	swap(chain_costs, next_chain_costs);
+	chain_node = next_node;
+	const int CHAIN_POSITION = in_edge_positions_[edge];
+	if (CHAIN_POSITION >= out_edge_offsets_[chain_node + 1] - out_edge_offsets_[chain_node])
+	  break;
+	edge = out_edges_[out_edge_offsets_[chain_node] + CHAIN_POSITION];
+      }
+      lower_bound += *min_element(chain_costs, chain_costs + label_offsets_[chain_node + 1] - label_offsets_[chain_node]);
+    }
+  }
+  return lower_bound;
+}
+
+//target_costs[t] = min_s source_costs[s] + weight * |embedding(s) - embedding(t)|, computed with one sweep in each direction over the labels of both nodes sorted by embedding
+void FactorizedTRWS::calcDistanceTransform(const int source_node, const double *source_costs, const int target_node, const double weight, double *target_costs) const
+{
+  const int NUM_SOURCE_LABELS = label_offsets_[source_node + 1] - label_offsets_[source_node];
+  const int NUM_TARGET_LABELS = label_offsets_[target_node + 1] - label_offsets_[target_node];
+  const int *source_sorted_labels = &sorted_labels_[0] + label_offsets_[source_node];
+  const int *target_sorted_labels = &sorted_labels_[0] + label_offsets_[target_node];
+  const double *source_embeddings = &embeddings_[0] + label_offsets_[source_node];
+  const double *target_embeddings = &embeddings_[0] + label_offsets_[target_node];
+  
+  double best_cost = numeric_limits<double>::infinity();
+  int source_index = 0;
+  for (int target_index = 0; target_index < NUM_TARGET_LABELS; target_index++) {
+    const int target_label = target_sorted_labels[target_index];
+    const double TARGET_EMBEDDING = target_embeddings[target_label];
+    for (; source_index < NUM_SOURCE_LABELS && source_embeddings[source_sorted_labels[source_index]] <= TARGET_EMBEDDING; source_index++)
+      best_cost = min(best_cost, source_costs[source_sorted_labels[source_index]] - weight * source_embeddings[source_sorted_labels[source_index]]);
+    target_costs[target_label] = best_cost + weight * TARGET_EMBEDDING;
+  }
+  best_cost = numeric_limits<double>::infinity();
+  source_index = NUM_SOURCE_LABELS - 1;
+  for (int target_index = NUM_TARGET_LABELS - 1; target_index >= 0; target_index--) {
+    const int target_label = target_sorted_labels[target_index];
+    const double TARGET_EMBEDDING = target_embeddings[target_label];
+    for (; source_index >= 0 && source_embeddings[source_sorted_labels[source_index]] >= TARGET_EMBEDDING; source_index--)
+      best_cost = min(best_cost, source_costs[source_sorted_labels[source_index]] + weight * source_embeddings[source_sorted_labels[source_index]]);
+    target_costs[target_label] = min(target_costs[target_label], best_cost - weight * TARGET_EMBEDDING);
+  }
+}
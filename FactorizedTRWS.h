@@ -0,0 +1,75 @@
+#ifndef FACTORIZED_TRWS_H__
+#define FACTORIZED_TRWS_H__
+
+#include <vector>
+#include <chrono>
+
+
+//Sequential tree-reweighted message passing (TRW-S, Kolmogorov 2006) for energies whose pairwise terms are weight * |embedding_1(label_1) - embedding_2(label_2)| with non-negative weights.
+//Every node stores its unary costs and one scalar embedding per label, every edge only its weight. Messages are computed with a 1D L1 distance transform over the labels sorted by embedding, in O(K_1 + K_2) per edge instead of O(K_1 * K_2).
+//The lower bound is the TRW-S bound of the monotonic chain decomposition implied by the node order.
+class FactorizedTRWS
+{
+ public:
+  FactorizedTRWS();
+
+  //label_offsets has NUM_NODES + 1 entries; the labels of node i are [label_offsets[i], label_offsets[i + 1]) in unary_costs and embeddings. Edges are (edge_nodes_1[e], edge_nodes_2[e]) with edge_nodes_1[e] < edge_nodes_2[e] and edge_weights[e] >= 0.
+  void setEnergy(const int NUM_NODES, const int *label_offsets, const double *unary_costs, const double *embeddings, const int NUM_EDGES, const int *edge_nodes_1, const int *edge_nodes_2, const double *edge_weights);
+  //setEnergy in two steps: the graph can be set once and kept while only the labels change (setLabels has to follow every setGraph)
+  void setGraph(const int NUM_NODES, const int NUM_EDGES, const int *edge_nodes_1, const int *edge_nodes_2, const double *edge_weights);
+  void setLabels(const int *label_offsets, const double *unary_costs, const double *embeddings);
+  //runs at most MAX_NUM_ITERATIONS forward-backward passes; the lower bound is checked every BOUND_CHECK_INTERVAL passes, and minimization stops once it improves by less than EPS between two checks or the gap to the energy drops to RELATIVE_GAP * |energy|. The best labeling found is kept.
+  void minimize(const int MAX_NUM_ITERATIONS, const double EPS, double &lower_bound, double &energy, const double RELATIVE_GAP = 0.000001, const int BOUND_CHECK_INTERVAL = 10);
+  //minimize returns after the first pass that ends past the deadline (no deadline by default)
+  void setDeadline(const std::chrono::steady_clock::time_point &deadline) { deadline_ = deadline; };
+
+  //label index (relative to the node's first label) of every node in the best labeling found
+  const std::vector<int> &getSolution() const { return solution_; };
+  int getNumEdges() const { return num_edges_; };
+  double calcEnergy(const std::vector<int> &solution) const;
+  double calcLowerBound();
+  //bytes reserved by all internal arrays; buffers are only ever grown, so this stays constant once the label counts stop growing
+  long getBufferCapacity() const;
+
+ private:
+  int num_nodes_;
+  int num_edges_;
+  std::chrono::steady_clock::time_point deadline_;
+
+  std::vector<int> label_offsets_;
+  std::vector<double> unary_costs_;
+  std::vector<double> embeddings_;
+  //label indices of every node sorted by embedding
+  std::vector<int> sorted_labels_;
+
+  std::vector<int> edge_nodes_1_;
+  std::vector<int> edge_nodes_2_;
+  std::vector<double> edge_weights_;
+  //messages of edge e: [message_offsets_[e], + K_1) holds the message from node 2 to node 1, the following K_2 entries the message from node 1 to node 2
+  std::vector<int> message_offsets_;
+  std::vector<double> messages_;
+
+  //edges to nodes with larger (out) and smaller (in) indices
+  std::vector<int> out_edge_offsets_;
+  std::vector<int> out_edges_;
+  std::vector<int> in_edge_offsets_;
+  std::vector<int> in_edges_;
+  //position of every edge in the in-edge list of its second node
+  std::vector<int> in_edge_positions_;
+  std::vector<double> node_gammas_;
+
+  std::vector<int> solution_;
+  std::vector<int> current_solution_;
+
+  std::vector<double> node_buffer_;
+  std::vector<double> source_buffer_;
+  std::vector<double> chain_buffer_;
+  std::vector<double> belief_buffer_;
+
+  void calcNodeBelief(const int node, double *belief) const;
+  void passMessages(const bool forward);
+  void decodeSolution(std::vector<int> &solution);
+  void calcDistanceTransform(const int source_node, const double *source_costs, const int target_node, const double weight, double *target_costs) const;
+};
+
+#endif
@@ -4,25 +4,38 @@
 #include <map>
 #include <limits>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
 
 #include "TRW_S/MRFEnergy.h"
+#include "FactorizedTRWS.h"
+#include "ParallelFor.h"
 
 using namespace std;
 
-FusionSpaceSolver::FusionSpaceSolver(const int NUM_NODES, const std::vector<std::vector<int> > &node_neighbors, CostFunctor &cost_functor, ProposalGenerator &proposal_generator, const int NUM_ITERATIONS, const bool CONSIDER_LABEL_COST) : NUM_NODES_(NUM_NODES), node_neighbors_(node_neighbors), cost_functor_(cost_functor), proposal_generator_(proposal_generator), NUM_ITERATIONS_(NUM_ITERATIONS), CONSIDER_LABEL_COST_(CONSIDER_LABEL_COST)
+FusionSpaceSolver::FusionSpaceSolver(const int NUM_NODES, const NeighborGraph &node_graph, CostFunctor &cost_functor, ProposalGenerator &proposal_generator, const int NUM_ITERATIONS, const bool CONSIDER_LABEL_COST, const FusionMethod FUSION_METHOD) : NUM_NODES_(NUM_NODES), node_graph_(node_graph), cost_functor_(cost_functor), proposal_generator_(proposal_generator), NUM_ITERATIONS_(NUM_ITERATIONS), CONSIDER_LABEL_COST_(CONSIDER_LABEL_COST), FUSION_METHOD_(FUSION_METHOD), factorized_graph_ready_(false), num_tiles_(1), num_halo_hops_(0), num_seam_hops_(0), stop_reason_(NOT_STARTED), num_fusions_(0), deadline_(chrono::steady_clock::time_point::max()), estimated_iteration_seconds_(0), telemetry_sink_(NULL), num_solves_(0), diagnostics_sink_(NULL), buffer_capacity_(0), num_buffer_growths_(0)
 {
+  if (FUSION_METHOD_ == GRAPH_CUT_FUSION && CONSIDER_LABEL_COST_)
+    throw invalid_argument("label costs are not supported by graph cut fusion");
 }
 
-vector<long> FusionSpaceSolver::fuse(const std::vector<std::vector<long> > &node_labels, std::vector<double> &energy_info)
+vector<long> FusionSpaceSolver::fuse(const ProposalLabels &node_labels, std::vector<double> &energy_info)
 {
-  cout << "fuse" << endl;
+  if (FUSION_METHOD_ == GRAPH_CUT_FUSION)
+    return fuseBinary(node_labels, energy_info);
+  if (num_tiles_ > 1)
+    return fuseTiled(node_labels, energy_info);
+  if (cost_functor_.hasFactorizedPairwiseCost() && CONSIDER_LABEL_COST_ == false)
+    return fuseFactorized(node_labels, energy_info);
   
   unique_ptr<MRFEnergy<TypeGeneral> > energy(new MRFEnergy<TypeGeneral>(TypeGeneral::GlobalSize()));
   map<int, int> label_indicator_index_map;
   if (CONSIDER_LABEL_COST_) {
     int label_indicator_index = NUM_NODES_;
-    for (vector<vector<long> >::const_iterator node_it = node_labels.begin(); node_it != node_labels.end(); node_it++)
-      for (vector<long>::const_iterator label_it = node_it->begin(); label_it != node_it->end(); label_it++)
+    for (int node_index = 0; node_index < NUM_NODES_; node_index++)
+      for (const long *label_it = node_labels.getLabels(node_index); label_it != node_labels.getLabels(node_index) + node_labels.getNumLabels(node_index); label_it++)
 	if (label_indicator_index_map.count(*label_it) == 0)
 	  label_indicator_index_map[*label_it] = label_indicator_index++;
   }
@@ -30,18 +43,17 @@ vector<long> FusionSpaceSolver::fuse(const std::vector<std::vector<long> > &node
   vector<MRFEnergy<TypeGeneral>::NodeId> nodes(NUM_NODES_ + NUM_LABEL_INDICATORS);
   
   //add unary cost
+  chrono::steady_clock::time_point lap_start = chrono::steady_clock::now();
+  checkProposalLabels(node_labels);
+  unary_costs_.resize(node_labels.getNumLabels());
+  cost_functor_.calcUnaryCosts(0, NUM_NODES_, node_labels, &unary_costs_[0]);
+  double *unary_cost = &unary_costs_[0];
   for (int node_index = 0; node_index < NUM_NODES_; node_index++) {
-    vector<long> labels = node_labels[node_index];
-    const int NUM_LABELS = labels.size();
-    if (NUM_LABELS == 0) {
-      cout << "empty proposal error: " << node_index << endl;
-      exit(1);
-    }
-    vector<double> unary_cost(NUM_LABELS);
-    for (int label_index = 0; label_index < NUM_LABELS; label_index++)
-      unary_cost[label_index] = cost_functor_(node_index, labels[label_index]);
-    nodes[node_index] = energy->AddNode(TypeGeneral::LocalSize(NUM_LABELS), TypeGeneral::NodeData(&unary_cost[0]));
+    const int NUM_LABELS = node_labels.getNumLabels(node_index);
+    nodes[node_index] = energy->AddNode(TypeGeneral::LocalSize(NUM_LABELS), TypeGeneral::NodeData(unary_cost));
+    unary_cost += NUM_LABELS;
   }
+  fusion_telemetry_.unary_seconds += calcLapSeconds(lap_start);
   
   //add label indicator cost
   if (CONSIDER_LABEL_COST_ == true) {
@@ -54,21 +66,28 @@ vector<long> FusionSpaceSolver::fuse(const std::vector<std::vector<long> > &node
   
   //add pairwise cost
   for (int node_index = 0; node_index < NUM_NODES_; node_index++) {
-    vector<long> labels = node_labels[node_index];
-    vector<int> neighbors = node_neighbors_[node_index];
-    for (vector<int>::const_iterator neighbor_it = neighbors.begin(); neighbor_it != neighbors.end(); neighbor_it++) {
-      vector<long> neighbor_labels = node_labels[*neighbor_it];
-      vector<double> pairwise_cost(labels.size() * neighbor_labels.size(), 0);
-      for (int label_index = 0; label_index < labels.size(); label_index++)
-        for (int neighbor_label_index = 0; neighbor_label_index < neighbor_labels.size(); neighbor_label_index++)
-          pairwise_cost[label_index + neighbor_label_index * labels.size()] = cost_functor_(node_index, *neighbor_it, labels[label_index], neighbor_labels[neighbor_label_index]);
+    const long *labels = node_labels.getLabels(node_index);
+    const int NUM_LABELS = node_labels.getNumLabels(node_index);
+    for (int edge_index = node_graph_.getEdgeBegin(node_index); edge_index < node_graph_.getEdgeEnd(node_index); edge_index++) {
+      const int neighbor = node_graph_.getNeighbor(edge_index);
+      const long *neighbor_labels = node_labels.getLabels(neighbor);
+      const int NUM_NEIGHBOR_LABELS = node_labels.getNumLabels(neighbor);
+      //the table is copied by AddEdge, so one buffer serves all edges
+      const int NUM_PAIRWISE_COSTS = NUM_LABELS * NUM_NEIGHBOR_LABELS;
+      if (pairwise_costs_.size() < NUM_PAIRWISE_COSTS)
+	pairwise_costs_.resize(NUM_PAIRWISE_COSTS);
+      double *pairwise_cost = &pairwise_costs_[0];
+      for (int label_index = 0; label_index < NUM_LABELS; label_index++)
+        for (int neighbor_label_index = 0; neighbor_label_index < NUM_NEIGHBOR_LABELS; neighbor_label_index++)
+          pairwise_cost[label_index + neighbor_label_index * NUM_LABELS] = cost_functor_.calcPairwiseCost(edge_index, node_index, neighbor, labels[label_index], neighbor_labels[neighbor_label_index]);
       bool has_non_zero_cost = false;
-      for (int i = 0; i < pairwise_cost.size(); i++)
+      for (int i = 0; i < NUM_PAIRWISE_COSTS; i++)
         if (pairwise_cost[i] > 0)
           has_non_zero_cost = true;
       if (has_non_zero_cost == true) {
-	//cout << node_index << *neighbor_it << endl;
-        energy->AddEdge(nodes[node_index], nodes[*neighbor_it], TypeGeneral::EdgeData(TypeGeneral::GENERAL, &pairwise_cost[0]));
+	//cout << node_index << neighbor << endl;
+        energy->AddEdge(nodes[node_index], nodes[neighbor], TypeGeneral::EdgeData(TypeGeneral::GENERAL, pairwise_cost));
+	fusion_telemetry_.num_edges++;
       }
     }
   }
@@ -77,11 +96,11 @@ vector<long> FusionSpaceSolver::fuse(const std::vector<std::vector<long> > &node
   //add label indicator constraints
   if (CONSIDER_LABEL_COST_) {
     for (int node_index = 0; node_index < NUM_NODES_; node_index++) {
-      vector<long> labels = node_labels[node_index];
-      for (int label_index = 0; label_index < labels.size(); label_index++) {
-	long label = labels[label_index];
+      const int NUM_LABELS = node_labels.getNumLabels(node_index);
+      for (int label_index = 0; label_index < NUM_LABELS; label_index++) {
+	long label = node_labels.getLabel(node_index, label_index);
 	int label_indicator_index = label_indicator_index_map[label];
-	vector<double> label_indicator_conflict_cost(labels.size() * 2, 0);
+	vector<double> label_indicator_conflict_cost(NUM_LABELS * 2, 0);
 	label_indicator_conflict_cost[label_index] = cost_functor_.getLabelIndicatorConflictCost();
 	
 	energy->AddEdge(nodes[node_index], nodes[label_indicator_index + NUM_NODES_], TypeGeneral::EdgeData(TypeGeneral::GENERAL, &label_indicator_conflict_cost[0]));
@@ -89,45 +108,548 @@ vector<long> FusionSpaceSolver::fuse(const std::vector<std::vector<long> > &node
     }
   }
   
+  fusion_telemetry_.pairwise_seconds += calcLapSeconds(lap_start);
+  
+  //TRW-S runs in chunks (messages are kept between calls) so that it can stop once the duality gap is small enough
+  const int CHECK_INTERVAL = max(convergence_policy_.trws_check_interval, 1);
+  //TRW-S only evaluates bounds at the last iteration of a chunk and never prints; its own eps check never runs within a chunk, so the lower bounds of consecutive chunks are compared here
   MRFEnergy<TypeGeneral>::Options options;
-  options.m_iterMax = NUM_ITERATIONS_;
-  options.m_printIter = NUM_ITERATIONS_ / 5;
-  options.m_printMinIter = 0;
-  options.m_eps = 0.1;
+  options.m_printIter = numeric_limits<int>::max();
+  options.m_printMinIter = numeric_limits<int>::max();
+  options.m_eps = convergence_policy_.trws_eps;
   
   double lower_bound, solution_energy;
-  energy->Minimize_TRW_S(options, lower_bound, solution_energy);
+  double previous_lower_bound = -numeric_limits<double>::max();
+  for (int num_trws_iterations = 0; num_trws_iterations < NUM_ITERATIONS_; num_trws_iterations += CHECK_INTERVAL) {
+    options.m_iterMax = min(CHECK_INTERVAL, NUM_ITERATIONS_ - num_trws_iterations);
+    const int NUM_CHUNK_ITERATIONS = energy->Minimize_TRW_S(options, lower_bound, solution_energy);
+    if (NUM_CHUNK_ITERATIONS < options.m_iterMax || isDeadlineReached() || solution_energy - lower_bound <= convergence_policy_.trws_relative_gap * max(fabs(solution_energy), 1.0) || lower_bound - previous_lower_bound < convergence_policy_.trws_eps)
+      break;
+    previous_lower_bound = lower_bound;
+  }
+  fusion_telemetry_.optimization_seconds += calcLapSeconds(lap_start);
   
   vector<long> fused_labels(NUM_NODES_);
   for (int node_index = 0; node_index < NUM_NODES_; node_index++) {
     long label = energy->GetSolution(nodes[node_index]);
-    fused_labels[node_index] = node_labels[node_index][label];
+    fused_labels[node_index] = node_labels.getLabel(node_index, label);
   }
+  fusion_telemetry_.decode_seconds += calcLapSeconds(lap_start);
   energy_info.assign(2, 0);
   energy_info[0] = solution_energy;
   energy_info[1] = lower_bound;
+  updateBufferCapacity();
+  return fused_labels;
+}
+
+vector<long> FusionSpaceSolver::fuseFactorized(const ProposalLabels &node_labels, std::vector<double> &energy_info)
+{
+  //edge weights do not depend on labels, so the graph is only built once; edges without positive cost are skipped as in fuse
+  chrono::steady_clock::time_point lap_start = chrono::steady_clock::now();
+  if (factorized_graph_ready_ == false) {
+    vector<int> edge_nodes_1, edge_nodes_2;
+    vector<double> edge_weights;
+    for (int node_index = 0; node_index < NUM_NODES_; node_index++) {
+      for (int edge_index = node_graph_.getEdgeBegin(node_index); edge_index < node_graph_.getEdgeEnd(node_index); edge_index++) {
+	const int neighbor = node_graph_.getNeighbor(edge_index);
+	const double weight = cost_functor_.getEdgeWeight(edge_index, node_index, neighbor);
+	if (weight <= 0)
+	  continue;
+	edge_nodes_1.push_back(min(node_index, neighbor));
+	edge_nodes_2.push_back(max(node_index, neighbor));
+	edge_weights.push_back(weight);
+      }
+    }
+    factorized_trws_.setGraph(NUM_NODES_, edge_weights.size(), edge_nodes_1.data(), edge_nodes_2.data(), edge_weights.data());
+    factorized_graph_ready_ = true;
+  }
+  fusion_telemetry_.pairwise_seconds += calcLapSeconds(lap_start);
+  fusion_telemetry_.num_edges = factorized_trws_.getNumEdges();
+  
+  checkProposalLabels(node_labels);
+  unary_costs_.resize(node_labels.getNumLabels());
+  cost_functor_.calcUnaryCosts(0, NUM_NODES_, node_labels, &unary_costs_[0]);
+  label_embeddings_.resize(node_labels.getNumLabels());
+  for (int node_index = 0; node_index < NUM_NODES_; node_index++)
+    cost_functor_.calcLabelEmbeddings(node_index, node_labels.getLabels(node_index), node_labels.getNumLabels(node_index), &label_embeddings_[node_labels.getLabelBegin(node_index)]);
+  
+  fusion_telemetry_.unary_seconds += calcLapSeconds(lap_start);
+  
+  factorized_trws_.setLabels(node_labels.getOffsets(), &unary_costs_[0], &label_embeddings_[0]);
+  factorized_trws_.setDeadline(deadline_);
+  double lower_bound, solution_energy;
+  factorized_trws_.minimize(NUM_ITERATIONS_, convergence_policy_.trws_eps, lower_bound, solution_energy, convergence_policy_.trws_relative_gap, convergence_policy_.trws_check_interval);
+  fusion_telemetry_.optimization_seconds += calcLapSeconds(lap_start);
+  
+  const vector<int> &solution = factorized_trws_.getSolution();
+  vector<long> fused_labels(NUM_NODES_);
+  for (int node_index = 0; node_index < NUM_NODES_; node_index++)
+    fused_labels[node_index] = node_labels.getLabel(node_index, solution[node_index]);
+  fusion_telemetry_.decode_seconds += calcLapSeconds(lap_start);
+  energy_info.assign(2, 0);
+  energy_info[0] = solution_energy;
+  energy_info[1] = lower_bound;
+  updateBufferCapacity();
+  return fused_labels;
+}
+
+void FusionSpaceSolver::setTiling(const int NUM_TILES, const int NUM_HALO_HOPS, const int NUM_SEAM_HOPS)
+{
+  if (NUM_TILES > 1 && (cost_functor_.hasFactorizedPairwiseCost() == false || CONSIDER_LABEL_COST_ || FUSION_METHOD_ != TRW_S_FUSION))
+    throw invalid_argument("tiled fusion needs factorized pairwise costs and TRW-S fusion without label costs");
+  num_tiles_ = max(min(NUM_TILES, NUM_NODES_), 1);
+  num_halo_hops_ = NUM_HALO_HOPS;
+  num_seam_hops_ = NUM_SEAM_HOPS;
+  tile_subsets_.clear();
+}
+
+vector<long> FusionSpaceSolver::fuseTiled(const ProposalLabels &node_labels, std::vector<double> &energy_info)
+{
+  chrono::steady_clock::time_point lap_start = chrono::steady_clock::now();
+  checkProposalLabels(node_labels);
+  calcUnaryCostsAndEmbeddings(node_labels);
+  fusion_telemetry_.unary_seconds += calcLapSeconds(lap_start);
+  if (tile_subsets_.empty())
+    calcTiles();
+  fusion_telemetry_.pairwise_seconds += calcLapSeconds(lap_start);
+  fusion_telemetry_.num_edges = node_adjacency_.size() / 2;
+  
+  fixed_embeddings_.resize(NUM_NODES_);
+  for (int node_index = 0; node_index < NUM_NODES_; node_index++) {
+    if (current_solution_.size() == NUM_NODES_)
+      cost_functor_.calcLabelEmbeddings(node_index, &current_solution_[node_index], 1, &fixed_embeddings_[node_index]);
+    else
+      fixed_embeddings_[node_index] = label_embeddings_[node_labels.getLabelBegin(node_index)];
+  }
+  
+  //tile t owns the nodes [NUM_NODES * t / NUM_TILES, NUM_NODES * (t + 1) / NUM_TILES), the same ranges parallelFor hands out
+  tiled_label_indices_.assign(NUM_NODES_, 0);
+  parallelFor(0, NUM_NODES_, num_tiles_, [&](const int tile_index, const int first_node, const int last_node) {
+      NodeSubset &tile = tile_subsets_[tile_index];
+      fuseSubset(node_labels, fixed_embeddings_, tile);
+      const vector<int> &tile_nodes = tile.nodes;
+      const vector<int> &tile_label_indices = tile.trws.getSolution();
+      for (int tile_node_index = 0; tile_node_index < tile_nodes.size(); tile_node_index++)
+	if (tile_nodes[tile_node_index] >= first_node && tile_nodes[tile_node_index] < last_node)
+	  tiled_label_indices_[tile_nodes[tile_node_index]] = tile_label_indices[tile_node_index];
+    });
+  double energy = calcEnergy(node_labels, tiled_label_indices_);
+  
+  //seams are fused again given the tile results, and kept if that lowers the energy
+  const vector<int> &seam_nodes = seam_subset_.nodes;
+  if (seam_nodes.empty() == false && isDeadlineReached() == false) {
+    for (int node_index = 0; node_index < NUM_NODES_; node_index++)
+      fixed_embeddings_[node_index] = label_embeddings_[node_labels.getLabelBegin(node_index) + tiled_label_indices_[node_index]];
+    fuseSubset(node_labels, fixed_embeddings_, seam_subset_);
+    const vector<int> &seam_label_indices = seam_subset_.trws.getSolution();
+    seam_fused_label_indices_ = tiled_label_indices_;
+    for (int seam_node_index = 0; seam_node_index < seam_nodes.size(); seam_node_index++)
+      seam_fused_label_indices_[seam_nodes[seam_node_index]] = seam_label_indices[seam_node_index];
+    const double seam_fused_energy = calcEnergy(node_labels, seam_fused_label_indices_);
+    if (seam_fused_energy < energy) {
+      energy = seam_fused_energy;
+      tiled_label_indices_.swap(seam_fused_label_indices_);
+    }
+  }
+  //tile and seam energies are assembled inside the worker threads and counted as optimization time
+  fusion_telemetry_.optimization_seconds += calcLapSeconds(lap_start);
+  
+  vector<long> fused_labels(NUM_NODES_);
+  for (int node_index = 0; node_index < NUM_NODES_; node_index++)
+    fused_labels[node_index] = node_labels.getLabel(node_index, tiled_label_indices_[node_index]);
+  fusion_telemetry_.decode_seconds += calcLapSeconds(lap_start);
+  energy_info.assign(2, energy);
+  energy_info[1] = -numeric_limits<double>::max();
+  updateBufferCapacity();
+  return fused_labels;
+}
+
+void FusionSpaceSolver::fuseSubset(const ProposalLabels &node_labels, const std::vector<double> &fixed_embeddings, NodeSubset &subset) const
+{
+  const vector<int> &subset_nodes = subset.nodes;
+  const int NUM_SUBSET_NODES = subset_nodes.size();
+  subset.label_offsets.resize(NUM_SUBSET_NODES + 1);
+  subset.label_offsets[0] = 0;
+  for (int subset_node_index = 0; subset_node_index < NUM_SUBSET_NODES; subset_node_index++)
+    subset.label_offsets[subset_node_index + 1] = subset.label_offsets[subset_node_index] + node_labels.getNumLabels(subset_nodes[subset_node_index]);
+  subset.unary_costs.resize(subset.label_offsets[NUM_SUBSET_NODES]);
+  subset.embeddings.resize(subset.label_offsets[NUM_SUBSET_NODES]);
+  for (int subset_node_index = 0; subset_node_index < NUM_SUBSET_NODES; subset_node_index++) {
+    const int node_index = subset_nodes[subset_node_index];
+    const int NUM_LABELS = node_labels.getNumLabels(node_index);
+    double *node_unary_costs = &subset.unary_costs[subset.label_offsets[subset_node_index]];
+    double *node_embeddings = &subset.embeddings[subset.label_offsets[subset_node_index]];
+    copy(unary_costs_.begin() + node_labels.getLabelBegin(node_index), unary_costs_.begin() + node_labels.getLabelEnd(node_index), node_unary_costs);
+    copy(label_embeddings_.begin() + node_labels.getLabelBegin(node_index), label_embeddings_.begin() + node_labels.getLabelEnd(node_index), node_embeddings);
+    
+    //edges leaving the subset become unary costs towards the fixed label
+    for (int boundary_index = subset.boundary_offsets[subset_node_index]; boundary_index < subset.boundary_offsets[subset_node_index + 1]; boundary_index++)
+      for (int label_index = 0; label_index < NUM_LABELS; label_index++)
+	node_unary_costs[label_index] += subset.boundary_weights[boundary_index] * fabs(node_embeddings[label_index] - fixed_embeddings[subset.boundary_neighbors[boundary_index]]);
+  }
+  
+  subset.trws.setDeadline(deadline_);
+  subset.trws.setLabels(&subset.label_offsets[0], subset.unary_costs.data(), subset.embeddings.data());
+  double lower_bound, energy;
+  subset.trws.minimize(NUM_ITERATIONS_, convergence_policy_.trws_eps, lower_bound, energy, convergence_policy_.trws_relative_gap, convergence_policy_.trws_check_interval);
+}
+
+//edges between subset nodes go to the TRW-S graph of the subset and edges leaving it to its boundary lists; edges without positive weight are dropped
+void FusionSpaceSolver::buildSubset(NodeSubset &subset) const
+{
+  const vector<int> &subset_nodes = subset.nodes;
+  const int NUM_SUBSET_NODES = subset_nodes.size();
+  vector<int> edge_nodes_1, edge_nodes_2;
+  vector<double> edge_weights;
+  subset.boundary_offsets.assign(1, 0);
+  subset.boundary_neighbors.clear();
+  subset.boundary_weights.clear();
+  for (int subset_node_index = 0; subset_node_index < NUM_SUBSET_NODES; subset_node_index++) {
+    const int node_index = subset_nodes[subset_node_index];
+    for (int adjacency_index = node_adjacency_offsets_[node_index]; adjacency_index < node_adjacency_offsets_[node_index + 1]; adjacency_index++) {
+      const int neighbor = node_adjacency_[adjacency_index];
+      const double weight = cost_functor_.getEdgeWeight(node_adjacency_edges_[adjacency_index], min(node_index, neighbor), max(node_index, neighbor));
+      if (weight <= 0)
+	continue;
+      vector<int>::const_iterator neighbor_it = lower_bound(subset_nodes.begin(), subset_nodes.end(), neighbor);
+      if (neighbor_it != subset_nodes.end() && *neighbor_it == neighbor) {
+	if (neighbor > node_index) {
+	  edge_nodes_1.push_back(subset_node_index);
+	  edge_nodes_2.push_back(neighbor_it - subset_nodes.begin());
+	  edge_weights.push_back(weight);
+	}
+      } else {
+	subset.boundary_neighbors.push_back(neighbor);
+	subset.boundary_weights.push_back(weight);
+      }
+    }
+    subset.boundary_offsets.push_back(subset.boundary_neighbors.size());
+  }
+  subset.trws.setGraph(NUM_SUBSET_NODES, edge_weights.size(), edge_nodes_1.data(), edge_nodes_2.data(), edge_weights.data());
+}
+
+//both directions of every node graph edge
+void FusionSpaceSolver::calcNodeAdjacency()
+{
+  node_adjacency_offsets_.assign(NUM_NODES_ + 1, 0);
+  for (int node_index = 0; node_index < NUM_NODES_; node_index++) {
+    for (int edge_index = node_graph_.getEdgeBegin(node_index); edge_index < node_graph_.getEdgeEnd(node_index); edge_index++) {
+      node_adjacency_offsets_[node_index + 1]++;
+      node_adjacency_offsets_[node_graph_.getNeighbor(edge_index) + 1]++;
+    }
+  }
+  for (int node_index = 0; node_index < NUM_NODES_; node_index++)
+    node_adjacency_offsets_[node_index + 1] += node_adjacency_offsets_[node_index];
+  node_adjacency_.resize(node_adjacency_offsets_[NUM_NODES_]);
+  node_adjacency_edges_.resize(node_adjacency_offsets_[NUM_NODES_]);
+  vector<int> adjacency_positions(node_adjacency_offsets_.begin(), node_adjacency_offsets_.end() - 1);
+  for (int node_index = 0; node_index < NUM_NODES_; node_index++) {
+    for (int edge_index = node_graph_.getEdgeBegin(node_index); edge_index < node_graph_.getEdgeEnd(node_index); edge_index++) {
+      const int neighbor = node_graph_.getNeighbor(edge_index);
+      node_adjacency_[adjacency_positions[node_index]] = neighbor;
+      node_adjacency_edges_[adjacency_positions[node_index]++] = edge_index;
+      node_adjacency_[adjacency_positions[neighbor]] = node_index;
+      node_adjacency_edges_[adjacency_positions[neighbor]++] = edge_index;
+    }
+  }
+}
+
+//node ranges of the tiles grown by the halo hops, and the seam band around the range borders
+void FusionSpaceSolver::calcTiles()
+{
+  calcNodeAdjacency();
+  
+  vector<int> node_marks(NUM_NODES_, -1);
+  tile_subsets_.assign(num_tiles_, NodeSubset());
+  for (int tile_index = 0; tile_index < num_tiles_; tile_index++) {
+    vector<int> &tile_nodes = tile_subsets_[tile_index].nodes;
+    for (int node_index = static_cast<long>(NUM_NODES_) * tile_index / num_tiles_; node_index < static_cast<long>(NUM_NODES_) * (tile_index + 1) / num_tiles_; node_index++)
+      tile_nodes.push_back(node_index);
+    expandNodes(tile_nodes, num_halo_hops_, node_marks, tile_index);
+  }
+  
+  vector<int> &seam_nodes = seam_subset_.nodes;
+  seam_nodes.clear();
+  fill(node_marks.begin(), node_marks.end(), -1);
+  for (int tile_index = 0; tile_index < num_tiles_; tile_index++) {
+    const int FIRST_NODE = static_cast<long>(NUM_NODES_) * tile_index / num_tiles_;
+    const int LAST_NODE = static_cast<long>(NUM_NODES_) * (tile_index + 1) / num_tiles_;
+    for (int node_index = FIRST_NODE; node_index < LAST_NODE; node_index++) {
+      for (int adjacency_index = node_adjacency_offsets_[node_index]; adjacency_index < node_adjacency_offsets_[node_index + 1]; adjacency_index++) {
+	if (node_adjacency_[adjacency_index] < FIRST_NODE || node_adjacency_[adjacency_index] >= LAST_NODE) {
+	  seam_nodes.push_back(node_index);
+	  break;
+	}
+      }
+    }
+  }
+  if (seam_nodes.empty() == false)
+    expandNodes(seam_nodes, max(num_seam_hops_ - 1, 0), node_marks, 0);
+  
+  parallelFor(0, num_tiles_, num_tiles_, [&](const int, const int first_tile, const int last_tile) {
+      for (int tile_index = first_tile; tile_index < last_tile; tile_index++)
+	buildSubset(tile_subsets_[tile_index]);
+    });
+  buildSubset(seam_subset_);
+}
+
+//adds all nodes within NUM_HOPS hops of nodes and sorts them; node_marks[node] == mark flags nodes already included
+void FusionSpaceSolver::expandNodes(std::vector<int> &nodes, const int NUM_HOPS, std::vector<int> &node_marks, const int mark) const
+{
+  for (vector<int>::const_iterator node_it = nodes.begin(); node_it != nodes.end(); node_it++)
+    node_marks[*node_it] = mark;
+  int frontier_begin = 0;
+  for (int hop = 0; hop < NUM_HOPS; hop++) {
+    const int FRONTIER_END = nodes.size();
+    for (int node_index = frontier_begin; node_index < FRONTIER_END; node_index++) {
+      for (int adjacency_index = node_adjacency_offsets_[nodes[node_index]]; adjacency_index < node_adjacency_offsets_[nodes[node_index] + 1]; adjacency_index++) {
+	const int neighbor = node_adjacency_[adjacency_index];
+	if (node_marks[neighbor] == mark)
+	  continue;
+	node_marks[neighbor] = mark;
+	nodes.push_back(neighbor);
+      }
+    }
+    frontier_begin = FRONTIER_END;
+  }
+  sort(nodes.begin(), nodes.end());
+}
+
+//unary costs and label embeddings of all nodes, evaluated in parallel node blocks
+void FusionSpaceSolver::calcUnaryCostsAndEmbeddings(const ProposalLabels &node_labels)
+{
+  unary_costs_.resize(node_labels.getNumLabels());
+  label_embeddings_.resize(node_labels.getNumLabels());
+  parallelFor(0, NUM_NODES_, min(getNumThreads() * 4, NUM_NODES_), [&](const int, const int first_node, const int last_node) {
+      cost_functor_.calcUnaryCosts(first_node, last_node, node_labels, &unary_costs_[node_labels.getLabelBegin(first_node)]);
+      for (int node_index = first_node; node_index < last_node; node_index++)
+	cost_functor_.calcLabelEmbeddings(node_index, node_labels.getLabels(node_index), node_labels.getNumLabels(node_index), &label_embeddings_[node_labels.getLabelBegin(node_index)]);
+    });
+}
+
+vector<long> FusionSpaceSolver::fuseBinary(const ProposalLabels &node_labels, std::vector<double> &energy_info)
+{
+  chrono::steady_clock::time_point lap_start = chrono::steady_clock::now();
+  checkProposalLabels(node_labels);
+  unary_costs_.resize(node_labels.getNumLabels());
+  cost_functor_.calcUnaryCosts(0, NUM_NODES_, node_labels, &unary_costs_[0]);
+  if (cost_functor_.hasFactorizedPairwiseCost()) {
+    label_embeddings_.resize(node_labels.getNumLabels());
+    for (int node_index = 0; node_index < NUM_NODES_; node_index++)
+      cost_functor_.calcLabelEmbeddings(node_index, node_labels.getLabels(node_index), node_labels.getNumLabels(node_index), &label_embeddings_[node_labels.getLabelBegin(node_index)]);
+  }
+  
+  //start from the current solution where it is among the proposed labels
+  current_label_indices_.assign(NUM_NODES_, 0);
+  for (int node_index = 0; node_index < NUM_NODES_; node_index++) {
+    const long *labels = node_labels.getLabels(node_index);
+    const int NUM_LABELS = node_labels.getNumLabels(node_index);
+    if (current_solution_.size() == NUM_NODES_) {
+      const int current_label_index = find(labels, labels + NUM_LABELS, current_solution_[node_index]) - labels;
+      current_label_indices_[node_index] = current_label_index < NUM_LABELS ? current_label_index : 0;
+    }
+  }
+  double energy = calcEnergy(node_labels, current_label_indices_);
+  fusion_telemetry_.unary_seconds += calcLapSeconds(lap_start);
+  
+  //One move per proposal source: every node may switch to the label this source proposed for it (nodes without one keep their label). Labeling 0 keeps the current label (source side), labeling 1 takes the proposed one (sink side).
+  for (int proposal_source = 0; proposal_source < node_labels.getNumSources() && (proposal_source == 0 || isDeadlineReached() == false); proposal_source++) {
+    proposed_label_indices_.resize(NUM_NODES_);
+    bool has_change = false;
+    for (int node_index = 0; node_index < NUM_NODES_; node_index++) {
+      const int source_label_index = node_labels.getSourceLabelIndex(node_index, proposal_source);
+      proposed_label_indices_[node_index] = source_label_index >= 0 ? source_label_index : current_label_indices_[node_index];
+      if (proposed_label_indices_[node_index] != current_label_indices_[node_index])
+	has_change = true;
+    }
+    if (has_change == false)
+      continue;
+    
+    max_flow_.reset(NUM_NODES_);
+    unary_cost_differences_.assign(NUM_NODES_, 0);
+    for (int node_index = 0; node_index < NUM_NODES_; node_index++)
+      unary_cost_differences_[node_index] = unary_costs_[node_labels.getLabelBegin(node_index) + proposed_label_indices_[node_index]] - unary_costs_[node_labels.getLabelBegin(node_index) + current_label_indices_[node_index]];
+    for (int node_index = 0; node_index < NUM_NODES_; node_index++) {
+      const int current_label_index = current_label_indices_[node_index];
+      const int proposed_label_index = proposed_label_indices_[node_index];
+      for (int edge_index = node_graph_.getEdgeBegin(node_index); edge_index < node_graph_.getEdgeEnd(node_index); edge_index++) {
+	const int neighbor = node_graph_.getNeighbor(edge_index);
+	const double cost_00 = calcPairwiseCost(node_index, edge_index, node_labels, current_label_index, current_label_indices_[neighbor]);
+	const double cost_01 = calcPairwiseCost(node_index, edge_index, node_labels, current_label_index, proposed_label_indices_[neighbor]);
+	const double cost_10 = calcPairwiseCost(node_index, edge_index, node_labels, proposed_label_index, current_label_indices_[neighbor]);
+	double cost_11 = calcPairwiseCost(node_index, edge_index, node_labels, proposed_label_index, proposed_label_indices_[neighbor]);
+	if (cost_00 <= 0 && cost_01 <= 0 && cost_10 <= 0 && cost_11 <= 0)
+	  continue;
+	//non-submodular terms are truncated; the move is only accepted if the true energy decreases
+	if (cost_00 + cost_11 > cost_01 + cost_10)
+	  cost_11 = cost_01 + cost_10 - cost_00;
+	//E = cost_00 + (cost_10 - cost_00) x_1 + (cost_11 - cost_10) x_2 + (cost_01 + cost_10 - cost_00 - cost_11) (1 - x_1) x_2
+	unary_cost_differences_[node_index] += cost_10 - cost_00;
+	unary_cost_differences_[neighbor] += cost_11 - cost_10;
+	max_flow_.addEdge(node_index, neighbor, cost_01 + cost_10 - cost_00 - cost_11, 0);
+	fusion_telemetry_.num_edges++;
+      }
+    }
+    for (int node_index = 0; node_index < NUM_NODES_; node_index++)
+      max_flow_.addTerminalWeights(node_index, max(unary_cost_differences_[node_index], 0.0), max(-unary_cost_differences_[node_index], 0.0));
+    fusion_telemetry_.pairwise_seconds += calcLapSeconds(lap_start);
+    max_flow_.solve();
+    fusion_telemetry_.optimization_seconds += calcLapSeconds(lap_start);
+    
+    for (int node_index = 0; node_index < NUM_NODES_; node_index++)
+      if (max_flow_.isSourceSide(node_index))
+	proposed_label_indices_[node_index] = current_label_indices_[node_index];
+    const double proposed_energy = calcEnergy(node_labels, proposed_label_indices_);
+    if (proposed_energy < energy) {
+      energy = proposed_energy;
+      current_label_indices_.swap(proposed_label_indices_);
+    }
+    fusion_telemetry_.decode_seconds += calcLapSeconds(lap_start);
+  }
+  
+  vector<long> fused_labels(NUM_NODES_);
+  for (int node_index = 0; node_index < NUM_NODES_; node_index++)
+    fused_labels[node_index] = node_labels.getLabel(node_index, current_label_indices_[node_index]);
+  energy_info.assign(2, energy);
+  energy_info[1] = -numeric_limits<double>::max();
+  updateBufferCapacity();
   return fused_labels;
 }
 
+//pairwise cost of the edge between node_index and its neighbor at edge_index, for label indices into node_labels
+double FusionSpaceSolver::calcPairwiseCost(const int node_index, const int edge_index, const ProposalLabels &node_labels, const int label_index, const int neighbor_label_index) const
+{
+  const int neighbor = node_graph_.getNeighbor(edge_index);
+  if (cost_functor_.hasFactorizedPairwiseCost())
+    return cost_functor_.getEdgeWeight(edge_index, node_index, neighbor) * fabs(label_embeddings_[node_labels.getLabelBegin(node_index) + label_index] - label_embeddings_[node_labels.getLabelBegin(neighbor) + neighbor_label_index]);
+  return cost_functor_.calcPairwiseCost(edge_index, node_index, neighbor, node_labels.getLabel(node_index, label_index), node_labels.getLabel(neighbor, neighbor_label_index));
+}
+
+//energy of a labeling given by label indices, counting only edges with some positive cost as fuse does
+double FusionSpaceSolver::calcEnergy(const ProposalLabels &node_labels, const std::vector<int> &label_indices) const
+{
+  double energy = 0;
+  for (int node_index = 0; node_index < NUM_NODES_; node_index++) {
+    energy += unary_costs_[node_labels.getLabelBegin(node_index) + label_indices[node_index]];
+    for (int edge_index = node_graph_.getEdgeBegin(node_index); edge_index < node_graph_.getEdgeEnd(node_index); edge_index++)
+      energy += max(calcPairwiseCost(node_index, edge_index, node_labels, label_indices[node_index], label_indices[node_graph_.getNeighbor(edge_index)]), 0.0);
+  }
+  return energy;
+}
+
+void FusionSpaceSolver::checkProposalLabels(const ProposalLabels &node_labels) const
+{
+  if (node_labels.getNumNodes() != NUM_NODES_)
+    throw invalid_argument("proposal covers " + to_string(node_labels.getNumNodes()) + " nodes instead of " + to_string(NUM_NODES_));
+  for (int node_index = 0; node_index < NUM_NODES_; node_index++)
+    if (node_labels.getNumLabels(node_index) == 0)
+      throw invalid_argument("empty proposal at node " + to_string(node_index));
+}
+
+//records in the fusion telemetry whether a fusion had to grow the persistent buffers; in steady state no fusion does
+void FusionSpaceSolver::updateBufferCapacity()
+{
+  long capacity = factorized_trws_.getBufferCapacity();
+  capacity += proposal_labels_.getBufferCapacity();
+  capacity += (unary_costs_.capacity() + label_embeddings_.capacity() + pairwise_costs_.capacity() + unary_cost_differences_.capacity()) * sizeof(double);
+  capacity += (current_label_indices_.capacity() + proposed_label_indices_.capacity() + tiled_label_indices_.capacity() + seam_fused_label_indices_.capacity()) * sizeof(int);
+  capacity += fixed_embeddings_.capacity() * sizeof(double) + seam_subset_.getBufferCapacity();
+  for (vector<NodeSubset>::const_iterator tile_it = tile_subsets_.begin(); tile_it != tile_subsets_.end(); tile_it++)
+    capacity += tile_it->getBufferCapacity();
+  if (capacity > buffer_capacity_) {
+    num_buffer_growths_++;
+    buffer_capacity_ = capacity;
+    fusion_telemetry_.buffers_grown = true;
+  }
+  fusion_telemetry_.buffer_capacity = buffer_capacity_;
+}
+
 vector<long> FusionSpaceSolver::solve(const int NUM_ITERATIONS, const vector<long> &initial_solution)
 {
+  return solve(NUM_ITERATIONS, chrono::steady_clock::time_point::max(), initial_solution);
+}
+
+vector<long> FusionSpaceSolver::solve(const chrono::steady_clock::time_point &deadline, const vector<long> &initial_solution)
+{
+  return solve(numeric_limits<int>::max(), deadline, initial_solution);
+}
+
+vector<long> FusionSpaceSolver::solve(const int NUM_ITERATIONS, const chrono::steady_clock::time_point &deadline, const vector<long> &initial_solution)
+{
+  const chrono::steady_clock::time_point SOLVE_START = chrono::steady_clock::now();
+  deadline_ = deadline;
+  num_solves_++;
   vector<long> current_solution = initial_solution;
+  current_solution_ = current_solution;
+  num_fusions_ = 0;
+  stop_reason_ = MAX_ITERATIONS_REACHED;
+  if (NUM_NODES_ == 0) {
+    stop_reason_ = EMPTY_PROBLEM;
+    return current_solution;
+  }
   double current_solution_energy = numeric_limits<double>::max();
   proposal_generator_.setCurrentSolution(current_solution);    
   cost_functor_.setCurrentSolution(current_solution);
   
+  int num_stalled_fusions = 0;
   for (int iteration = 0; iteration < NUM_ITERATIONS; iteration++) {
-    vector<vector<long> > pixel_labels = proposal_generator_.getProposal();
+    const chrono::steady_clock::time_point ITERATION_START = chrono::steady_clock::now();
+    if (chrono::duration<double>(deadline_ - ITERATION_START).count() < estimated_iteration_seconds_) {
+      stop_reason_ = DEADLINE_REACHED;
+      break;
+    }
+    fusion_telemetry_ = FusionTelemetry();
+    chrono::steady_clock::time_point lap_start = ITERATION_START;
+    proposal_generator_.getProposal(proposal_labels_);
+    fusion_telemetry_.proposal_seconds = calcLapSeconds(lap_start);
     vector<double> energy_info;
-    vector<long> solution = fuse(pixel_labels, energy_info);
-    if (energy_info[0] >= current_solution_energy)
-      continue;
-    current_solution = solution;
-    current_solution_energy = energy_info[0];
-    if (iteration < NUM_ITERATIONS - 1) {
-      proposal_generator_.setCurrentSolution(current_solution);
-      cost_functor_.setCurrentSolution(current_solution);
+    vector<long> solution = fuse(proposal_labels_, energy_info);
+    num_fusions_++;
+    //interrupted fusions end early and would pull the estimate down, so they are not counted
+    const double ITERATION_SECONDS = chrono::duration<double>(chrono::steady_clock::now() - ITERATION_START).count();
+    if (isDeadlineReached() == false)
+      estimated_iteration_seconds_ = estimated_iteration_seconds_ == 0 ? ITERATION_SECONDS : 0.7 * estimated_iteration_seconds_ + 0.3 * ITERATION_SECONDS;
+    //the first fusion has nothing to compare with and never stalls
+    const bool ACCEPTED = energy_info[0] < current_solution_energy;
+    if (telemetry_sink_ != NULL) {
+      fusion_telemetry_.solve_index = num_solves_;
+      fusion_telemetry_.iteration = iteration;
+      fusion_telemetry_.energy = energy_info[0];
+      fusion_telemetry_.lower_bound = energy_info[1];
+      fusion_telemetry_.accepted = ACCEPTED;
+      fusion_telemetry_.num_nodes = NUM_NODES_;
+      fusion_telemetry_.num_labels = proposal_labels_.getNumLabels();
+      telemetry_sink_->recordFusion(fusion_telemetry_);
     }
+    if (isDiagnosticsEnabled(diagnostics_sink_, DIAGNOSTICS_ITERATIONS))
+      diagnostics_sink_->writeSolution("solution_" + to_string(iteration) + ".txt", solution);
+    if (ACCEPTED && (current_solution_energy == numeric_limits<double>::max() || current_solution_energy - energy_info[0] >= convergence_policy_.relative_improvement_threshold * max(fabs(current_solution_energy), 1.0)))
+      num_stalled_fusions = 0;
+    else
+      num_stalled_fusions++;
+    const bool STOP = convergence_policy_.patience > 0 && num_stalled_fusions >= convergence_policy_.patience && iteration < NUM_ITERATIONS - 1;
+    if (STOP)
+      stop_reason_ = NO_IMPROVEMENT;
+    if (ACCEPTED) {
+      current_solution = solution;
+      current_solution_ = current_solution;
+      current_solution_energy = energy_info[0];
+      if (iteration < NUM_ITERATIONS - 1 && STOP == false) {
+	proposal_generator_.setCurrentSolution(current_solution);
+	cost_functor_.setCurrentSolution(current_solution);
+      }
+    }
+    if (STOP)
+      break;
+  }
+  if (telemetry_sink_ != NULL) {
+    SolveTelemetry solve_telemetry;
+    solve_telemetry.solve_index = num_solves_;
+    solve_telemetry.num_fusions = num_fusions_;
+    solve_telemetry.energy = current_solution_energy;
+    solve_telemetry.stop_reason = getStopReasonName(stop_reason_);
+    solve_telemetry.seconds = chrono::duration<double>(chrono::steady_clock::now() - SOLVE_START).count();
+    telemetry_sink_->recordSolve(solve_telemetry);
   }
   return current_solution;
 }
@@ -2,32 +2,143 @@
 #define FUSION_SPACE_SOLVER_H__
 
 #include <vector>
+#include <chrono>
 
 #include "CostFunctor.h"
+#include "NeighborGraph.h"
 #include "ProposalGenerator.h"
+#include "ProposalLabels.h"
+#include "FactorizedTRWS.h"
+#include "MaxFlow.h"
+#include "Diagnostics.h"
+#include "ConvergencePolicy.h"
+#include "SolverTelemetry.h"
 
 
+//TRW_S_FUSION fuses all proposed labels at once with TRW-S; GRAPH_CUT_FUSION runs binary fusion moves (current labels vs. the labels of one proposal source, see ProposalLabels) solved by max-flow, one move per source
+enum FusionMethod { TRW_S_FUSION, GRAPH_CUT_FUSION };
+
 class FusionSpaceSolver
 {
  public:
-  
-  FusionSpaceSolver(const int NUM_NODES, const std::vector<std::vector<int> > &node_neighbors, CostFunctor &cost_functor, ProposalGenerator &proposal_generator, const int NUM_ITERATIONS = 1000, const bool CONSIDER_LABEL_COST = false);
+  //throws std::invalid_argument for GRAPH_CUT_FUSION with label costs
+  FusionSpaceSolver(const int NUM_NODES, const NeighborGraph &node_graph, CostFunctor &cost_functor, ProposalGenerator &proposal_generator, const int NUM_ITERATIONS = 1000, const bool CONSIDER_LABEL_COST = false, const FusionMethod FUSION_METHOD = TRW_S_FUSION);
   
   //  void setNeighbors();
   //void setNeighbors(const int width, const int height, const int neighbor_system = 8);
   
   std::vector<long> solve(const int NUM_ITERATIONS, const std::vector<long> &initial_solution);
+  //Anytime solve: fuses until the deadline and returns the best solution found. A fusion is not started if the running estimate of the iteration time says it would end past the deadline, and TRW-S inside a running fusion is interrupted at the deadline (after the current pass, or the current chunk of check interval iterations for the non-factorized MRF) with its best labeling so far.
+  std::vector<long> solve(const std::chrono::steady_clock::time_point &deadline, const std::vector<long> &initial_solution);
+  
+  //Tiled fusion: nodes are split into NUM_TILES contiguous index ranges, each grown by NUM_HALO_HOPS graph hops and fused on its own thread with the nodes outside clamped to the current solution; only the labels of the range itself are kept. Finally a band of NUM_SEAM_HOPS hops around the range borders is fused again with everything else clamped. Needs factorized pairwise costs and TRW-S fusion without label costs; NUM_TILES <= 1 disables it.
+  void setTiling(const int NUM_TILES, const int NUM_HALO_HOPS = 4, const int NUM_SEAM_HOPS = 2);
+  
+  void setConvergencePolicy(const ConvergencePolicy &convergence_policy) { convergence_policy_ = convergence_policy; };
+  //why the last solve stopped and how many fusions it ran
+  StopReason getStopReason() const { return stop_reason_; };
+  int getNumFusions() const { return num_fusions_; };
+  //every fusion and every solve is reported to the sink (none by default); the sink is not owned
+  void setTelemetrySink(TelemetrySink *telemetry_sink) { telemetry_sink_ = telemetry_sink; };
+  //the solution of every fusion goes to the sink as solution_<iteration>.txt (DIAGNOSTICS_ITERATIONS); the sink is not owned
+  void setDiagnosticsSink(DiagnosticsSink *diagnostics_sink) { diagnostics_sink_ = diagnostics_sink; };
+  //exponential moving average of the wall-clock time of one iteration (proposal and fusion), kept across solves
+  double getEstimatedIterationSeconds() const { return estimated_iteration_seconds_; };
+  
+  //number of fusions after which the fusion buffers had to grow (0 or 1 for constant proposal sizes)
+  int getNumBufferGrowths() const { return num_buffer_growths_; };
+  long getBufferCapacity() const { return buffer_capacity_; };
   
  private:
   const int NUM_NODES_;
   const int NUM_ITERATIONS_;
   const bool CONSIDER_LABEL_COST_;
+  const FusionMethod FUSION_METHOD_;
   
-  const std::vector<std::vector<int> > node_neighbors_;
+  const NeighborGraph &node_graph_;
   CostFunctor &cost_functor_;
   ProposalGenerator &proposal_generator_;
   
-  std::vector<long> fuse(const std::vector<std::vector<long> > &proposal_labels, std::vector<double> &energy_info);
+  //buffers kept across fusions (like those of the node subsets below); they are overwritten by every fusion and only grow when a proposal has more labels than all previous ones
+  ProposalLabels proposal_labels_;
+  std::vector<double> unary_costs_;
+  std::vector<double> label_embeddings_;
+  std::vector<double> pairwise_costs_;
+  //the factorized energy keeps its edges (built on the first fusion) and only gets new labels per fusion
+  FactorizedTRWS factorized_trws_;
+  bool factorized_graph_ready_;
+  
+  std::vector<long> current_solution_;
+  std::vector<int> current_label_indices_;
+  std::vector<int> proposed_label_indices_;
+  std::vector<double> unary_cost_differences_;
+  MaxFlow max_flow_;
+  
+  int num_tiles_;
+  int num_halo_hops_;
+  int num_seam_hops_;
+  //both directions of every node graph edge (neighbor and edge index), built together with the tiles
+  std::vector<int> node_adjacency_offsets_;
+  std::vector<int> node_adjacency_;
+  std::vector<int> node_adjacency_edges_;
+  //A tile or the seam band, fused with all other nodes clamped. Edges inside the subset (in its TRW-S graph) and edges leaving it are built once from the adjacency; the label buffers are refilled by every fusion.
+  struct NodeSubset
+  {
+    std::vector<int> nodes;
+    //edges leaving the subset, per subset node
+    std::vector<int> boundary_offsets;
+    std::vector<int> boundary_neighbors;
+    std::vector<double> boundary_weights;
+    std::vector<int> label_offsets;
+    std::vector<double> unary_costs;
+    std::vector<double> embeddings;
+    FactorizedTRWS trws;
+    
+    long getBufferCapacity() const { return trws.getBufferCapacity() + (nodes.capacity() + boundary_offsets.capacity() + boundary_neighbors.capacity() + label_offsets.capacity()) * sizeof(int) + (boundary_weights.capacity() + unary_costs.capacity() + embeddings.capacity()) * sizeof(double); };
+  };
+  std::vector<NodeSubset> tile_subsets_;
+  NodeSubset seam_subset_;
+  std::vector<double> fixed_embeddings_;
+  std::vector<int> tiled_label_indices_;
+  std::vector<int> seam_fused_label_indices_;
+  
+  ConvergencePolicy convergence_policy_;
+  StopReason stop_reason_;
+  int num_fusions_;
+  std::chrono::steady_clock::time_point deadline_;
+  double estimated_iteration_seconds_;
+  
+  TelemetrySink *telemetry_sink_;
+  int num_solves_;
+  //filled by fuse and solve for the current fusion
+  FusionTelemetry fusion_telemetry_;
+  DiagnosticsSink *diagnostics_sink_;
+  
+  long buffer_capacity_;
+  int num_buffer_growths_;
+  
+  void checkProposalLabels(const ProposalLabels &node_labels) const;
+  double calcPairwiseCost(const int node_index, const int edge_index, const ProposalLabels &node_labels, const int label_index, const int neighbor_label_index) const;
+  double calcEnergy(const ProposalLabels &node_labels, const std::vector<int> &label_indices) const;
+  void updateBufferCapacity();
+  bool isDeadlineReached() const { return std::chrono::steady_clock::now() >= deadline_; };
+  std::vector<long> solve(const int NUM_ITERATIONS, const std::chrono::steady_clock::time_point &deadline, const std::vector<long> &initial_solution);
+  void calcNodeAdjacency();
+  void calcTiles();
+  void buildSubset(NodeSubset &subset) const;
+  void expandNodes(std::vector<int> &nodes, const int NUM_HOPS, std::vector<int> &node_marks, const int mark) const;
+  void calcUnaryCostsAndEmbeddings(const ProposalLabels &node_labels);
+  
+  //energy_info holds the energy of the fused labels and a lower bound, or -numeric_limits<double>::max() if the fusion method has none
+  std::vector<long> fuse(const ProposalLabels &proposal_labels, std::vector<double> &energy_info);
+  //fusion with pairwise costs weight * |embedding_1 - embedding_2|, which stores only one embedding per label and one weight per edge
+  std::vector<long> fuseFactorized(const ProposalLabels &proposal_labels, std::vector<double> &energy_info);
+  //sequence of binary fusion moves starting from current_solution_; there is no lower bound
+  std::vector<long> fuseBinary(const ProposalLabels &proposal_labels, std::vector<double> &energy_info);
+  //there is no lower bound for the tiled problem
+  std::vector<long> fuseTiled(const ProposalLabels &proposal_labels, std::vector<double> &energy_info);
+  //fuses the labels of the subset nodes with all other nodes fixed to labels with the given embeddings; subset.trws holds the label index of every subset node afterwards
+  void fuseSubset(const ProposalLabels &node_labels, const std::vector<double> &fixed_embeddings, NodeSubset &subset) const;
 };
 
 #endif
@@ -0,0 +1,144 @@
+#include "MaxFlow.h"
+
+#include <limits>
+#include <algorithm>
+
+using namespace std;
+
+
+MaxFlow::MaxFlow() : num_nodes_(0), terminal_flow_(0)
+{
+}
+
+//the source and the sink are the two nodes after the regular ones
+void MaxFlow::reset(const int NUM_NODES)
+{
+  num_nodes_ = NUM_NODES;
+  terminal_flow_ = 0;
+  arc_tails_.clear();
+  arc_heads_.clear();
+  arc_capacities_.clear();
+}
+
+void MaxFlow::addTerminalWeights(const int node, const double source_capacity, const double sink_capacity)
+{
+  //flow through source -> node -> sink saturates the smaller terminal edge right away
+  const double flow = min(source_capacity, sink_capacity);
+  terminal_flow_ += flow;
+  if (source_capacity - flow > 0)
+    addArcPair(num_nodes_, node, source_capacity - flow, 0);
+  if (sink_capacity - flow > 0)
+    addArcPair(node, num_nodes_ + 1, sink_capacity - flow, 0);
+}
+
+void MaxFlow::addEdge(const int node_1, const int node_2, const double capacity, const double reverse_capacity)
+{
+  if (capacity > 0 || reverse_capacity > 0)
+    addArcPair(node_1, node_2, max(capacity, 0.0), max(reverse_capacity, 0.0));
+}
+
+//arc 2k is the forward arc, arc 2k + 1 its residual counterpart
+void MaxFlow::addArcPair(const int node_1, const int node_2, const double capacity, const double reverse_capacity)
+{
+  arc_tails_.push_back(node_1);
+  arc_heads_.push_back(node_2);
+  arc_capacities_.push_back(capacity);
+  arc_tails_.push_back(node_2);
+  arc_heads_.push_back(node_1);
+  arc_capacities_.push_back(reverse_capacity);
+}
+
+double MaxFlow::solve()
+{
+  const int NUM_ALL_NODES = num_nodes_ + 2;
+  const int NUM_ARCS = arc_heads_.size();
+  node_arc_offsets_.assign(NUM_ALL_NODES + 1, 0);
+  for (int arc = 0; arc < NUM_ARCS; arc++)
+    node_arc_offsets_[arc_tails_[arc] + 1]++;
+  for (int node = 0; node < NUM_ALL_NODES; node++)
+    node_arc_offsets_[node + 1] += node_arc_offsets_[node];
+  node_arcs_.resize(NUM_ARCS);
+  current_arcs_.assign(node_arc_offsets_.begin(), node_arc_offsets_.end() - 1);
+  for (int arc = 0; arc < NUM_ARCS; arc++)
+    node_arcs_[current_arcs_[arc_tails_[arc]]++] = arc;
+  levels_.resize(NUM_ALL_NODES);
+  queue_.resize(NUM_ALL_NODES);
+  
+  double flow = terminal_flow_;
+  while (calcLevels()) {
+    current_arcs_.assign(node_arc_offsets_.begin(), node_arc_offsets_.end() - 1);
+    flow += augment();
+  }
+  return flow;
+}
+
+//breadth-first search from the source over arcs with residual capacity; false once the sink is unreachable (levels_ then marks the source side of the minimum cut)
+bool MaxFlow::calcLevels()
+{
+  fill(levels_.begin(), levels_.end(), -1);
+  const int SOURCE = num_nodes_;
+  const int SINK = num_nodes_ + 1;
+  int queue_begin = 0, queue_end = 0;
+  queue_[queue_end++] = SOURCE;
+  levels_[SOURCE] = 0;
+  while (queue_begin < queue_end) {
+    const int node = queue_[queue_begin++];
+    for (int arc_index = node_arc_offsets_[node]; arc_index < node_arc_offsets_[node + 1]; arc_index++) {
+      const int arc = node_arcs_[arc_index];
+      if (arc_capacities_[arc] > 0 && levels_[arc_heads_[arc]] < 0) {
+	levels_[arc_heads_[arc]] = levels_[node] + 1;
+	queue_[queue_end++] = arc_heads_[arc];
+      }
+    }
+  }
+  return levels_[SINK] >= 0;
+}
+
+//blocking flow on the level graph with an explicit path stack
+double MaxFlow::augment()
+{
+  const int SOURCE = num_nodes_;
+  const int SINK = num_nodes_ + 1;
+  double flow = 0;
+  path_.clear();
+  int node = SOURCE;
+  while (true) {
+    if (node == SINK) {
+      double path_flow = numeric_limits<double>::max();
+      for (vector<int>::const_iterator arc_it = path_.begin(); arc_it != path_.end(); arc_it++)
+	path_flow = min(path_flow, arc_capacities_[*arc_it]);
+      const int PATH_LENGTH = path_.size();
+      int first_saturated_arc_index = -1;
+      for (int arc_index = 0; arc_index < PATH_LENGTH; arc_index++) {
+	arc_capacities_[path_[arc_index]] -= path_flow;
+	arc_capacities_[path_[arc_index] ^ 1] += path_flow;
+	if (arc_capacities_[path_[arc_index]] <= 0 && first_saturated_arc_index < 0)
+	  first_saturated_arc_index = arc_index;
+      }
+      flow += path_flow;
+      node = arc_tails_[path_[first_saturated_arc_index]];
+      path_.resize(first_saturated_arc_index);
+      continue;
+    }
+    
+    int &arc_index = current_arcs_[node];
+    for (; arc_index < node_arc_offsets_[node + 1]; arc_index++) {
+      const int arc = node_arcs_[arc_index];
+      if (arc_capacities_[arc] > 0 && levels_[arc_heads_[arc]] == levels_[node] + 1)
+	break;
+    }
+    if (arc_index < node_arc_offsets_[node + 1]) {
+      path_.push_back(node_arcs_[arc_index]);
+      node = arc_heads_[node_arcs_[arc_index]];
+      continue;
+    }
+    //dead end: retreat and never enter this node again in this phase
+    if (node == SOURCE)
+      break;
+    levels_[node] = -1;
+    node = arc_tails_[path_.back()];
+    path_.pop_back();
+    current_arcs_[node]++;
+  }
+  return flow;
+}
@@ -0,0 +1,44 @@
+#ifndef MAX_FLOW_H__
+#define MAX_FLOW_H__
+
+#include <vector>
+
+
+//s-t minimum cut (Dinic's algorithm) for binary energy minimization. Every node is connected to the source and the sink by terminal edges; after solve, nodes on the sink side are the ones whose cut cost includes their source capacity.
+//reset keeps all buffers so that a graph rebuilt with the same size does not allocate.
+class MaxFlow
+{
+ public:
+  MaxFlow();
+  
+  void reset(const int NUM_NODES);
+  //capacities of source -> node and node -> sink
+  void addTerminalWeights(const int node, const double source_capacity, const double sink_capacity);
+  //capacities of node_1 -> node_2 and node_2 -> node_1
+  void addEdge(const int node_1, const int node_2, const double capacity, const double reverse_capacity);
+  
+  //returns the flow value (the cut cost)
+  double solve();
+  bool isSourceSide(const int node) const { return levels_[node] >= 0; };
+  
+ private:
+  int num_nodes_;
+  double terminal_flow_;
+  
+  std::vector<int> arc_tails_;
+  std::vector<int> arc_heads_;
+  std::vector<double> arc_capacities_;
+  
+  std::vector<int> node_arc_offsets_;
+  std::vector<int> node_arcs_;
+  std::vector<int> current_arcs_;
+  std::vector<int> levels_;
+  std::vector<int> queue_;
+  std::vector<int> path_;
+  
+  void addArcPair(const int node_1, const int node_2, const double capacity, const double reverse_capacity);
+  bool calcLevels();
+  double augment();
+};
+
+#endif
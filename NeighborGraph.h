@@ -0,0 +1,177 @@
+#ifndef NEIGHBOR_GRAPH_H__
+#define NEIGHBOR_GRAPH_H__
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <stdexcept>
+
+
+//Neighborhood graph in compressed sparse row form. The neighbors of a node are stored (in ascending order) at [getEdgeBegin(node), getEdgeEnd(node)) of one contiguous neighbor array and one contiguous weight array. The position in these arrays is the edge index.
+//The arrays are either owned by the graph or live in external memory (e.g. a memory-mapped cache file) which is kept alive by the graph.
+//Offsets and edge indices are ints, so a graph holds at most INT_MAX edges; building a larger one throws std::invalid_argument (see checkNumEdges).
+//replaceNodes appends the new rows behind the existing edges, so the rows are no longer in node order and the arrays hold dropped edges (getOffsets gives row begins only) until compact is called or replaceNodes compacts them itself.
+class NeighborGraph
+{
+ public:
+  NeighborGraph() : owned_offsets_(1, 0), num_dropped_edges_(0) { pointToOwnedArrays(); };
+  NeighborGraph(const NeighborGraph &graph) { *this = graph; };
+  NeighborGraph &operator=(const NeighborGraph &graph)
+  {
+    if (this == &graph)
+      return *this;
+    owned_offsets_ = graph.owned_offsets_;
+    owned_ends_ = graph.owned_ends_;
+    owned_neighbors_ = graph.owned_neighbors_;
+    owned_weights_ = graph.owned_weights_;
+    external_memory_ = graph.external_memory_;
+    num_dropped_edges_ = graph.num_dropped_edges_;
+    if (graph.owned_offsets_.empty()) {
+      num_nodes_ = graph.num_nodes_;
+      num_edges_ = graph.num_edges_;
+      offsets_ = graph.offsets_;
+      ends_ = graph.ends_;
+      neighbors_ = graph.neighbors_;
+      weights_ = graph.weights_;
+    } else
+      pointToOwnedArrays();
+    return *this;
+  };
+
+  //takes over the contents of the given arrays (offsets has NUM_NODES + 1 entries)
+  void assign(std::vector<int> &offsets, std::vector<int> &neighbors, std::vector<double> &weights)
+  {
+    checkNumEdges(neighbors.size());
+    owned_offsets_.swap(offsets);
+    std::vector<int>().swap(owned_ends_);
+    owned_neighbors_.swap(neighbors);
+    owned_weights_.swap(weights);
+    external_memory_.reset();
+    num_dropped_edges_ = 0;
+    pointToOwnedArrays();
+  };
+  //uses arrays in external memory without copying them; external_memory is released together with the graph
+  void assign(const int NUM_NODES, const int NUM_EDGES, const int *offsets, const int *neighbors, const double *weights, const std::shared_ptr<const void> &external_memory)
+  {
+    std::vector<int>().swap(owned_offsets_);
+    std::vector<int>().swap(owned_ends_);
+    std::vector<int>().swap(owned_neighbors_);
+    std::vector<double>().swap(owned_weights_);
+    external_memory_ = external_memory;
+    num_dropped_edges_ = 0;
+    num_nodes_ = NUM_NODES;
+    num_edges_ = NUM_EDGES;
+    offsets_ = offsets;
+    ends_ = offsets + 1;
+    neighbors_ = neighbors;
+    weights_ = weights;
+  };
+
+  //Replaces the edges of the given (distinct) nodes with the given rows (offsets relative to the first row, nodes.size() + 1 entries). The rows are appended and the old ones dropped, so the cost follows the number of new edges; the arrays are compacted once the dropped edges outnumber the others. The graph owns its arrays afterwards.
+  void replaceNodes(const std::vector<int> &nodes, const std::vector<int> &offsets, const std::vector<int> &neighbors, const std::vector<double> &weights)
+  {
+    checkNumEdges(static_cast<long>(num_edges_) + neighbors.size());
+    //external arrays are copied first (owned arrays always have an offset)
+    if (owned_offsets_.empty()) {
+      owned_offsets_.assign(offsets_, offsets_ + num_nodes_ + 1);
+      owned_neighbors_.assign(neighbors_, neighbors_ + num_edges_);
+      owned_weights_.assign(weights_, weights_ + num_edges_);
+      external_memory_.reset();
+    }
+    if (owned_ends_.empty())
+      owned_ends_.assign(owned_offsets_.begin() + 1, owned_offsets_.end());
+    const int FIRST_NEW_EDGE = owned_neighbors_.size();
+    for (int index = 0; index < static_cast<int>(nodes.size()); index++) {
+      const int node = nodes[index];
+      num_dropped_edges_ += owned_ends_[node] - owned_offsets_[node];
+      owned_offsets_[node] = FIRST_NEW_EDGE + offsets[index];
+      owned_ends_[node] = FIRST_NEW_EDGE + offsets[index + 1];
+    }
+    owned_neighbors_.insert(owned_neighbors_.end(), neighbors.begin(), neighbors.end());
+    owned_weights_.insert(owned_weights_.end(), weights.begin(), weights.end());
+    pointToOwnedArrays();
+    if (num_dropped_edges_ > num_edges_ - num_dropped_edges_)
+      compact();
+  };
+  //stores the rows in node order without dropped edges again (edge indices change)
+  void compact()
+  {
+    if (isCompact())
+      return;
+    std::vector<int> offsets(1, 0);
+    offsets.reserve(num_nodes_ + 1);
+    std::vector<int> neighbors;
+    neighbors.reserve(num_edges_ - num_dropped_edges_);
+    std::vector<double> weights;
+    weights.reserve(num_edges_ - num_dropped_edges_);
+    for (int node = 0; node < num_nodes_; node++) {
+      neighbors.insert(neighbors.end(), neighbors_ + offsets_[node], neighbors_ + ends_[node]);
+      weights.insert(weights.end(), weights_ + offsets_[node], weights_ + ends_[node]);
+      offsets.push_back(neighbors.size());
+    }
+    assign(offsets, neighbors, weights);
+  };
+  //whether the rows are stored in node order without dropped edges, so that getOffsets has the row ends as well
+  bool isCompact() const { return ends_ == offsets_ + 1; };
+
+  //throws std::invalid_argument if NUM_EDGES does not fit the int edge indices
+  static void checkNumEdges(const long NUM_EDGES)
+  {
+    if (NUM_EDGES > std::numeric_limits<int>::max())
+      throw std::invalid_argument("neighbor graph too large: " + std::to_string(NUM_EDGES) + " edges, at most " + std::to_string(std::numeric_limits<int>::max()) + " are supported");
+  };
+
+  int getNumNodes() const { return num_nodes_; };
+  //size of the edge arrays (edge indices are below it), including dropped edges
+  int getNumEdges() const { return num_edges_; };
+  int getEdgeBegin(const int node) const { return offsets_[node]; };
+  int getEdgeEnd(const int node) const { return ends_[node]; };
+  int getNumNeighbors(const int node) const { return ends_[node] - offsets_[node]; };
+  int getNeighbor(const int edge_index) const { return neighbors_[edge_index]; };
+  double getWeight(const int edge_index) const { return weights_[edge_index]; };
+
+  const int *getOffsets() const { return offsets_; };
+  const int *getNeighbors() const { return neighbors_; };
+  const double *getWeights() const { return weights_; };
+
+  //edge index of (node, neighbor), or -1 if they are not connected
+  int findEdge(const int node, const int neighbor) const
+  {
+    const int *row_begin = neighbors_ + offsets_[node];
+    const int *row_end = neighbors_ + ends_[node];
+    const int *neighbor_it = std::lower_bound(row_begin, row_end, neighbor);
+    if (neighbor_it == row_end || *neighbor_it != neighbor)
+      return -1;
+    return neighbor_it - neighbors_;
+  };
+
+ private:
+  std::vector<int> owned_offsets_;
+  //row ends once replaceNodes moved rows (empty while the graph is compact)
+  std::vector<int> owned_ends_;
+  std::vector<int> owned_neighbors_;
+  std::vector<double> owned_weights_;
+  std::shared_ptr<const void> external_memory_;
+  int num_dropped_edges_;
+
+  int num_nodes_;
+  int num_edges_;
+  const int *offsets_;
+  const int *ends_;
+  const int *neighbors_;
+  const double *weights_;
+
+  void pointToOwnedArrays()
+  {
+    num_nodes_ = owned_offsets_.size() - 1;
+    num_edges_ = owned_neighbors_.size();
+    offsets_ = owned_offsets_.empty() ? NULL : &owned_offsets_[0];
+    ends_ = owned_ends_.empty() ? offsets_ + 1 : &owned_ends_[0];
+    neighbors_ = owned_neighbors_.empty() ? NULL : &owned_neighbors_[0];
+    weights_ = owned_weights_.empty() ? NULL : &owned_weights_[0];
+  };
+};
+
+#endif
@@ -0,0 +1,150 @@
+#include "NeighborGraphCache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sstream>
+#include <iomanip>
+#include <fstream>
+#include <limits>
+#include <thread>
+
+using namespace std;
+
+namespace neighbor_graph_cache
+{
+  const char CACHE_MAGIC[8] = {'A', 'M', 'N', 'G', 'R', 'A', 'P', 'H'};
+  
+  struct CacheHeader
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t key;
+    int64_t num_nodes;
+    int64_t num_edges;
+    uint64_t offsets_position;
+    uint64_t neighbors_position;
+    uint64_t weights_position;
+    uint64_t file_size;
+  };
+  
+  uint64_t alignPosition(const uint64_t position)
+  {
+    return (position + 7) / 8 * 8;
+  }
+  
+  CacheHeader createHeader(const uint64_t key, const int NUM_NODES, const int NUM_EDGES)
+  {
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_FORMAT_VERSION;
+    header.header_size = sizeof(CacheHeader);
+    header.key = key;
+    header.num_nodes = NUM_NODES;
+    header.num_edges = NUM_EDGES;
+    header.weights_position = alignPosition(sizeof(CacheHeader));
+    header.offsets_position = alignPosition(header.weights_position + sizeof(double) * NUM_EDGES);
+    header.neighbors_position = alignPosition(header.offsets_position + sizeof(int) * (NUM_NODES + 1));
+    header.file_size = alignPosition(header.neighbors_position + sizeof(int) * NUM_EDGES);
+    return header;
+  }
+  
+  uint64_t hashBytes(const void *data, const size_t size, const uint64_t hash)
+  {
+    const uint64_t FNV_PRIME = 1099511628211ULL;
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    uint64_t new_hash = hash;
+    for (size_t i = 0; i < size; i++) {
+      new_hash ^= bytes[i];
+      new_hash *= FNV_PRIME;
+    }
+    return new_hash;
+  }
+  
+  string getCacheFilename(const string &cache_directory, const uint64_t key)
+  {
+    stringstream filename;
+    filename << cache_directory << "neighbor_graph_" << hex << setw(16) << setfill('0') << key << ".bin";
+    return filename.str();
+  }
+  
+  bool loadNeighborGraph(const string &filename, const uint64_t key, NeighborGraph &graph)
+  {
+    int file_descriptor = open(filename.c_str(), O_RDONLY);
+    if (file_descriptor < 0)
+      return false;
+    struct stat file_status;
+    if (fstat(file_descriptor, &file_status) != 0 || file_status.st_size < static_cast<off_t>(sizeof(CacheHeader))) {
+      close(file_descriptor);
+      return false;
+    }
+    const size_t FILE_SIZE = file_status.st_size;
+    void *data = mmap(NULL, FILE_SIZE, PROT_READ, MAP_SHARED, file_descriptor, 0);
+    close(file_descriptor);
+    if (data == MAP_FAILED)
+      return false;
+    shared_ptr<const void> mapping(data, [FILE_SIZE](const void *mapped_data) { munmap(const_cast<void *>(mapped_data), FILE_SIZE); });
+    
+    const CacheHeader &header = *static_cast<const CacheHeader *>(data);
+    if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_FORMAT_VERSION || header.header_size != sizeof(CacheHeader) || header.key != key)
+      return false;
+    if (header.num_nodes < 0 || header.num_edges < 0 || header.num_edges > numeric_limits<int>::max() || header.num_nodes >= numeric_limits<int>::max())
+      return false;
+    CacheHeader expected_header = createHeader(key, header.num_nodes, header.num_edges);
+    if (memcmp(&header, &expected_header, sizeof(CacheHeader)) != 0 || header.file_size != FILE_SIZE)
+      return false;
+    
+    const char *bytes = static_cast<const char *>(data);
+    const int *offsets = reinterpret_cast<const int *>(bytes + header.offsets_position);
+    if (offsets[0] != 0 || offsets[header.num_nodes] != header.num_edges)
+      return false;
+    for (int node = 0; node < header.num_nodes; node++)
+      if (offsets[node + 1] < offsets[node])
+	return false;
+    const int *neighbors = reinterpret_cast<const int *>(bytes + header.neighbors_position);
+    for (int edge_index = 0; edge_index < header.num_edges; edge_index++)
+      if (neighbors[edge_index] < 0 || neighbors[edge_index] >= header.num_nodes)
+	return false;
+    graph.assign(header.num_nodes, header.num_edges, offsets, neighbors, reinterpret_cast<const double *>(bytes + header.weights_position), mapping);
+    return true;
+  }
+  
+  bool saveNeighborGraph(const string &filename, const uint64_t key, const NeighborGraph &graph)
+  {
+    //the file layout needs the rows in node order
+    if (graph.isCompact() == false) {
+      NeighborGraph compact_graph(graph);
+      compact_graph.compact();
+      return saveNeighborGraph(filename, key, compact_graph);
+    }
+    const int NUM_NODES = graph.getNumNodes();
+    const int NUM_EDGES = graph.getNumEdges();
+    CacheHeader header = createHeader(key, NUM_NODES, NUM_EDGES);
+    
+    stringstream temporary_filename;
+    temporary_filename << filename << ".tmp." << getpid() << "." << this_thread::get_id();
+    ofstream out_str(temporary_filename.str().c_str(), ios::binary);
+    if (!out_str)
+      return false;
+    const char PADDING[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    out_str.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out_str.write(PADDING, header.weights_position - sizeof(header));
+    out_str.write(reinterpret_cast<const char *>(graph.getWeights()), sizeof(double) * NUM_EDGES);
+    out_str.write(PADDING, header.offsets_position - (header.weights_position + sizeof(double) * NUM_EDGES));
+    out_str.write(reinterpret_cast<const char *>(graph.getOffsets()), sizeof(int) * (NUM_NODES + 1));
+    out_str.write(PADDING, header.neighbors_position - (header.offsets_position + sizeof(int) * (NUM_NODES + 1)));
+    out_str.write(reinterpret_cast<const char *>(graph.getNeighbors()), sizeof(int) * NUM_EDGES);
+    out_str.write(PADDING, header.file_size - (header.neighbors_position + sizeof(int) * NUM_EDGES));
+    out_str.close();
+    if (!out_str) {
+      remove(temporary_filename.str().c_str());
+      return false;
+    }
+    return rename(temporary_filename.str().c_str(), filename.c_str()) == 0;
+  }
+}
@@ -0,0 +1,27 @@
+#ifndef NEIGHBOR_GRAPH_CACHE_H__
+#define NEIGHBOR_GRAPH_CACHE_H__
+
+#include <string>
+#include <stdint.h>
+
+#include "NeighborGraph.h"
+
+
+//Versioned binary cache files for neighbor graphs. A file holds a header followed by the weight, offset and neighbor arrays (8-byte aligned), so it can be memory-mapped and used by the solver without parsing or copying.
+namespace neighbor_graph_cache
+{
+  const uint32_t CACHE_FORMAT_VERSION = 1;
+  const uint64_t HASH_SEED = 14695981039346656037ULL;
+  
+  //64-bit FNV-1a hash of a byte range, chained through hash
+  uint64_t hashBytes(const void *data, const size_t size, const uint64_t hash = HASH_SEED);
+  template<typename T> uint64_t hashValue(const T &value, const uint64_t hash = HASH_SEED) { return hashBytes(&value, sizeof(T), hash); }
+  
+  std::string getCacheFilename(const std::string &cache_directory, const uint64_t key);
+  //maps the cache file into memory and points graph at it; returns false if the file is missing, truncated, of another version, stored under another key or holds offsets or neighbors outside the graph
+  bool loadNeighborGraph(const std::string &filename, const uint64_t key, NeighborGraph &graph);
+  //writes to a temporary file (unique per process and thread) first and renames it, so readers never see a partial file
+  bool saveNeighborGraph(const std::string &filename, const uint64_t key, const NeighborGraph &graph);
+}
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef PARALLEL_FOR_H__
+#define PARALLEL_FOR_H__
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+
+//per-thread cap on getNumThreads (0 means no cap), so that jobs running side by side on a worker pool split the machine instead of each using all of it
+inline int &getThreadLimit()
+{
+  static thread_local int thread_limit = 0;
+  return thread_limit;
+}
+
+//sets the thread limit of the calling thread to NUM_THREADS (if positive) and restores the previous limit when it goes out of scope, also on exceptions
+class ThreadLimitGuard
+{
+ public:
+  ThreadLimitGuard(const int NUM_THREADS) : PREVIOUS_THREAD_LIMIT_(getThreadLimit())
+  {
+    if (NUM_THREADS > 0)
+      getThreadLimit() = NUM_THREADS;
+  };
+  ~ThreadLimitGuard() { getThreadLimit() = PREVIOUS_THREAD_LIMIT_; };
+  
+ private:
+  const int PREVIOUS_THREAD_LIMIT_;
+  
+  ThreadLimitGuard(const ThreadLimitGuard &);
+  ThreadLimitGuard &operator=(const ThreadLimitGuard &);
+};
+
+//number of worker threads used by parallelFor
+inline int getNumThreads()
+{
+  const int NUM_HARDWARE_THREADS = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+  return getThreadLimit() > 0 ? std::min(getThreadLimit(), NUM_HARDWARE_THREADS) : NUM_HARDWARE_THREADS;
+}
+
+//Splits [begin, end) into NUM_BLOCKS contiguous blocks and calls function(block_index, block_begin, block_end) once per block. Blocks are handed out to NUM_THREADS worker threads in order, so callers which write per-block results and merge them by block index get the same result for any number of threads.
+inline void parallelFor(const int begin, const int end, const int NUM_BLOCKS, const std::function<void(const int, const int, const int)> &function, const int NUM_THREADS = getNumThreads())
+{
+  if (end <= begin || NUM_BLOCKS <= 0)
+    return;
+  const int NUM_ELEMENTS = end - begin;
+  std::atomic<int> next_block_index(0);
+  auto worker = [&]() {
+    while (true) {
+      const int block_index = next_block_index++;
+      if (block_index >= NUM_BLOCKS)
+        break;
+      const int block_begin = begin + static_cast<long>(NUM_ELEMENTS) * block_index / NUM_BLOCKS;
+      const int block_end = begin + static_cast<long>(NUM_ELEMENTS) * (block_index + 1) / NUM_BLOCKS;
+      function(block_index, block_begin, block_end);
+    }
+  };
+
+  const int NUM_WORKERS = std::min(NUM_THREADS, NUM_BLOCKS);
+  std::vector<std::thread> threads;
+  for (int thread_index = 1; thread_index < NUM_WORKERS; thread_index++)
+    threads.push_back(std::thread(worker));
+  worker();
+  for (std::vector<std::thread>::iterator thread_it = threads.begin(); thread_it != threads.end(); thread_it++)
+    thread_it->join();
+}
+
+#endif
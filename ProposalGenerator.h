@@ -3,12 +3,15 @@
 
 #include <vector>
 
+#include "ProposalLabels.h"
+
 
 class ProposalGenerator
 {
  public:
   virtual void setCurrentSolution(const std::vector<long> &current_solution) = 0;
-  virtual std::vector<std::vector<long> > getProposal() const = 0;
+  //fills proposal_labels (owned by the caller and reused across iterations) with the labels proposed for every node
+  virtual void getProposal(ProposalLabels &proposal_labels) const = 0;
   
  protected:
   std::vector<long> current_solution_;
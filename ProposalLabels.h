@@ -0,0 +1,74 @@
+#ifndef PROPOSAL_LABELS_H__
+#define PROPOSAL_LABELS_H__
+
+#include <vector>
+#include <algorithm>
+
+
+//Labels proposed for every node in compressed sparse row form: the labels of node i are at [getLabelBegin(i), getLabelEnd(i)) of one contiguous label array.
+//The object is meant to be owned by the caller and refilled every iteration without reallocation. Generators fill it in two phases: reset() reserves MAX_NUM_LABELS slots per node, every node writes into its own slot (so nodes can be filled in parallel) and sets its label count, then compact() packs the slots.
+//Generators which draw labels from several sources (e.g. one per search radius) can also record which label each source proposed, so that binary fusion can move to one source at a time; duplicates removed from a slot still map every source to its label.
+class ProposalLabels
+{
+ public:
+  ProposalLabels() : offsets_(1, 0), slot_size_(0), num_sources_(0) {};
+
+  void reset(const int NUM_NODES, const int MAX_NUM_LABELS, const int NUM_SOURCES = 0)
+  {
+    slot_size_ = MAX_NUM_LABELS;
+    num_sources_ = NUM_SOURCES;
+    offsets_.assign(NUM_NODES + 1, 0);
+    labels_.resize(static_cast<long>(NUM_NODES) * MAX_NUM_LABELS);
+    source_labels_.assign(static_cast<long>(NUM_NODES) * NUM_SOURCES, -1);
+  };
+  long *getSlot(const int node) { return &labels_[0] + static_cast<long>(node) * slot_size_; };
+  //label proposed by every source (NUM_SOURCES entries, -1 for sources without a label at this node); each must also be in the slot
+  long *getSourceSlot(const int node) { return source_labels_.data() + static_cast<long>(node) * num_sources_; };
+  void setNumLabels(const int node, const int NUM_LABELS) { offsets_[node + 1] = NUM_LABELS; };
+  //slots are moved towards the front in node order, so no slot is overwritten before it has been moved; source labels become label indices first
+  void compact()
+  {
+    const int NUM_NODES = offsets_.size() - 1;
+    for (int node = 0; node < NUM_NODES; node++) {
+      const long *slot = &labels_[0] + static_cast<long>(node) * slot_size_;
+      long *source_slot = source_labels_.data() + static_cast<long>(node) * num_sources_;
+      for (int source = 0; source < num_sources_; source++)
+	if (source_slot[source] >= 0)
+	  source_slot[source] = std::find(slot, slot + offsets_[node + 1], source_slot[source]) - slot;
+      std::copy(slot, slot + offsets_[node + 1], &labels_[0] + offsets_[node]);
+      offsets_[node + 1] += offsets_[node];
+    }
+    labels_.resize(offsets_[NUM_NODES]);
+  };
+
+  int getNumNodes() const { return offsets_.size() - 1; };
+  int getNumLabels() const { return offsets_.back(); };
+  int getNumLabels(const int node) const { return offsets_[node + 1] - offsets_[node]; };
+  int getLabelBegin(const int node) const { return offsets_[node]; };
+  int getLabelEnd(const int node) const { return offsets_[node + 1]; };
+  const long *getLabels(const int node) const { return &labels_[0] + offsets_[node]; };
+  long getLabel(const int node, const int label_index) const { return labels_[offsets_[node] + label_index]; };
+
+  //without recorded sources, source i stands for the i-th label of every node
+  int getNumSources() const { return num_sources_ > 0 ? num_sources_ : slot_size_; };
+  //index of the label proposed by source at node, or -1 if the source proposed none there
+  int getSourceLabelIndex(const int node, const int source) const
+  {
+    if (num_sources_ == 0)
+      return source < getNumLabels(node) ? source : -1;
+    return source_labels_[static_cast<long>(node) * num_sources_ + source];
+  };
+
+  const int *getOffsets() const { return &offsets_[0]; };
+  long getBufferCapacity() const { return offsets_.capacity() * sizeof(int) + (labels_.capacity() + source_labels_.capacity()) * sizeof(long); };
+
+ private:
+  std::vector<int> offsets_;
+  std::vector<long> labels_;
+  //source labels per node while filling, label indices after compact
+  std::vector<long> source_labels_;
+  int slot_size_;
+  int num_sources_;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#include "SolverTelemetry.h"
+
+#include <sstream>
+#include <limits>
+#include <cmath>
+
+using namespace std;
+
+
+namespace
+{
+  //JSON has no infinities; unknown values (e.g. lower bounds of fusions without one) become null
+  string toJsonNumber(const double value)
+  {
+    if (std::isfinite(value) == false || fabs(value) == numeric_limits<double>::max())
+      return "null";
+    stringstream value_str;
+    value_str.precision(12);
+    value_str << value;
+    return value_str.str();
+  }
+}
+
+void JsonLinesTelemetrySink::recordFusion(const FusionTelemetry &fusion_telemetry)
+{
+  stringstream line_str;
+  line_str << "{\"type\":\"fusion\",\"solve\":" << fusion_telemetry.solve_index << ",\"iteration\":" << fusion_telemetry.iteration;
+  line_str << ",\"energy\":" << toJsonNumber(fusion_telemetry.energy) << ",\"lower_bound\":" << toJsonNumber(fusion_telemetry.lower_bound) << ",\"accepted\":" << (fusion_telemetry.accepted ? "true" : "false");
+  line_str << ",\"num_nodes\":" << fusion_telemetry.num_nodes << ",\"num_edges\":" << fusion_telemetry.num_edges << ",\"num_labels\":" << fusion_telemetry.num_labels;
+  line_str << ",\"proposal_seconds\":" << toJsonNumber(fusion_telemetry.proposal_seconds) << ",\"unary_seconds\":" << toJsonNumber(fusion_telemetry.unary_seconds) << ",\"pairwise_seconds\":" << toJsonNumber(fusion_telemetry.pairwise_seconds);
+  line_str << ",\"optimization_seconds\":" << toJsonNumber(fusion_telemetry.optimization_seconds) << ",\"decode_seconds\":" << toJsonNumber(fusion_telemetry.decode_seconds);
+  line_str << ",\"buffer_capacity\":" << fusion_telemetry.buffer_capacity << ",\"buffers_grown\":" << (fusion_telemetry.buffers_grown ? "true" : "false") << "}\n";
+  out_str_ << line_str.str() << flush;
+}
+
+void JsonLinesTelemetrySink::recordSolve(const SolveTelemetry &solve_telemetry)
+{
+  stringstream line_str;
+  line_str << "{\"type\":\"solve\",\"solve\":" << solve_telemetry.solve_index << ",\"num_fusions\":" << solve_telemetry.num_fusions;
+  line_str << ",\"energy\":" << toJsonNumber(solve_telemetry.energy) << ",\"stop_reason\":\"" << solve_telemetry.stop_reason << "\",\"seconds\":" << toJsonNumber(solve_telemetry.seconds) << "}\n";
+  out_str_ << line_str.str() << flush;
+}
@@ -0,0 +1,73 @@
+#ifndef SOLVER_TELEMETRY_H__
+#define SOLVER_TELEMETRY_H__
+
+#include <chrono>
+#include <ostream>
+#include <string>
+
+
+//seconds since lap_start; lap_start is moved to now, so consecutive calls time consecutive phases
+inline double calcLapSeconds(std::chrono::steady_clock::time_point &lap_start)
+{
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  const double seconds = std::chrono::duration<double>(now - lap_start).count();
+  lap_start = now;
+  return seconds;
+}
+
+//One fusion of FusionSpaceSolver::solve. lower_bound is -numeric_limits<double>::max() for fusion methods without one (binary and tiled fusion). The MRF size is that of the fused problem (num_edges counts edges with some positive cost, summed over all moves for graph cut fusion). optimization_seconds is the time spent in TRW-S (or max-flow for graph cut fusion). buffer_capacity is the size of the solver's persistent buffers after the fusion and buffers_grown tells whether the fusion had to grow them.
+struct FusionTelemetry
+{
+  int solve_index;
+  int iteration;
+  double energy;
+  double lower_bound;
+  bool accepted;
+  int num_nodes;
+  long num_edges;
+  long num_labels;
+  double proposal_seconds;
+  double unary_seconds;
+  double pairwise_seconds;
+  double optimization_seconds;
+  double decode_seconds;
+  long buffer_capacity;
+  bool buffers_grown;
+  
+  FusionTelemetry() : solve_index(0), iteration(0), energy(0), lower_bound(0), accepted(false), num_nodes(0), num_edges(0), num_labels(0), proposal_seconds(0), unary_seconds(0), pairwise_seconds(0), optimization_seconds(0), decode_seconds(0), buffer_capacity(0), buffers_grown(false) {};
+};
+
+struct SolveTelemetry
+{
+  int solve_index;
+  int num_fusions;
+  double energy;
+  std::string stop_reason;
+  double seconds;
+  
+  SolveTelemetry() : solve_index(0), num_fusions(0), energy(0), seconds(0) {};
+};
+
+//receives one record per fusion and one per solve (after its fusions); records are emitted from the thread calling solve
+class TelemetrySink
+{
+ public:
+  virtual ~TelemetrySink() {};
+  virtual void recordFusion(const FusionTelemetry &fusion_telemetry) = 0;
+  virtual void recordSolve(const SolveTelemetry &solve_telemetry) = 0;
+};
+
+//writes every record as one JSON object per line ("type" is "fusion" or "solve"); the stream is owned by the caller
+class JsonLinesTelemetrySink : public TelemetrySink
+{
+ public:
+  JsonLinesTelemetrySink(std::ostream &out_str) : out_str_(out_str) {};
+  
+  virtual void recordFusion(const FusionTelemetry &fusion_telemetry);
+  virtual void recordSolve(const SolveTelemetry &solve_telemetry);
+  
+ private:
+  std::ostream &out_str_;
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "StripGuidedFilter.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "ParallelFor.h"
+#include "Symmetric3x3.h"
+
+
+using namespace std;
+
+namespace
+{
+  const int NUM_MOMENTS = GUIDED_ALPHA_NUM_MOMENTS;
+  const int NUM_COEFFICIENTS = GUIDED_ALPHA_NUM_COEFFICIENTS;
+  
+  //window means of one row from running column sums
+  void calcRowMeans(const vector<double> &column_sums, const int NUM_CHANNELS, const int IMAGE_WIDTH, const int RADIUS, const int NUM_WINDOW_ROWS, vector<double> &window_sums, float *means)
+  {
+    fill(window_sums.begin(), window_sums.end(), 0);
+    for (int x = 0; x < min(RADIUS, IMAGE_WIDTH); x++)
+      for (int c = 0; c < NUM_CHANNELS; c++)
+	window_sums[c] += column_sums[x * NUM_CHANNELS + c];
+    for (int x = 0; x < IMAGE_WIDTH; x++) {
+      if (x + RADIUS < IMAGE_WIDTH)
+	for (int c = 0; c < NUM_CHANNELS; c++)
+	  window_sums[c] += column_sums[(x + RADIUS) * NUM_CHANNELS + c];
+      if (x - RADIUS - 1 >= 0)
+	for (int c = 0; c < NUM_CHANNELS; c++)
+	  window_sums[c] -= column_sums[(x - RADIUS - 1) * NUM_CHANNELS + c];
+      const double AREA = NUM_WINDOW_ROWS * (min(x + RADIUS, IMAGE_WIDTH - 1) - max(x - RADIUS, 0) + 1);
+      for (int c = 0; c < NUM_CHANNELS; c++)
+	means[x * NUM_CHANNELS + c] = window_sums[c] / AREA;
+    }
+  }
+}
+
+void calcGuidedAlphaMomentRow(const unsigned char *image, const long IMAGE_STEP, const vector<float> &alpha_values, const vector<float> &alpha_confidences, const int IMAGE_WIDTH, const int y, float *moments)
+{
+  const unsigned char *image_row = image + y * IMAGE_STEP;
+  for (int x = 0; x < IMAGE_WIDTH; x++) {
+    const int pixel = y * IMAGE_WIDTH + x;
+    float *pixel_moments = moments + x * NUM_MOMENTS;
+    double color[3];
+    for (int c = 0; c < 3; c++)
+      color[c] = image_row[x * 3 + c] / 256.0;
+    const double confidence = alpha_confidences[pixel];
+    const double weighted_alpha = confidence * alpha_values[pixel];
+    const double quantized_confidence = floor(min(confidence * 256, 255.0)) / 256;
+    pixel_moments[0] = confidence;
+    pixel_moments[10] = weighted_alpha;
+    pixel_moments[23] = quantized_confidence;
+    int moment_index = 0;
+    for (int c_1 = 0; c_1 < 3; c_1++) {
+      pixel_moments[1 + c_1] = confidence * color[c_1];
+      pixel_moments[11 + c_1] = weighted_alpha * color[c_1];
+      pixel_moments[14 + c_1] = color[c_1];
+      pixel_moments[24 + c_1] = quantized_confidence * color[c_1];
+      for (int c_2 = c_1; c_2 < 3; c_2++) {
+	pixel_moments[4 + moment_index] = confidence * color[c_1] * color[c_2];
+	pixel_moments[17 + moment_index] = color[c_1] * color[c_2];
+	moment_index++;
+      }
+    }
+  }
+}
+
+void calcGuidedAlphaCoefficientRow(const float *moment_means, const int IMAGE_WIDTH, const double EPSILON, float *coefficients)
+{
+  const int BATCH_SIZE = SYMMETRIC_3X3_BATCH_SIZE;
+  double weighted_vars[6 * BATCH_SIZE], vars[6 * BATCH_SIZE];
+  double weighted_covariances[3 * BATCH_SIZE], covariances[3 * BATCH_SIZE];
+  double weighted_a_values[3 * BATCH_SIZE], a_values[3 * BATCH_SIZE];
+  for (int batch_begin = 0; batch_begin < IMAGE_WIDTH; batch_begin += BATCH_SIZE) {
+    const int NUM_BATCH_PIXELS = min(BATCH_SIZE, IMAGE_WIDTH - batch_begin);
+    for (int index = 0; index < NUM_BATCH_PIXELS; index++) {
+      const float *pixel_means = moment_means + (batch_begin + index) * NUM_MOMENTS;
+      const double confidence_mean = pixel_means[0];
+      const double weighted_alpha_mean = pixel_means[10] / confidence_mean;
+      int moment_index = 0;
+      for (int c_1 = 0; c_1 < 3; c_1++) {
+	for (int c_2 = c_1; c_2 < 3; c_2++) {
+	  const int PLANE = getSymmetric3x3Plane(c_1, c_2) * BATCH_SIZE + index;
+	  weighted_vars[PLANE] = pixel_means[4 + moment_index] / confidence_mean - pixel_means[1 + c_1] / confidence_mean * (pixel_means[1 + c_2] / confidence_mean) + EPSILON * (c_1 == c_2);
+	  vars[PLANE] = pixel_means[17 + moment_index] - pixel_means[14 + c_1] * pixel_means[14 + c_2] + EPSILON * (c_1 == c_2);
+	  moment_index++;
+	}
+	weighted_covariances[c_1 * BATCH_SIZE + index] = pixel_means[11 + c_1] / confidence_mean - pixel_means[1 + c_1] / confidence_mean * weighted_alpha_mean;
+	covariances[c_1 * BATCH_SIZE + index] = pixel_means[24 + c_1] - pixel_means[14 + c_1] * pixel_means[23];
+      }
+    }
+    solveSymmetric3x3(NUM_BATCH_PIXELS, weighted_vars, weighted_covariances, weighted_a_values);
+    solveSymmetric3x3(NUM_BATCH_PIXELS, vars, covariances, a_values);
+    for (int index = 0; index < NUM_BATCH_PIXELS; index++) {
+      const float *pixel_means = moment_means + (batch_begin + index) * NUM_MOMENTS;
+      float *pixel_coefficients = coefficients + (batch_begin + index) * NUM_COEFFICIENTS;
+      double weighted_b = pixel_means[10] / pixel_means[0];
+      double b = pixel_means[23];
+      for (int c = 0; c < 3; c++) {
+	pixel_coefficients[c] = weighted_a_values[c * BATCH_SIZE + index];
+	pixel_coefficients[4 + c] = a_values[c * BATCH_SIZE + index];
+	weighted_b -= weighted_a_values[c * BATCH_SIZE + index] * pixel_means[1 + c] / pixel_means[0];
+	b -= a_values[c * BATCH_SIZE + index] * pixel_means[14 + c];
+      }
+      pixel_coefficients[3] = weighted_b;
+      pixel_coefficients[7] = b;
+    }
+  }
+}
+
+void calcGuidedAlphaOutputRow(const unsigned char *image_row, const float *coefficient_means, const int IMAGE_WIDTH, float *alphas, float *confidences)
+{
+  for (int x = 0; x < IMAGE_WIDTH; x++) {
+    const float *pixel_coefficients = coefficient_means + x * NUM_COEFFICIENTS;
+    double alpha = pixel_coefficients[3];
+    double confidence = pixel_coefficients[7];
+    for (int c = 0; c < 3; c++) {
+      alpha += pixel_coefficients[c] * (image_row[x * 3 + c] / 256.0);
+      confidence += pixel_coefficients[4 + c] * (image_row[x * 3 + c] / 256.0);
+    }
+    alphas[x] = max(min(alpha, 1.0), 0.0);
+    confidences[x] = max(min(floor(confidence * 256 + 0.5), 255.0), 0.0) / 256;
+  }
+}
+
+void calcGuidedAlphaRows(const unsigned char *image, const long IMAGE_STEP, const vector<float> &alpha_values, const vector<float> &alpha_confidences, const int IMAGE_WIDTH, const int IMAGE_HEIGHT, const int RADIUS, const double EPSILON, const function<void(const int, const float *, const float *)> &row_function)
+{
+  const int NUM_RING_ROWS = 2 * RADIUS + 1;
+  //every band warms up on the 2 * RADIUS rows above it, so bands are not made smaller than that
+  const int NUM_BANDS = max(min(getNumThreads(), IMAGE_HEIGHT / max(4 * RADIUS, 1)), 1);
+  parallelFor(0, IMAGE_HEIGHT, NUM_BANDS, [&](const int, const int first_row, const int last_row) {
+      vector<float> moment_row(IMAGE_WIDTH * NUM_MOMENTS);
+      vector<double> moment_column_sums(IMAGE_WIDTH * NUM_MOMENTS, 0);
+      vector<float> moment_means(IMAGE_WIDTH * NUM_MOMENTS);
+      vector<double> moment_window_sums(NUM_MOMENTS);
+      vector<float> coefficient_ring(static_cast<long>(NUM_RING_ROWS) * IMAGE_WIDTH * NUM_COEFFICIENTS);
+      vector<double> coefficient_column_sums(IMAGE_WIDTH * NUM_COEFFICIENTS, 0);
+      vector<float> coefficient_means(IMAGE_WIDTH * NUM_COEFFICIENTS);
+      vector<double> coefficient_window_sums(NUM_COEFFICIENTS);
+      vector<float> alphas(IMAGE_WIDTH), confidences(IMAGE_WIDTH);
+      auto update_moment_column_sums = [&](const int y, const double sign) {
+	calcGuidedAlphaMomentRow(image, IMAGE_STEP, alpha_values, alpha_confidences, IMAGE_WIDTH, y, &moment_row[0]);
+	for (int index = 0; index < IMAGE_WIDTH * NUM_MOMENTS; index++)
+	  moment_column_sums[index] += sign * moment_row[index];
+      };
+  
+      //coefficient rows [FIRST_COEFFICIENT_ROW, END_COEFFICIENT_ROW) cover the windows of the output rows
+      const int FIRST_COEFFICIENT_ROW = max(first_row - RADIUS, 0);
+      const int END_COEFFICIENT_ROW = min(last_row + RADIUS, IMAGE_HEIGHT);
+      for (int y = max(FIRST_COEFFICIENT_ROW - RADIUS, 0); y < min(FIRST_COEFFICIENT_ROW + RADIUS, IMAGE_HEIGHT); y++)
+	update_moment_column_sums(y, 1);
+      for (int y = FIRST_COEFFICIENT_ROW; y - RADIUS < last_row; y++) {
+	float *ring_row = &coefficient_ring[static_cast<long>(y % NUM_RING_ROWS) * IMAGE_WIDTH * NUM_COEFFICIENTS];
+	//the row leaving the coefficient window occupies the ring slot of row y
+	if (y - NUM_RING_ROWS >= FIRST_COEFFICIENT_ROW)
+	  for (int index = 0; index < IMAGE_WIDTH * NUM_COEFFICIENTS; index++)
+	    coefficient_column_sums[index] -= ring_row[index];
+	if (y < END_COEFFICIENT_ROW) {
+	  if (y + RADIUS < IMAGE_HEIGHT)
+	    update_moment_column_sums(y + RADIUS, 1);
+	  if (y > FIRST_COEFFICIENT_ROW && y - RADIUS - 1 >= 0)
+	    update_moment_column_sums(y - RADIUS - 1, -1);
+	  const int NUM_MOMENT_WINDOW_ROWS = min(y + RADIUS, IMAGE_HEIGHT - 1) - max(y - RADIUS, 0) + 1;
+	  calcRowMeans(moment_column_sums, NUM_MOMENTS, IMAGE_WIDTH, RADIUS, NUM_MOMENT_WINDOW_ROWS, moment_window_sums, &moment_means[0]);
+	  calcGuidedAlphaCoefficientRow(&moment_means[0], IMAGE_WIDTH, EPSILON, ring_row);
+	  for (int index = 0; index < IMAGE_WIDTH * NUM_COEFFICIENTS; index++)
+	    coefficient_column_sums[index] += ring_row[index];
+	}
+  
+	const int OUTPUT_ROW = y - RADIUS;
+	if (OUTPUT_ROW < first_row)
+	  continue;
+	const int NUM_COEFFICIENT_WINDOW_ROWS = min(OUTPUT_ROW + RADIUS, IMAGE_HEIGHT - 1) - max(OUTPUT_ROW - RADIUS, 0) + 1;
+	calcRowMeans(coefficient_column_sums, NUM_COEFFICIENTS, IMAGE_WIDTH, RADIUS, NUM_COEFFICIENT_WINDOW_ROWS, coefficient_window_sums, &coefficient_means[0]);
+	calcGuidedAlphaOutputRow(image + OUTPUT_ROW * IMAGE_STEP, &coefficient_means[0], IMAGE_WIDTH, &alphas[0], &confidences[0]);
+	row_function(OUTPUT_ROW, &alphas[0], &confidences[0]);
+      }
+    }, NUM_BANDS);
+}
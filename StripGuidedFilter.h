@@ -0,0 +1,27 @@
+#ifndef STRIP_GUIDED_FILTER_H__
+#define STRIP_GUIDED_FILTER_H__
+
+#include <vector>
+#include <functional>
+
+
+//The guided filtering of calcAlphaImage and calcAlphaImageInStrips is built from three row kernels, so that both variants only differ in how window means are summed.
+//per pixel: w, w * I_c, w * I_c1 * I_c2 (c1 <= c2), w * alpha, w * alpha * I_c for the confidence-weighted filter of alpha, then I_c, I_c1 * I_c2 (c1 <= c2), p, p * I_c for the plain filter of the quantized confidence p; colors are divided by 256
+const int GUIDED_ALPHA_NUM_MOMENTS = 27;
+//a_c and b of both filters
+const int GUIDED_ALPHA_NUM_COEFFICIENTS = 8;
+//moments of row y, GUIDED_ALPHA_NUM_MOMENTS interleaved per pixel
+void calcGuidedAlphaMomentRow(const unsigned char *image, const long IMAGE_STEP, const std::vector<float> &alpha_values, const std::vector<float> &alpha_confidences, const int IMAGE_WIDTH, const int y, float *moments);
+//coefficients of one row from the window means of its moments; EPSILON regularizes both covariance systems
+void calcGuidedAlphaCoefficientRow(const float *moment_means, const int IMAGE_WIDTH, const double EPSILON, float *coefficients);
+//alphas (clamped to [0, 1]) and 8-bit confidences (divided by 256) of one image row from the window means of its coefficients
+void calcGuidedAlphaOutputRow(const unsigned char *image_row, const float *coefficient_means, const int IMAGE_WIDTH, float *alphas, float *confidences);
+
+//One radius of the guided filtering, evaluated row by row so that no full-image intermediate is kept.
+//image is 8-bit BGR with IMAGE_STEP bytes per row; alpha_values and alpha_confidences hold one value per pixel. For every row, row_function(y, alphas, confidences) receives
+//- the alpha of the confidence-weighted guided filter of alpha_values (clamped to [0, 1]) and
+//- the 8-bit confidences (divided by 256) guided-filtered with the same radius and epsilon (the confidence image is quantized like drawValuesImage).
+//Rows are split into one band per thread, so row_function is called concurrently for different rows. Each band keeps running column sums of 27 moment channels and a ring of 2 * RADIUS + 1 rows of 8 filter coefficients, i.e. memory is O(IMAGE_WIDTH * RADIUS) per thread; windows are clipped at the image border as in calcBoxMeans.
+void calcGuidedAlphaRows(const unsigned char *image, const long IMAGE_STEP, const std::vector<float> &alpha_values, const std::vector<float> &alpha_confidences, const int IMAGE_WIDTH, const int IMAGE_HEIGHT, const int RADIUS, const double EPSILON, const std::function<void(const int, const float *, const float *)> &row_function);
+
+#endif
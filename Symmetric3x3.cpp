@@ -0,0 +1,122 @@
+#include "Symmetric3x3.h"
+
+#if defined(__AVX__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+
+void invertSymmetric3x3(const int COUNT, const double *matrices, double *inverses)
+{
+  const int STRIDE = SYMMETRIC_3X3_BATCH_SIZE;
+  const double *a00 = matrices, *a01 = matrices + STRIDE, *a02 = matrices + 2 * STRIDE, *a11 = matrices + 3 * STRIDE, *a12 = matrices + 4 * STRIDE, *a22 = matrices + 5 * STRIDE;
+  int index = 0;
+#if defined(__AVX512F__)
+  for (; index + 8 <= COUNT; index += 8) {
+    const __m512d m00 = _mm512_loadu_pd(a00 + index), m01 = _mm512_loadu_pd(a01 + index), m02 = _mm512_loadu_pd(a02 + index);
+    const __m512d m11 = _mm512_loadu_pd(a11 + index), m12 = _mm512_loadu_pd(a12 + index), m22 = _mm512_loadu_pd(a22 + index);
+    const __m512d c00 = _mm512_sub_pd(_mm512_mul_pd(m11, m22), _mm512_mul_pd(m12, m12));
+    const __m512d c01 = _mm512_sub_pd(_mm512_mul_pd(m02, m12), _mm512_mul_pd(m01, m22));
+    const __m512d c02 = _mm512_sub_pd(_mm512_mul_pd(m01, m12), _mm512_mul_pd(m02, m11));
+    const __m512d c11 = _mm512_sub_pd(_mm512_mul_pd(m00, m22), _mm512_mul_pd(m02, m02));
+    const __m512d c12 = _mm512_sub_pd(_mm512_mul_pd(m01, m02), _mm512_mul_pd(m00, m12));
+    const __m512d c22 = _mm512_sub_pd(_mm512_mul_pd(m00, m11), _mm512_mul_pd(m01, m01));
+    const __m512d determinant = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(m00, c00), _mm512_mul_pd(m01, c01)), _mm512_mul_pd(m02, c02));
+    const __m512d inverse_determinant = _mm512_div_pd(_mm512_set1_pd(1.0), determinant);
+    _mm512_storeu_pd(inverses + index, _mm512_mul_pd(c00, inverse_determinant));
+    _mm512_storeu_pd(inverses + STRIDE + index, _mm512_mul_pd(c01, inverse_determinant));
+    _mm512_storeu_pd(inverses + 2 * STRIDE + index, _mm512_mul_pd(c02, inverse_determinant));
+    _mm512_storeu_pd(inverses + 3 * STRIDE + index, _mm512_mul_pd(c11, inverse_determinant));
+    _mm512_storeu_pd(inverses + 4 * STRIDE + index, _mm512_mul_pd(c12, inverse_determinant));
+    _mm512_storeu_pd(inverses + 5 * STRIDE + index, _mm512_mul_pd(c22, inverse_determinant));
+  }
+#elif defined(__AVX__)
+  for (; index + 4 <= COUNT; index += 4) {
+    const __m256d m00 = _mm256_loadu_pd(a00 + index), m01 = _mm256_loadu_pd(a01 + index), m02 = _mm256_loadu_pd(a02 + index);
+    const __m256d m11 = _mm256_loadu_pd(a11 + index), m12 = _mm256_loadu_pd(a12 + index), m22 = _mm256_loadu_pd(a22 + index);
+    const __m256d c00 = _mm256_sub_pd(_mm256_mul_pd(m11, m22), _mm256_mul_pd(m12, m12));
+    const __m256d c01 = _mm256_sub_pd(_mm256_mul_pd(m02, m12), _mm256_mul_pd(m01, m22));
+    const __m256d c02 = _mm256_sub_pd(_mm256_mul_pd(m01, m12), _mm256_mul_pd(m02, m11));
+    const __m256d c11 = _mm256_sub_pd(_mm256_mul_pd(m00, m22), _mm256_mul_pd(m02, m02));
+    const __m256d c12 = _mm256_sub_pd(_mm256_mul_pd(m01, m02), _mm256_mul_pd(m00, m12));
+    const __m256d c22 = _mm256_sub_pd(_mm256_mul_pd(m00, m11), _mm256_mul_pd(m01, m01));
+    const __m256d determinant = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(m00, c00), _mm256_mul_pd(m01, c01)), _mm256_mul_pd(m02, c02));
+    const __m256d inverse_determinant = _mm256_div_pd(_mm256_set1_pd(1.0), determinant);
+    _mm256_storeu_pd(inverses + index, _mm256_mul_pd(c00, inverse_determinant));
+    _mm256_storeu_pd(inverses + STRIDE + index, _mm256_mul_pd(c01, inverse_determinant));
+    _mm256_storeu_pd(inverses + 2 * STRIDE + index, _mm256_mul_pd(c02, inverse_determinant));
+    _mm256_storeu_pd(inverses + 3 * STRIDE + index, _mm256_mul_pd(c11, inverse_determinant));
+    _mm256_storeu_pd(inverses + 4 * STRIDE + index, _mm256_mul_pd(c12, inverse_determinant));
+    _mm256_storeu_pd(inverses + 5 * STRIDE + index, _mm256_mul_pd(c22, inverse_determinant));
+  }
+#endif
+  for (; index < COUNT; index++) {
+    const double c00 = a11[index] * a22[index] - a12[index] * a12[index];
+    const double c01 = a02[index] * a12[index] - a01[index] * a22[index];
+    const double c02 = a01[index] * a12[index] - a02[index] * a11[index];
+    const double c11 = a00[index] * a22[index] - a02[index] * a02[index];
+    const double c12 = a01[index] * a02[index] - a00[index] * a12[index];
+    const double c22 = a00[index] * a11[index] - a01[index] * a01[index];
+    const double inverse_determinant = 1 / (a00[index] * c00 + a01[index] * c01 + a02[index] * c02);
+    inverses[index] = c00 * inverse_determinant;
+    inverses[STRIDE + index] = c01 * inverse_determinant;
+    inverses[2 * STRIDE + index] = c02 * inverse_determinant;
+    inverses[3 * STRIDE + index] = c11 * inverse_determinant;
+    inverses[4 * STRIDE + index] = c12 * inverse_determinant;
+    inverses[5 * STRIDE + index] = c22 * inverse_determinant;
+  }
+}
+
+void solveSymmetric3x3(const int COUNT, const double *matrices, const double *vectors, double *solutions)
+{
+  const int STRIDE = SYMMETRIC_3X3_BATCH_SIZE;
+  const double *a00 = matrices, *a01 = matrices + STRIDE, *a02 = matrices + 2 * STRIDE, *a11 = matrices + 3 * STRIDE, *a12 = matrices + 4 * STRIDE, *a22 = matrices + 5 * STRIDE;
+  const double *b0 = vectors, *b1 = vectors + STRIDE, *b2 = vectors + 2 * STRIDE;
+  int index = 0;
+#if defined(__AVX512F__)
+  for (; index + 8 <= COUNT; index += 8) {
+    const __m512d m00 = _mm512_loadu_pd(a00 + index), m01 = _mm512_loadu_pd(a01 + index), m02 = _mm512_loadu_pd(a02 + index);
+    const __m512d m11 = _mm512_loadu_pd(a11 + index), m12 = _mm512_loadu_pd(a12 + index), m22 = _mm512_loadu_pd(a22 + index);
+    const __m512d c00 = _mm512_sub_pd(_mm512_mul_pd(m11, m22), _mm512_mul_pd(m12, m12));
+    const __m512d c01 = _mm512_sub_pd(_mm512_mul_pd(m02, m12), _mm512_mul_pd(m01, m22));
+    const __m512d c02 = _mm512_sub_pd(_mm512_mul_pd(m01, m12), _mm512_mul_pd(m02, m11));
+    const __m512d c11 = _mm512_sub_pd(_mm512_mul_pd(m00, m22), _mm512_mul_pd(m02, m02));
+    const __m512d c12 = _mm512_sub_pd(_mm512_mul_pd(m01, m02), _mm512_mul_pd(m00, m12));
+    const __m512d c22 = _mm512_sub_pd(_mm512_mul_pd(m00, m11), _mm512_mul_pd(m01, m01));
+    const __m512d determinant = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(m00, c00), _mm512_mul_pd(m01, c01)), _mm512_mul_pd(m02, c02));
+    const __m512d inverse_determinant = _mm512_div_pd(_mm512_set1_pd(1.0), determinant);
+    const __m512d v0 = _mm512_loadu_pd(b0 + index), v1 = _mm512_loadu_pd(b1 + index), v2 = _mm512_loadu_pd(b2 + index);
+    _mm512_storeu_pd(solutions + index, _mm512_mul_pd(_mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(c00, v0), _mm512_mul_pd(c01, v1)), _mm512_mul_pd(c02, v2)), inverse_determinant));
+    _mm512_storeu_pd(solutions + STRIDE + index, _mm512_mul_pd(_mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(c01, v0), _mm512_mul_pd(c11, v1)), _mm512_mul_pd(c12, v2)), inverse_determinant));
+    _mm512_storeu_pd(solutions + 2 * STRIDE + index, _mm512_mul_pd(_mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(c02, v0), _mm512_mul_pd(c12, v1)), _mm512_mul_pd(c22, v2)), inverse_determinant));
+  }
+#elif defined(__AVX__)
+  for (; index + 4 <= COUNT; index += 4) {
+    const __m256d m00 = _mm256_loadu_pd(a00 + index), m01 = _mm256_loadu_pd(a01 + index), m02 = _mm256_loadu_pd(a02 + index);
+    const __m256d m11 = _mm256_loadu_pd(a11 + index), m12 = _mm256_loadu_pd(a12 + index), m22 = _mm256_loadu_pd(a22 + index);
+    const __m256d c00 = _mm256_sub_pd(_mm256_mul_pd(m11, m22), _mm256_mul_pd(m12, m12));
+    const __m256d c01 = _mm256_sub_pd(_mm256_mul_pd(m02, m12), _mm256_mul_pd(m01, m22));
+    const __m256d c02 = _mm256_sub_pd(_mm256_mul_pd(m01, m12), _mm256_mul_pd(m02, m11));
+    const __m256d c11 = _mm256_sub_pd(_mm256_mul_pd(m00, m22), _mm256_mul_pd(m02, m02));
+    const __m256d c12 = _mm256_sub_pd(_mm256_mul_pd(m01, m02), _mm256_mul_pd(m00, m12));
+    const __m256d c22 = _mm256_sub_pd(_mm256_mul_pd(m00, m11), _mm256_mul_pd(m01, m01));
+    const __m256d determinant = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(m00, c00), _mm256_mul_pd(m01, c01)), _mm256_mul_pd(m02, c02));
+    const __m256d inverse_determinant = _mm256_div_pd(_mm256_set1_pd(1.0), determinant);
+    const __m256d v0 = _mm256_loadu_pd(b0 + index), v1 = _mm256_loadu_pd(b1 + index), v2 = _mm256_loadu_pd(b2 + index);
+    _mm256_storeu_pd(solutions + index, _mm256_mul_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(c00, v0), _mm256_mul_pd(c01, v1)), _mm256_mul_pd(c02, v2)), inverse_determinant));
+    _mm256_storeu_pd(solutions + STRIDE + index, _mm256_mul_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(c01, v0), _mm256_mul_pd(c11, v1)), _mm256_mul_pd(c12, v2)), inverse_determinant));
+    _mm256_storeu_pd(solutions + 2 * STRIDE + index, _mm256_mul_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(c02, v0), _mm256_mul_pd(c12, v1)), _mm256_mul_pd(c22, v2)), inverse_determinant));
+  }
+#endif
+  for (; index < COUNT; index++) {
+    const double c00 = a11[index] * a22[index] - a12[index] * a12[index];
+    const double c01 = a02[index] * a12[index] - a01[index] * a22[index];
+    const double c02 = a01[index] * a12[index] - a02[index] * a11[index];
+    const double c11 = a00[index] * a22[index] - a02[index] * a02[index];
+    const double c12 = a01[index] * a02[index] - a00[index] * a12[index];
+    const double c22 = a00[index] * a11[index] - a01[index] * a01[index];
+    const double inverse_determinant = 1 / (a00[index] * c00 + a01[index] * c01 + a02[index] * c02);
+    solutions[index] = (c00 * b0[index] + c01 * b1[index] + c02 * b2[index]) * inverse_determinant;
+    solutions[STRIDE + index] = (c01 * b0[index] + c11 * b1[index] + c12 * b2[index]) * inverse_determinant;
+    solutions[2 * STRIDE + index] = (c02 * b0[index] + c12 * b1[index] + c22 * b2[index]) * inverse_determinant;
+  }
+}
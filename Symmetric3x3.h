@@ -0,0 +1,19 @@
+#ifndef SYMMETRIC_3X3_H__
+#define SYMMETRIC_3X3_H__
+
+
+//Batched kernels for symmetric 3x3 systems in structure-of-arrays layout. A batch of up to SYMMETRIC_3X3_BATCH_SIZE matrices is stored as the six planes a00, a01, a02, a11, a12, a22 (element of matrix i in plane k at k * SYMMETRIC_3X3_BATCH_SIZE + i), vectors as three planes. Batches fit on the stack. Both kernels use the closed-form adjugate and work on 8 (AVX-512) or 4 (AVX) matrices per instruction where the build enables them; singular matrices give infinite or NaN results.
+const int SYMMETRIC_3X3_BATCH_SIZE = 64;
+
+//plane of element (c_1, c_2)
+inline int getSymmetric3x3Plane(const int c_1, const int c_2)
+{
+  return c_1 <= c_2 ? c_1 * (5 - c_1) / 2 + c_2 : c_2 * (5 - c_2) / 2 + c_1;
+}
+
+//inverses of the first COUNT matrices, in the same layout
+void invertSymmetric3x3(const int COUNT, const double *matrices, double *inverses);
+//solutions x of matrix x = vector for the first COUNT systems
+void solveSymmetric3x3(const int COUNT, const double *matrices, const double *vectors, double *solutions);
+
+#endif
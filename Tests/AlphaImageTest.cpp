@@ -0,0 +1,49 @@
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <opencv2/core/core.hpp>
+
+#include "AlphaImage.h"
+#include "TestUtils.h"
+#include "MattingTestUtils.h"
+
+
+using namespace std;
+using namespace cv;
+
+//both variants run the same row kernels and only sum window means in a different order, so they may differ by a rounding step at most
+void checkStripsMatchFullImage(const int NUM_WINDOW_RADIUSES)
+{
+  Mat image, trimap;
+  createMattingProblem(96, 80, image, trimap);
+  srand(0);
+  const Mat alpha_image = calcAlphaImage(image, trimap, NULL, NUM_WINDOW_RADIUSES);
+  srand(0);
+  const Mat strip_alpha_image = calcAlphaImageInStrips(image, trimap, NULL, NUM_WINDOW_RADIUSES);
+  CHECK(strip_alpha_image.rows == image.rows && strip_alpha_image.cols == image.cols && strip_alpha_image.type() == CV_8UC1);
+  if (alpha_image.rows != strip_alpha_image.rows || alpha_image.cols != strip_alpha_image.cols)
+    return;
+  
+  int max_difference = 0;
+  long difference_sum = 0;
+  for (int y = 0; y < image.rows; y++) {
+    for (int x = 0; x < image.cols; x++) {
+      const int difference = abs(alpha_image.at<uchar>(y, x) - strip_alpha_image.at<uchar>(y, x));
+      max_difference = max(max_difference, difference);
+      difference_sum += difference;
+    }
+  }
+  CHECK(max_difference <= 1);
+  CHECK(difference_sum <= image.rows * image.cols / 100);
+  
+  //known pixels keep their trimap alpha
+  CHECK(strip_alpha_image.at<uchar>(image.rows / 2, image.cols / 2) == 255);
+  CHECK(strip_alpha_image.at<uchar>(0, 0) == 0);
+}
+
+int main()
+{
+  checkStripsMatchFullImage(1);
+  checkStripsMatchFullImage(3);
+  return getNumFailures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <opencv2/core/core.hpp>
+
+#include "AlphaMattingSession.h"
+#include "TestUtils.h"
+#include "MattingTestUtils.h"
+
+
+using namespace std;
+using namespace cv;
+
+void testInvalidInputs()
+{
+  Mat image, trimap;
+  createMattingProblem(48, 40, image, trimap);
+  
+  MattingSession empty_session(Mat(), trimap);
+  CHECK(empty_session.isValid() == false);
+  CHECK(empty_session.updateTrimap(trimap, Rect(0, 0, 4, 4)) == false);
+  
+  MattingSession mismatched_session(image, trimap(Rect(0, 0, 40, 40)).clone());
+  CHECK(mismatched_session.isValid() == false);
+  
+  MattingSession background_session(image, Mat::zeros(image.rows, image.cols, CV_8UC1));
+  CHECK(background_session.isValid() == false);
+  CHECK(background_session.getAlpha().empty());
+}
+
+//An edit widens the unknown band on one side of the disc. The session fuses only around the edit, so pixels away from it keep their alpha, and the result stays close to a session started from the edited trimap.
+void testUpdateMatchesFullSolve()
+{
+  Mat image, trimap;
+  createMattingProblem(64, 64, image, trimap);
+  SessionOptions options;
+  options.num_iterations = 10;
+  options.band_radius = 4;
+  srand(0);
+  MattingSession session(image, trimap, options);
+  CHECK(session.isValid());
+  if (session.isValid() == false)
+    return;
+  const Mat initial_alpha = session.getAlpha().clone();
+  
+  CHECK(session.updateTrimap(trimap(Rect(0, 0, 8, 8)).clone(), Rect(0, 0, 8, 8)) == false);
+  
+  const Rect DIRTY_RECT(24, 10, 16, 6);
+  Mat edited_trimap = trimap.clone();
+  for (int y = DIRTY_RECT.y; y < DIRTY_RECT.y + DIRTY_RECT.height; y++)
+    for (int x = DIRTY_RECT.x; x < DIRTY_RECT.x + DIRTY_RECT.width; x++)
+      edited_trimap.at<uchar>(y, x) = 128;
+  CHECK(session.updateTrimap(edited_trimap, DIRTY_RECT));
+  
+  int num_unknown_pixels = 0;
+  for (int y = 0; y < image.rows; y++)
+    for (int x = 0; x < image.cols; x++)
+      if (edited_trimap.at<uchar>(y, x) == 128)
+	num_unknown_pixels++;
+  CHECK(session.getNumActivePixels() > 0);
+  CHECK(session.getNumActivePixels() < num_unknown_pixels);
+  
+  //outside the band only active pixels (whose samples the edit invalidated) may change
+  int num_changed_pixels = 0;
+  for (int y = 0; y < image.rows; y++)
+    for (int x = 0; x < image.cols; x++)
+      if ((y < DIRTY_RECT.y - options.band_radius || y >= DIRTY_RECT.y + DIRTY_RECT.height + options.band_radius || x < DIRTY_RECT.x - options.band_radius || x >= DIRTY_RECT.x + DIRTY_RECT.width + options.band_radius) && session.getAlpha().at<uchar>(y, x) != initial_alpha.at<uchar>(y, x))
+	num_changed_pixels++;
+  CHECK(num_changed_pixels <= session.getNumActivePixels());
+  
+  srand(0);
+  MattingSession full_session(image, edited_trimap, options);
+  CHECK(full_session.isValid());
+  if (full_session.isValid() == false)
+    return;
+  long difference_sum = 0;
+  for (int y = 0; y < image.rows; y++) {
+    for (int x = 0; x < image.cols; x++) {
+      const int difference = abs(session.getAlpha().at<uchar>(y, x) - full_session.getAlpha().at<uchar>(y, x));
+      if (edited_trimap.at<uchar>(y, x) != 128)
+	CHECK(difference == 0);
+      difference_sum += difference;
+    }
+  }
+  CHECK(difference_sum <= num_unknown_pixels * 16);
+}
+
+int main()
+{
+  testInvalidInputs();
+  testUpdateMatchesFullSolve();
+  return getNumFailures() == 0 ? 0 : 1;
+}
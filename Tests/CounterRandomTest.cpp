@@ -0,0 +1,54 @@
+#include <stdint.h>
+
+#include "CounterRandom.h"
+#include "TestUtils.h"
+
+
+//known-answer vectors of the Philox4x32-10 reference implementation (Random123 kat_vectors)
+void checkKnownAnswer(const uint32_t counter_0, const uint32_t counter_1, const uint32_t counter_2, const uint32_t counter_3, const uint32_t key_0, const uint32_t key_1, const uint32_t value_0, const uint32_t value_1, const uint32_t value_2, const uint32_t value_3)
+{
+  const uint32_t counter[4] = { counter_0, counter_1, counter_2, counter_3 };
+  const uint32_t key[2] = { key_0, key_1 };
+  uint32_t values[4];
+  CounterRandom::generateBlock(counter, key, values);
+  CHECK(values[0] == value_0);
+  CHECK(values[1] == value_1);
+  CHECK(values[2] == value_2);
+  CHECK(values[3] == value_3);
+}
+
+void testKnownAnswers()
+{
+  checkKnownAnswer(0, 0, 0, 0, 0, 0, 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8);
+  checkKnownAnswer(0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd);
+  checkKnownAnswer(0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344, 0xa4093822, 0x299f31d0, 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1);
+}
+
+//the stream of (key 0, stream 0, substream 0) starts with the first known-answer block
+void testStream()
+{
+  CounterRandom random(0, 0, 0);
+  CHECK(random() == 0x6627e8d5);
+  CHECK(random() == 0xe169c58d);
+  CHECK(random() == 0xbc57ac4c);
+  CHECK(random() == 0x9b00dbd8);
+  
+  CounterRandom random_1(12345, 3, 7);
+  CounterRandom random_2(12345, 3, 7);
+  CounterRandom other_substream_random(12345, 3, 8);
+  bool same_as_other_substream = true;
+  for (int i = 0; i < 10; i++) {
+    const uint32_t value = random_1();
+    CHECK(value == random_2());
+    if (value != other_substream_random())
+      same_as_other_substream = false;
+  }
+  CHECK(same_as_other_substream == false);
+}
+
+int main()
+{
+  testKnownAnswers();
+  testStream();
+  return getNumFailures() == 0 ? 0 : 1;
+}
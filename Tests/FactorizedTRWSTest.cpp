@@ -0,0 +1,150 @@
+#include <vector>
+#include <limits>
+#include <cstdlib>
+#include <cmath>
+
+#include "FactorizedTRWS.h"
+#include "TestUtils.h"
+
+
+using namespace std;
+
+//energy in the layout of FactorizedTRWS::setEnergy
+struct Energy
+{
+  int num_nodes;
+  vector<int> label_offsets;
+  vector<double> unary_costs;
+  vector<double> embeddings;
+  vector<int> edge_nodes_1;
+  vector<int> edge_nodes_2;
+  vector<double> edge_weights;
+};
+
+//1 to MAX_NUM_LABELS labels per node with integer unary costs and embeddings, and the given edges with integer weights
+Energy createEnergy(const int NUM_NODES, const int MAX_NUM_LABELS, const vector<int> &edge_nodes_1, const vector<int> &edge_nodes_2)
+{
+  Energy energy;
+  energy.num_nodes = NUM_NODES;
+  energy.label_offsets.assign(1, 0);
+  for (int node = 0; node < NUM_NODES; node++) {
+    const int NUM_LABELS = 1 + rand() % MAX_NUM_LABELS;
+    for (int label = 0; label < NUM_LABELS; label++) {
+      energy.unary_costs.push_back(rand() % 20);
+      energy.embeddings.push_back(rand() % 10);
+    }
+    energy.label_offsets.push_back(energy.label_offsets.back() + NUM_LABELS);
+  }
+  energy.edge_nodes_1 = edge_nodes_1;
+  energy.edge_nodes_2 = edge_nodes_2;
+  for (int edge = 0; edge < static_cast<int>(edge_nodes_1.size()); edge++)
+    energy.edge_weights.push_back(rand() % 5);
+  return energy;
+}
+
+double calcEnergy(const Energy &energy, const vector<int> &solution)
+{
+  double value = 0;
+  for (int node = 0; node < energy.num_nodes; node++)
+    value += energy.unary_costs[energy.label_offsets[node] + solution[node]];
+  for (int edge = 0; edge < static_cast<int>(energy.edge_nodes_1.size()); edge++) {
+    const int node_1 = energy.edge_nodes_1[edge];
+    const int node_2 = energy.edge_nodes_2[edge];
+    value += energy.edge_weights[edge] * fabs(energy.embeddings[energy.label_offsets[node_1] + solution[node_1]] - energy.embeddings[energy.label_offsets[node_2] + solution[node_2]]);
+  }
+  return value;
+}
+
+//minimum energy over all labelings
+double calcOptimalEnergy(const Energy &energy)
+{
+  vector<int> solution(energy.num_nodes, 0);
+  double optimal_energy = numeric_limits<double>::max();
+  while (true) {
+    optimal_energy = min(optimal_energy, calcEnergy(energy, solution));
+    int node = 0;
+    while (node < energy.num_nodes && ++solution[node] == energy.label_offsets[node + 1] - energy.label_offsets[node])
+      solution[node++] = 0;
+    if (node == energy.num_nodes)
+      break;
+  }
+  return optimal_energy;
+}
+
+//minimizes energy and checks lower bound <= optimum <= energy of the returned labeling; returns the gap
+double checkBounds(const Energy &energy)
+{
+  FactorizedTRWS trws;
+  trws.setEnergy(energy.num_nodes, &energy.label_offsets[0], &energy.unary_costs[0], &energy.embeddings[0], energy.edge_nodes_1.size(), energy.edge_nodes_1.empty() ? NULL : &energy.edge_nodes_1[0], energy.edge_nodes_2.empty() ? NULL : &energy.edge_nodes_2[0], energy.edge_weights.empty() ? NULL : &energy.edge_weights[0]);
+  double lower_bound, solution_energy;
+  trws.minimize(100, 0, lower_bound, solution_energy, 0, 1);
+  const double OPTIMAL_ENERGY = calcOptimalEnergy(energy);
+  CHECK(fabs(solution_energy - calcEnergy(energy, trws.getSolution())) < 0.000001);
+  CHECK(fabs(solution_energy - trws.calcEnergy(trws.getSolution())) < 0.000001);
+  CHECK(lower_bound <= OPTIMAL_ENERGY + 0.000001);
+  CHECK(OPTIMAL_ENERGY <= solution_energy + 0.000001);
+  return solution_energy - lower_bound;
+}
+
+//TRW-S is exact on chains: the bound meets the energy of the optimal labeling
+void testChains()
+{
+  for (int trial = 0; trial < 50; trial++) {
+    const int NUM_NODES = 2 + trial % 6;
+    vector<int> edge_nodes_1, edge_nodes_2;
+    for (int node = 0; node + 1 < NUM_NODES; node++) {
+      edge_nodes_1.push_back(node);
+      edge_nodes_2.push_back(node + 1);
+    }
+    CHECK(checkBounds(createEnergy(NUM_NODES, 4, edge_nodes_1, edge_nodes_2)) < 0.000001);
+  }
+}
+
+//graphs with cycles only satisfy the bounds
+void testRandomGraphs()
+{
+  for (int trial = 0; trial < 200; trial++) {
+    const int NUM_NODES = 2 + trial % 6;
+    vector<int> edge_nodes_1, edge_nodes_2;
+    for (int node_1 = 0; node_1 < NUM_NODES; node_1++) {
+      for (int node_2 = node_1 + 1; node_2 < NUM_NODES; node_2++) {
+	if (rand() % 2 == 0)
+	  continue;
+	edge_nodes_1.push_back(node_1);
+	edge_nodes_2.push_back(node_2);
+      }
+    }
+    checkBounds(createEnergy(NUM_NODES, 3, edge_nodes_1, edge_nodes_2));
+  }
+}
+
+//the graph is kept while the labels change
+void testSetLabels()
+{
+  const int EDGE_NODES_1[] = {0, 0, 1};
+  const int EDGE_NODES_2[] = {1, 2, 2};
+  const vector<int> edge_nodes_1(EDGE_NODES_1, EDGE_NODES_1 + 3), edge_nodes_2(EDGE_NODES_2, EDGE_NODES_2 + 3);
+  const Energy first_energy = createEnergy(3, 3, edge_nodes_1, edge_nodes_2);
+  FactorizedTRWS trws;
+  trws.setGraph(3, 3, EDGE_NODES_1, EDGE_NODES_2, &first_energy.edge_weights[0]);
+  for (int trial = 0; trial < 20; trial++) {
+    Energy energy = createEnergy(3, 3, edge_nodes_1, edge_nodes_2);
+    energy.edge_weights = first_energy.edge_weights;
+    trws.setLabels(&energy.label_offsets[0], &energy.unary_costs[0], &energy.embeddings[0]);
+    double lower_bound, solution_energy;
+    trws.minimize(100, 0, lower_bound, solution_energy, 0, 1);
+    const double OPTIMAL_ENERGY = calcOptimalEnergy(energy);
+    CHECK(lower_bound <= OPTIMAL_ENERGY + 0.000001);
+    CHECK(OPTIMAL_ENERGY <= solution_energy + 0.000001);
+    CHECK(fabs(solution_energy - calcEnergy(energy, trws.getSolution())) < 0.000001);
+  }
+}
+
+int main()
+{
+  srand(0);
+  testChains();
+  testRandomGraphs();
+  testSetLabels();
+  return getNumFailures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,28 @@
+#ifndef MATTING_TEST_UTILS_H__
+#define MATTING_TEST_UTILS_H__
+
+#include <cmath>
+#include <algorithm>
+#include <opencv2/core/core.hpp>
+
+
+//A soft-edged disc on a color gradient with an unknown band of 5 pixels around its edge. The band is narrow enough that every guided filter window reaches known pixels.
+inline void createMattingProblem(const int IMAGE_WIDTH, const int IMAGE_HEIGHT, cv::Mat &image, cv::Mat &trimap)
+{
+  image.create(IMAGE_HEIGHT, IMAGE_WIDTH, CV_8UC3);
+  trimap.create(IMAGE_HEIGHT, IMAGE_WIDTH, CV_8UC1);
+  const double RADIUS = std::min(IMAGE_WIDTH, IMAGE_HEIGHT) * 0.3;
+  for (int y = 0; y < IMAGE_HEIGHT; y++) {
+    for (int x = 0; x < IMAGE_WIDTH; x++) {
+      const double distance = std::sqrt(std::pow(x - IMAGE_WIDTH / 2.0, 2) + std::pow(y - IMAGE_HEIGHT / 2.0, 2)) - RADIUS;
+      const double alpha = std::max(std::min(0.5 - distance / 3, 1.0), 0.0);
+      const cv::Vec3b foreground_color(40, 200, 120 + x % 50);
+      const cv::Vec3b background_color(20 + y * 150 / IMAGE_HEIGHT, 60, 220 - x * 100 / IMAGE_WIDTH);
+      for (int c = 0; c < 3; c++)
+	image.at<cv::Vec3b>(y, x)[c] = alpha * foreground_color[c] + (1 - alpha) * background_color[c];
+      trimap.at<cv::uchar>(y, x) = distance < -2 ? 255 : (distance > 2 ? 0 : 128);
+    }
+  }
+}
+
+#endif
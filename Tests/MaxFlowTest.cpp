@@ -0,0 +1,120 @@
+#include <vector>
+#include <limits>
+#include <cstdlib>
+#include <cmath>
+
+#include "MaxFlow.h"
+#include "TestUtils.h"
+
+
+using namespace std;
+
+//graph in the terms of MaxFlow: terminal capacities per node and directed capacities per node pair
+struct FlowGraph
+{
+  int num_nodes;
+  vector<double> source_capacities;
+  vector<double> sink_capacities;
+  vector<int> edge_nodes_1;
+  vector<int> edge_nodes_2;
+  vector<double> capacities;
+  vector<double> reverse_capacities;
+};
+
+//integer capacities, some of them zero, and edges between random node pairs (possibly several per pair)
+FlowGraph createFlowGraph(const int NUM_NODES)
+{
+  FlowGraph graph;
+  graph.num_nodes = NUM_NODES;
+  for (int node = 0; node < NUM_NODES; node++) {
+    graph.source_capacities.push_back(rand() % 3 == 0 ? 0 : rand() % 10);
+    graph.sink_capacities.push_back(rand() % 3 == 0 ? 0 : rand() % 10);
+  }
+  const int NUM_EDGES = rand() % (NUM_NODES * 2 + 1);
+  for (int edge = 0; edge < NUM_EDGES && NUM_NODES > 1; edge++) {
+    const int node_1 = rand() % NUM_NODES;
+    const int node_2 = (node_1 + 1 + rand() % (NUM_NODES - 1)) % NUM_NODES;
+    graph.edge_nodes_1.push_back(node_1);
+    graph.edge_nodes_2.push_back(node_2);
+    graph.capacities.push_back(rand() % 8);
+    graph.reverse_capacities.push_back(rand() % 8);
+  }
+  return graph;
+}
+
+void buildMaxFlow(const FlowGraph &graph, MaxFlow &max_flow)
+{
+  max_flow.reset(graph.num_nodes);
+  for (int node = 0; node < graph.num_nodes; node++)
+    max_flow.addTerminalWeights(node, graph.source_capacities[node], graph.sink_capacities[node]);
+  for (int edge = 0; edge < static_cast<int>(graph.edge_nodes_1.size()); edge++)
+    max_flow.addEdge(graph.edge_nodes_1[edge], graph.edge_nodes_2[edge], graph.capacities[edge], graph.reverse_capacities[edge]);
+}
+
+//capacity of the arcs from the source side to the sink side
+double calcCutCost(const FlowGraph &graph, const vector<bool> &source_side)
+{
+  double cost = 0;
+  for (int node = 0; node < graph.num_nodes; node++)
+    cost += source_side[node] ? graph.sink_capacities[node] : graph.source_capacities[node];
+  for (int edge = 0; edge < static_cast<int>(graph.edge_nodes_1.size()); edge++) {
+    const int node_1 = graph.edge_nodes_1[edge];
+    const int node_2 = graph.edge_nodes_2[edge];
+    if (source_side[node_1] && source_side[node_2] == false)
+      cost += graph.capacities[edge];
+    if (source_side[node_2] && source_side[node_1] == false)
+      cost += graph.reverse_capacities[edge];
+  }
+  return cost;
+}
+
+double calcMinCutCost(const FlowGraph &graph)
+{
+  double min_cut_cost = numeric_limits<double>::max();
+  for (int cut = 0; cut < (1 << graph.num_nodes); cut++) {
+    vector<bool> source_side(graph.num_nodes);
+    for (int node = 0; node < graph.num_nodes; node++)
+      source_side[node] = (cut >> node) & 1;
+    min_cut_cost = min(min_cut_cost, calcCutCost(graph, source_side));
+  }
+  return min_cut_cost;
+}
+
+//max-flow equals min-cut, and the reported cut achieves it; one MaxFlow is reused for all graphs
+void testRandomGraphs()
+{
+  MaxFlow max_flow;
+  for (int trial = 0; trial < 500; trial++) {
+    const FlowGraph graph = createFlowGraph(1 + trial % 8);
+    buildMaxFlow(graph, max_flow);
+    const double FLOW = max_flow.solve();
+    CHECK(fabs(FLOW - calcMinCutCost(graph)) < 0.000001);
+    vector<bool> source_side(graph.num_nodes);
+    for (int node = 0; node < graph.num_nodes; node++)
+      source_side[node] = max_flow.isSourceSide(node);
+    CHECK(fabs(calcCutCost(graph, source_side) - FLOW) < 0.000001);
+  }
+}
+
+//0 -> 1 -> 2 with a bottleneck in the middle
+void testPath()
+{
+  MaxFlow max_flow;
+  max_flow.reset(3);
+  max_flow.addTerminalWeights(0, 5, 0);
+  max_flow.addTerminalWeights(2, 0, 5);
+  max_flow.addEdge(0, 1, 4, 0);
+  max_flow.addEdge(1, 2, 2, 0);
+  CHECK(max_flow.solve() == 2);
+  CHECK(max_flow.isSourceSide(0));
+  CHECK(max_flow.isSourceSide(1));
+  CHECK(max_flow.isSourceSide(2) == false);
+}
+
+int main()
+{
+  srand(0);
+  testPath();
+  testRandomGraphs();
+  return getNumFailures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <unistd.h>
+
+#include "NeighborGraphCache.h"
+#include "TestUtils.h"
+
+
+using namespace std;
+using namespace neighbor_graph_cache;
+
+NeighborGraph buildTriangleGraph()
+{
+  const int OFFSETS[] = {0, 2, 4, 6};
+  const int NEIGHBORS[] = {1, 2, 0, 2, 0, 1};
+  const double WEIGHTS[] = {0.25, 0.5, 0.25, 0.75, 0.5, 0.75};
+  vector<int> offsets(OFFSETS, OFFSETS + 4);
+  vector<int> neighbors(NEIGHBORS, NEIGHBORS + 6);
+  vector<double> weights(WEIGHTS, WEIGHTS + 6);
+  NeighborGraph graph;
+  graph.assign(offsets, neighbors, weights);
+  return graph;
+}
+
+void testRoundTrip(const string &filename)
+{
+  const uint64_t KEY = hashValue(42);
+  const NeighborGraph graph = buildTriangleGraph();
+  CHECK(saveNeighborGraph(filename, KEY, graph));
+  
+  NeighborGraph loaded_graph;
+  CHECK(loadNeighborGraph(filename, KEY, loaded_graph));
+  CHECK(loaded_graph.getNumNodes() == graph.getNumNodes());
+  CHECK(loaded_graph.getNumEdges() == graph.getNumEdges());
+  for (int node = 0; node <= graph.getNumNodes(); node++)
+    CHECK(loaded_graph.getOffsets()[node] == graph.getOffsets()[node]);
+  for (int edge_index = 0; edge_index < graph.getNumEdges(); edge_index++) {
+    CHECK(loaded_graph.getNeighbor(edge_index) == graph.getNeighbor(edge_index));
+    CHECK(loaded_graph.getWeight(edge_index) == graph.getWeight(edge_index));
+  }
+  
+  NeighborGraph other_key_graph;
+  CHECK(loadNeighborGraph(filename, KEY + 1, other_key_graph) == false);
+  CHECK(loadNeighborGraph(filename + ".missing", KEY, other_key_graph) == false);
+}
+
+//overwrites the int at position and checks that loading fails
+void checkCorruptionRejected(const string &filename, const long position, const int value)
+{
+  const uint64_t KEY = hashValue(7);
+  CHECK(saveNeighborGraph(filename, KEY, buildTriangleGraph()));
+  {
+    fstream file_str(filename.c_str(), ios::in | ios::out | ios::binary);
+    file_str.seekp(position);
+    file_str.write(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+  NeighborGraph graph;
+  CHECK(loadNeighborGraph(filename, KEY, graph) == false);
+}
+
+void testCorruptFiles(const string &filename)
+{
+  //the file ends with 4 offsets and 6 neighbors (both 8-byte aligned)
+  long file_size = 0;
+  {
+    CHECK(saveNeighborGraph(filename, hashValue(7), buildTriangleGraph()));
+    ifstream in_str(filename.c_str(), ios::binary | ios::ate);
+    file_size = in_str.tellg();
+  }
+  const long NEIGHBORS_POSITION = file_size - sizeof(int) * 6;
+  const long OFFSETS_POSITION = NEIGHBORS_POSITION - sizeof(int) * 4;
+  CHECK(NEIGHBORS_POSITION > 0);
+  //offsets which decrease
+  checkCorruptionRejected(filename, OFFSETS_POSITION + sizeof(int), 5);
+  //a neighbor outside the graph
+  checkCorruptionRejected(filename, NEIGHBORS_POSITION + sizeof(int), 3);
+  checkCorruptionRejected(filename, NEIGHBORS_POSITION, -1);
+}
+
+int main()
+{
+  char directory[] = "/tmp/neighbor_graph_cache_test_XXXXXX";
+  if (mkdtemp(directory) == NULL)
+    return 1;
+  const string FILENAME = getCacheFilename(string(directory) + "/", 1);
+  testRoundTrip(FILENAME);
+  testCorruptFiles(FILENAME);
+  remove(FILENAME.c_str());
+  rmdir(directory);
+  return getNumFailures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+#include <vector>
+#include <limits>
+#include <stdexcept>
+
+#include "NeighborGraph.h"
+#include "TestUtils.h"
+
+
+using namespace std;
+
+//0 - 1 - 2 - 3 as a path with weights 1, 2, 3 stored in both directions
+NeighborGraph buildPathGraph()
+{
+  const int OFFSETS[] = {0, 1, 3, 5, 6};
+  const int NEIGHBORS[] = {1, 0, 2, 1, 3, 2};
+  const double WEIGHTS[] = {1, 1, 2, 2, 3, 3};
+  vector<int> offsets(OFFSETS, OFFSETS + 5);
+  vector<int> neighbors(NEIGHBORS, NEIGHBORS + 6);
+  vector<double> weights(WEIGHTS, WEIGHTS + 6);
+  NeighborGraph graph;
+  graph.assign(offsets, neighbors, weights);
+  return graph;
+}
+
+void testAssign()
+{
+  const NeighborGraph graph = buildPathGraph();
+  CHECK(graph.getNumNodes() == 4);
+  CHECK(graph.getNumEdges() == 6);
+  CHECK(graph.getNumNeighbors(0) == 1);
+  CHECK(graph.getNumNeighbors(1) == 2);
+  CHECK(graph.findEdge(1, 2) == 2);
+  CHECK(graph.getWeight(graph.findEdge(2, 3)) == 3);
+  CHECK(graph.findEdge(0, 3) == -1);
+  
+  NeighborGraph copied_graph;
+  copied_graph = graph;
+  CHECK(copied_graph.getNumEdges() == 6);
+  CHECK(copied_graph.getNeighbors() != graph.getNeighbors());
+  CHECK(copied_graph.getNeighbor(4) == 3);
+}
+
+void testExternalArrays()
+{
+  const int OFFSETS[] = {0, 1, 2};
+  const int NEIGHBORS[] = {1, 0};
+  const double WEIGHTS[] = {0.5, 0.5};
+  NeighborGraph graph;
+  graph.assign(2, 2, OFFSETS, NEIGHBORS, WEIGHTS, shared_ptr<const void>());
+  CHECK(graph.getNumNodes() == 2);
+  CHECK(graph.getNeighbors() == NEIGHBORS);
+  CHECK(graph.findEdge(1, 0) == 1);
+}
+
+//replaces the rows of nodes 1 and 2 with more and then fewer edges; the other rows keep their edges
+void testReplaceNodes()
+{
+  const int NODES[] = {1, 2};
+  const int OFFSETS[] = {0, 3, 5};
+  const int NEIGHBORS[] = {0, 2, 3, 1, 3};
+  const double WEIGHTS[] = {1, 5, 6, 5, 7};
+  NeighborGraph graph = buildPathGraph();
+  graph.replaceNodes(vector<int>(NODES, NODES + 2), vector<int>(OFFSETS, OFFSETS + 3), vector<int>(NEIGHBORS, NEIGHBORS + 5), vector<double>(WEIGHTS, WEIGHTS + 5));
+  CHECK(graph.getNumNodes() == 4);
+  CHECK(graph.isCompact() == false);
+  //the new rows are appended behind the 6 old edges
+  CHECK(graph.getNumEdges() == 11);
+  CHECK(graph.getEdgeBegin(1) == 6);
+  CHECK(graph.getEdgeEnd(1) == 9);
+  CHECK(graph.getNumNeighbors(2) == 2);
+  CHECK(graph.getWeight(graph.findEdge(0, 1)) == 1);
+  CHECK(graph.getWeight(graph.findEdge(1, 3)) == 6);
+  CHECK(graph.getWeight(graph.findEdge(2, 3)) == 7);
+  CHECK(graph.getWeight(graph.findEdge(3, 2)) == 3);
+  
+  //an empty row makes the dropped edges outnumber the others, which compacts the arrays
+  graph.replaceNodes(vector<int>(1, 2), vector<int>(2, 0), vector<int>(), vector<double>());
+  CHECK(graph.isCompact());
+  CHECK(graph.getNumEdges() == 5);
+  CHECK(graph.getNumNeighbors(2) == 0);
+  CHECK(graph.getEdgeBegin(3) == 4);
+  CHECK(graph.getEdgeEnd(3) == 5);
+  CHECK(graph.getNeighbor(4) == 2);
+  CHECK(graph.getWeight(4) == 3);
+  CHECK(graph.getOffsets()[4] == 5);
+  
+  //graphs on external arrays own copies afterwards
+  const int EXTERNAL_OFFSETS[] = {0, 1, 2};
+  const int EXTERNAL_NEIGHBORS[] = {1, 0};
+  const double EXTERNAL_WEIGHTS[] = {0.5, 0.5};
+  NeighborGraph external_graph;
+  external_graph.assign(2, 2, EXTERNAL_OFFSETS, EXTERNAL_NEIGHBORS, EXTERNAL_WEIGHTS, shared_ptr<const void>());
+  const int ROW_OFFSETS[] = {0, 1};
+  external_graph.replaceNodes(vector<int>(1, 0), vector<int>(ROW_OFFSETS, ROW_OFFSETS + 2), vector<int>(1, 1), vector<double>(1, 2));
+  CHECK(external_graph.getNeighbors() != EXTERNAL_NEIGHBORS);
+  CHECK(external_graph.getWeight(external_graph.findEdge(0, 1)) == 2);
+  CHECK(external_graph.getWeight(external_graph.findEdge(1, 0)) == 0.5);
+  CHECK(EXTERNAL_WEIGHTS[0] == 0.5);
+  external_graph.compact();
+  CHECK(external_graph.getNumEdges() == 2);
+  CHECK(external_graph.getWeight(0) == 2);
+  CHECK(external_graph.getWeight(1) == 0.5);
+}
+
+void testEdgeLimit()
+{
+  NeighborGraph::checkNumEdges(0);
+  NeighborGraph::checkNumEdges(numeric_limits<int>::max());
+  bool rejected = false;
+  try {
+    NeighborGraph::checkNumEdges(numeric_limits<int>::max() + 1L);
+  } catch (const invalid_argument &) {
+    rejected = true;
+  }
+  CHECK(rejected);
+}
+
+int main()
+{
+  testAssign();
+  testExternalArrays();
+  testReplaceNodes();
+  testEdgeLimit();
+  return getNumFailures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+
+#include "Symmetric3x3.h"
+#include "TestUtils.h"
+
+
+using namespace std;
+
+//The test is built once per kernel (scalar, AVX and AVX-512 builds, see CMakeLists.txt). Counts below and above the vector widths also run the scalar tail.
+
+double getRandomValue()
+{
+  return (rand() % 2001 - 1000) / 1000.0;
+}
+
+//symmetric positive definite matrices M^T M + epsilon I in the batch layout, and the same matrices as explicit 3x3 arrays
+void createMatrices(const int COUNT, const double epsilon, vector<double> &matrices, vector<vector<double> > &explicit_matrices)
+{
+  matrices.assign(6 * SYMMETRIC_3X3_BATCH_SIZE, 0);
+  explicit_matrices.assign(COUNT, vector<double>(9, 0));
+  for (int index = 0; index < COUNT; index++) {
+    double factor[9];
+    for (int i = 0; i < 9; i++)
+      factor[i] = getRandomValue();
+    for (int c_1 = 0; c_1 < 3; c_1++) {
+      for (int c_2 = 0; c_2 < 3; c_2++) {
+	double value = c_1 == c_2 ? epsilon : 0;
+	for (int k = 0; k < 3; k++)
+	  value += factor[k * 3 + c_1] * factor[k * 3 + c_2];
+	explicit_matrices[index][c_1 * 3 + c_2] = value;
+	matrices[getSymmetric3x3Plane(c_1, c_2) * SYMMETRIC_3X3_BATCH_SIZE + index] = value;
+      }
+    }
+  }
+}
+
+void testInvert(const int COUNT)
+{
+  vector<double> matrices;
+  vector<vector<double> > explicit_matrices;
+  createMatrices(COUNT, 0.1, matrices, explicit_matrices);
+  vector<double> inverses(6 * SYMMETRIC_3X3_BATCH_SIZE, 0);
+  invertSymmetric3x3(COUNT, &matrices[0], &inverses[0]);
+  for (int index = 0; index < COUNT; index++) {
+    //matrix * inverse has to be the identity
+    double max_error = 0;
+    for (int c_1 = 0; c_1 < 3; c_1++) {
+      for (int c_2 = 0; c_2 < 3; c_2++) {
+	double product = 0;
+	for (int k = 0; k < 3; k++)
+	  product += explicit_matrices[index][c_1 * 3 + k] * inverses[getSymmetric3x3Plane(k, c_2) * SYMMETRIC_3X3_BATCH_SIZE + index];
+	max_error = max(max_error, fabs(product - (c_1 == c_2)));
+      }
+    }
+    CHECK(max_error < 1e-9);
+  }
+}
+
+void testSolve(const int COUNT)
+{
+  vector<double> matrices;
+  vector<vector<double> > explicit_matrices;
+  createMatrices(COUNT, 0.1, matrices, explicit_matrices);
+  vector<double> vectors(3 * SYMMETRIC_3X3_BATCH_SIZE, 0);
+  for (int index = 0; index < COUNT; index++)
+    for (int c = 0; c < 3; c++)
+      vectors[c * SYMMETRIC_3X3_BATCH_SIZE + index] = getRandomValue();
+  vector<double> solutions(3 * SYMMETRIC_3X3_BATCH_SIZE, 0);
+  solveSymmetric3x3(COUNT, &matrices[0], &vectors[0], &solutions[0]);
+  for (int index = 0; index < COUNT; index++) {
+    double max_error = 0;
+    for (int c_1 = 0; c_1 < 3; c_1++) {
+      double product = 0;
+      for (int c_2 = 0; c_2 < 3; c_2++)
+	product += explicit_matrices[index][c_1 * 3 + c_2] * solutions[c_2 * SYMMETRIC_3X3_BATCH_SIZE + index];
+      max_error = max(max_error, fabs(product - vectors[c_1 * SYMMETRIC_3X3_BATCH_SIZE + index]));
+    }
+    CHECK(max_error < 1e-9);
+  }
+}
+
+//entries outside the first COUNT matrices are left untouched
+void testCount()
+{
+  const int COUNT = 5;
+  vector<double> matrices;
+  vector<vector<double> > explicit_matrices;
+  createMatrices(COUNT, 0.1, matrices, explicit_matrices);
+  vector<double> inverses(6 * SYMMETRIC_3X3_BATCH_SIZE, -1);
+  invertSymmetric3x3(COUNT, &matrices[0], &inverses[0]);
+  bool untouched = true;
+  for (int plane = 0; plane < 6; plane++)
+    for (int index = COUNT; index < SYMMETRIC_3X3_BATCH_SIZE; index++)
+      untouched = untouched && inverses[plane * SYMMETRIC_3X3_BATCH_SIZE + index] == -1;
+  CHECK(untouched);
+}
+
+int main()
+{
+  srand(0);
+  const int COUNTS[] = { 1, 3, 4, 7, 8, 13, SYMMETRIC_3X3_BATCH_SIZE };
+  const int NUM_COUNTS = sizeof(COUNTS) / sizeof(COUNTS[0]);
+  for (int count_index = 0; count_index < NUM_COUNTS; count_index++) {
+    testInvert(COUNTS[count_index]);
+    testSolve(COUNTS[count_index]);
+  }
+  testCount();
+  return getNumFailures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,22 @@
+#ifndef TEST_UTILS_H__
+#define TEST_UTILS_H__
+
+#include <iostream>
+
+
+//Minimal checks for the test executables; a test returns getNumFailures() != 0 from main.
+inline int &getNumFailures()
+{
+  static int num_failures = 0;
+  return num_failures;
+}
+
+#define CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      std::cout << __FILE__ << ":" << __LINE__ << ": check failed: " << #condition << std::endl; \
+      getNumFailures()++; \
+    } \
+  } while (false)
+
+#endif